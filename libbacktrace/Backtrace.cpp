@@ -28,7 +28,7 @@
 #include <backtrace/Backtrace.h>
 #include <backtrace/BacktraceMap.h>
 
-#include <demangle.h>
+#include <unwindstack/DemangleCache.h>
 
 #include "BacktraceLog.h"
 #include "UnwindStack.h"
@@ -63,7 +63,7 @@ std::string Backtrace::GetFunctionName(uint64_t pc, uint64_t* offset, const back
   if (map->start == 0 || (map->flags & PROT_DEVICE_MAP)) {
     return "";
   }
-  return demangle(GetFunctionNameRaw(pc, offset).c_str());
+  return unwindstack::DemangleCache::Demangle(GetFunctionNameRaw(pc, offset));
 }
 
 bool Backtrace::VerifyReadWordArgs(uint64_t ptr, word_t* out_value) {
@@ -172,5 +172,7 @@ std::string Backtrace::GetErrorString(BacktraceUnwindError error) {
       return "Failed to unwind due to same sp/pc repeating";
     case BACKTRACE_UNWIND_ERROR_INVALID_ELF:
       return "Failed to unwind due to invalid elf";
+    case BACKTRACE_UNWIND_ERROR_BUDGET_EXCEEDED:
+      return "Stopped the unwind after it ran out of time or memory reads";
   }
 }
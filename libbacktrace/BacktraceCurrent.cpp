@@ -15,6 +15,7 @@
  */
 
 #define _GNU_SOURCE 1
+#include <dirent.h>
 #include <errno.h>
 #include <stdint.h>
 #include <string.h>
@@ -26,7 +27,14 @@
 
 #include <stdlib.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <android-base/threads.h>
 #include <backtrace/Backtrace.h>
@@ -230,3 +238,191 @@ bool BacktraceCurrent::UnwindThread(size_t num_ignore_frames) {
 
   return unwind_done;
 }
+
+// How long a thread stopped by UnwindAllThreads waits in the signal handler
+// before it continues on its own. This has to cover the wait for all of the
+// threads to stop, and then the unwinds of all of them. A thread that
+// continues early would be unwound from a stale ucontext.
+static constexpr time_t kUnwindAllWaitTimeoutSec = 60;
+
+static bool GetThreadIds(std::vector<pid_t>* tids) {
+  DIR* tasks_dir = opendir("/proc/self/task");
+  if (tasks_dir == nullptr) {
+    return false;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(tasks_dir)) != nullptr) {
+    char* end;
+    pid_t tid = strtoul(entry->d_name, &end, 10);
+    if (tid != 0 && *end == '\0') {
+      tids->push_back(tid);
+    }
+  }
+  closedir(tasks_dir);
+  return true;
+}
+
+bool Backtrace::UnwindAllThreads(BacktraceMap* map,
+                                 std::vector<std::unique_ptr<Backtrace>>* backtraces) {
+  backtraces->clear();
+  if (map == nullptr) {
+    BACK_ASYNC_SAFE_LOGE("A map is required to unwind all threads.");
+    return false;
+  }
+
+  std::vector<pid_t> tids;
+  if (!GetThreadIds(&tids)) {
+    BACK_ASYNC_SAFE_LOGE("Failed to read the threads of pid %d: %s", getpid(), strerror(errno));
+    return false;
+  }
+
+  struct ThreadUnwind {
+    Backtrace* backtrace;
+    ThreadEntry* entry;
+    bool signaled;
+    bool stopped;
+  };
+  pid_t pid = getpid();
+  pid_t self_tid = android::base::GetThreadId();
+  std::vector<ThreadUnwind> threads;
+  for (pid_t tid : tids) {
+    if (tid != self_tid) {
+      backtraces->emplace_back(Create(pid, tid, map));
+      threads.push_back(ThreadUnwind{backtraces->back().get(), nullptr, false, false});
+    }
+  }
+  if (threads.empty()) {
+    return true;
+  }
+
+  // Start the threads that do the unwinds before stopping any thread, since
+  // a stopped thread could be holding a lock needed to create a thread.
+  // The calling thread does unwinds too.
+  std::mutex state_mutex;
+  std::condition_variable state_cond;
+  bool start = false;
+  size_t num_finished = 0;
+  std::atomic_size_t next_index(0);
+  auto unwind_threads = [&threads, &next_index]() {
+    size_t index;
+    while ((index = next_index++) < threads.size()) {
+      ThreadUnwind* thread = &threads[index];
+      if (thread->stopped) {
+        thread->backtrace->Unwind(0, thread->entry->GetUcontext());
+      }
+    }
+  };
+  size_t num_cpus = std::max(1U, std::thread::hardware_concurrency());
+  size_t num_workers = std::min(threads.size(), num_cpus) - 1;
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < num_workers; i++) {
+    workers.emplace_back([&]() {
+      {
+        std::unique_lock<std::mutex> lock(state_mutex);
+        state_cond.wait(lock, [&start]() { return start; });
+      }
+      unwind_threads();
+      std::lock_guard<std::mutex> lock(state_mutex);
+      num_finished++;
+      state_cond.notify_all();
+    });
+  }
+
+  // Lock all of the entries before sending any signal. A thread that is in
+  // the middle of UnwindThread holds the entry of the thread it unwinds,
+  // and must not be stopped while this waits for that entry.
+  pthread_mutex_lock(&g_sigaction_mutex);
+  for (ThreadUnwind& thread : threads) {
+    thread.entry = ThreadEntry::Get(pid, thread.backtrace->Tid());
+    thread.entry->Lock();
+    thread.entry->SetWaitTimeout(kUnwindAllWaitTimeoutSec);
+  }
+
+  struct sigaction act, oldact;
+  memset(&act, 0, sizeof(act));
+  act.sa_sigaction = SignalHandler;
+  act.sa_flags = SA_RESTART | SA_SIGINFO | SA_ONSTACK;
+  sigemptyset(&act.sa_mask);
+  bool handler_installed = sigaction(THREAD_SIGNAL, &act, &oldact) == 0;
+  if (!handler_installed) {
+    BACK_ASYNC_SAFE_LOGE("sigaction failed: %s", strerror(errno));
+  } else {
+    for (ThreadUnwind& thread : threads) {
+      if (tgkill(pid, thread.backtrace->Tid(), THREAD_SIGNAL) == 0) {
+        thread.signaled = true;
+      } else if (errno == ESRCH) {
+        thread.backtrace->error_.error_code = BACKTRACE_UNWIND_ERROR_THREAD_DOESNT_EXIST;
+      } else {
+        thread.backtrace->error_.error_code = BACKTRACE_UNWIND_ERROR_INTERNAL;
+      }
+    }
+
+    // The signals were all sent at once, so all of the waits share a timeout.
+    timespec deadline;
+    ThreadEntry::GetWaitDeadline(&deadline);
+    bool all_stopped = true;
+    for (ThreadUnwind& thread : threads) {
+      if (thread.signaled) {
+        thread.stopped = thread.entry->WaitUntil(1, deadline);
+        all_stopped = all_stopped && thread.stopped;
+      }
+    }
+
+    if (!all_stopped && oldact.sa_sigaction == nullptr) {
+      // See UnwindThread, a signal delivered late must not crash the thread.
+      memset(&act, 0, sizeof(act));
+      act.sa_sigaction = SignalLogOnly;
+      act.sa_flags = SA_RESTART | SA_SIGINFO | SA_ONSTACK;
+      sigemptyset(&act.sa_mask);
+      sigaction(THREAD_SIGNAL, &act, nullptr);
+    } else {
+      sigaction(THREAD_SIGNAL, &oldact, nullptr);
+    }
+  }
+  pthread_mutex_unlock(&g_sigaction_mutex);
+
+  {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    start = true;
+    state_cond.notify_all();
+  }
+  unwind_threads();
+  {
+    std::unique_lock<std::mutex> lock(state_mutex);
+    state_cond.wait(lock, [&]() { return num_finished == workers.size(); });
+  }
+
+  // Let all of the threads continue, then wait for them to leave the
+  // signal handler before releasing the entries. A thread that was too late
+  // to be unwound is woken too, in case it reaches the signal handler while
+  // its entry still exists.
+  for (ThreadUnwind& thread : threads) {
+    if (thread.signaled) {
+      thread.entry->Wake();
+    }
+  }
+  timespec deadline;
+  ThreadEntry::GetWaitDeadline(&deadline);
+  for (ThreadUnwind& thread : threads) {
+    if (thread.stopped) {
+      if (!thread.entry->WaitUntil(3, deadline)) {
+        BACK_ASYNC_SAFE_LOGW("Timed out waiting for signal handler to indicate it finished.");
+      }
+    } else if (thread.signaled) {
+      if (tgkill(pid, thread.backtrace->Tid(), 0) == -1 && errno == ESRCH) {
+        thread.backtrace->error_.error_code = BACKTRACE_UNWIND_ERROR_THREAD_DOESNT_EXIST;
+      } else {
+        thread.backtrace->error_.error_code = BACKTRACE_UNWIND_ERROR_THREAD_TIMEOUT;
+        BACK_ASYNC_SAFE_LOGE("Timed out waiting for signal handler to get ucontext data.");
+      }
+    } else if (!handler_installed) {
+      thread.backtrace->error_.error_code = BACKTRACE_UNWIND_ERROR_INTERNAL;
+    }
+    ThreadEntry::Remove(thread.entry);
+  }
+
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  return handler_installed;
+}
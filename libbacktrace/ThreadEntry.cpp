@@ -33,6 +33,7 @@ pthread_mutex_t ThreadEntry::list_mutex_ = PTHREAD_MUTEX_INITIALIZER;
 ThreadEntry::ThreadEntry(pid_t pid, pid_t tid)
     : pid_(pid), tid_(tid), ref_count_(1), mutex_(PTHREAD_MUTEX_INITIALIZER),
       wait_mutex_(PTHREAD_MUTEX_INITIALIZER), wait_value_(0),
+      wait_timeout_sec_(kDefaultWaitTimeoutSec),
       next_(ThreadEntry::list_), prev_(nullptr) {
   pthread_condattr_t attr;
   pthread_condattr_init(&attr);
@@ -96,15 +97,33 @@ ThreadEntry::~ThreadEntry() {
   pthread_cond_destroy(&wait_cond_);
 }
 
+void ThreadEntry::GetWaitDeadline(timespec* deadline) {
+  clock_gettime(CLOCK_MONOTONIC, deadline);
+  deadline->tv_sec += kDefaultWaitTimeoutSec;
+}
+
+void ThreadEntry::SetWaitTimeout(time_t seconds) {
+  pthread_mutex_lock(&wait_mutex_);
+  wait_timeout_sec_ = seconds;
+  pthread_mutex_unlock(&wait_mutex_);
+}
+
 bool ThreadEntry::Wait(int value) {
+  pthread_mutex_lock(&wait_mutex_);
+  time_t timeout_sec = wait_timeout_sec_;
+  pthread_mutex_unlock(&wait_mutex_);
+
   timespec ts;
   clock_gettime(CLOCK_MONOTONIC, &ts);
-  ts.tv_sec += 5;
+  ts.tv_sec += timeout_sec;
+  return WaitUntil(value, ts);
+}
 
+bool ThreadEntry::WaitUntil(int value, const timespec& deadline) {
   bool wait_completed = true;
   pthread_mutex_lock(&wait_mutex_);
   while (wait_value_ != value) {
-    int ret = pthread_cond_timedwait(&wait_cond_, &wait_mutex_, &ts);
+    int ret = pthread_cond_timedwait(&wait_cond_, &wait_mutex_, &deadline);
     if (ret != 0) {
       BACK_ASYNC_SAFE_LOGW("pthread_cond_timedwait for value %d failed: %s", value, strerror(ret));
       wait_completed = false;
@@ -19,6 +19,7 @@
 
 #include <pthread.h>
 #include <sys/types.h>
+#include <time.h>
 #include <ucontext.h>
 
 class ThreadEntry {
@@ -31,6 +32,15 @@ class ThreadEntry {
 
   bool Wait(int);
 
+  // Same as Wait, but gives up at the given CLOCK_MONOTONIC time, so that
+  // the waits for many threads can share a single timeout.
+  bool WaitUntil(int, const timespec& deadline);
+
+  static void GetWaitDeadline(timespec* deadline);
+
+  // Set how long Wait waits, until the next time the entry is locked.
+  void SetWaitTimeout(time_t seconds);
+
   void CopyUcontextFromSigcontext(void*);
 
   inline void Lock() {
@@ -39,6 +49,7 @@ class ThreadEntry {
     // Always reset the wait value since this could be the first or nth
     // time this entry is locked.
     wait_value_ = 0;
+    wait_timeout_sec_ = kDefaultWaitTimeoutSec;
   }
 
   inline void Unlock() {
@@ -48,6 +59,8 @@ class ThreadEntry {
   inline ucontext_t* GetUcontext() { return &ucontext_; }
 
  private:
+  static constexpr time_t kDefaultWaitTimeoutSec = 5;
+
   ThreadEntry(pid_t pid, pid_t tid);
   ~ThreadEntry();
 
@@ -60,6 +73,7 @@ class ThreadEntry {
   pthread_mutex_t wait_mutex_;
   pthread_cond_t wait_cond_;
   int wait_value_;
+  time_t wait_timeout_sec_;
   ThreadEntry* next_;
   ThreadEntry* prev_;
   ucontext_t ucontext_;
@@ -15,6 +15,7 @@
  */
 
 #define _GNU_SOURCE 1
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,7 +25,7 @@
 #include <string>
 
 #include <backtrace/Backtrace.h>
-#include <demangle.h>
+#include <unwindstack/DemangleCache.h>
 #include <unwindstack/Elf.h>
 #include <unwindstack/MapInfo.h>
 #include <unwindstack/Maps.h>
@@ -41,33 +42,74 @@
 #include "UnwindStack.h"
 #include "UnwindStackMap.h"
 
-bool Backtrace::Unwind(unwindstack::Regs* regs, BacktraceMap* back_map,
-                       std::vector<backtrace_frame_data_t>* frames, size_t num_ignore_frames,
-                       std::vector<std::string>* skip_names, BacktraceUnwindError* error) {
-  UnwindStackMap* stack_map = reinterpret_cast<UnwindStackMap*>(back_map);
-  auto process_memory = stack_map->process_memory();
-  unwindstack::Unwinder unwinder(MAX_BACKTRACE_FRAMES + num_ignore_frames, stack_map->stack_maps(),
-                                 regs, stack_map->process_memory());
-  unwinder.SetResolveNames(stack_map->ResolveNames());
+// The unwinder used by the last unwind on a thread. The next unwind on the
+// thread with the same map reuses it, and the frame buffers it holds, so
+// that they are not allocated again for every unwind.
+struct UnwinderContext {
+  std::unique_ptr<unwindstack::Unwinder> unwinder;
+  uint64_t map_id = 0;
+  size_t max_frames = 0;
+  // Swapped with the frames of the unwinder after every unwind.
+  std::vector<unwindstack::FrameData> frames;
+  bool in_use = false;
+};
+
+// The context of every thread is kept behind a key rather than in a
+// thread_local object, so that nothing is destroyed at exit.
+static pthread_key_t g_unwinder_context_key;
+static pthread_once_t g_unwinder_context_once = PTHREAD_ONCE_INIT;
+
+static void DeleteUnwinderContext(void* context) {
+  delete reinterpret_cast<UnwinderContext*>(context);
+}
+
+static UnwinderContext* GetThreadUnwinderContext() {
+  pthread_once(&g_unwinder_context_once, []() {
+    pthread_key_create(&g_unwinder_context_key, DeleteUnwinderContext);
+  });
+  UnwinderContext* context =
+      reinterpret_cast<UnwinderContext*>(pthread_getspecific(g_unwinder_context_key));
+  if (context == nullptr) {
+    context = new UnwinderContext;
+    pthread_setspecific(g_unwinder_context_key, context);
+  }
+  return context;
+}
+
+static void UnwindWithContext(UnwinderContext* context, unwindstack::Regs* regs,
+                              UnwindStackMap* stack_map, size_t max_frames,
+                              std::vector<std::string>* skip_names, BacktraceUnwindError* error) {
+  if (context->unwinder == nullptr || context->map_id != stack_map->id() ||
+      context->max_frames != max_frames ||
+      context->unwinder->GetProcessMemory() != stack_map->process_memory()) {
+    context->unwinder.reset(new unwindstack::Unwinder(max_frames, stack_map->stack_maps(), regs,
+                                                      stack_map->process_memory()));
+    context->map_id = stack_map->id();
+    context->max_frames = max_frames;
+  }
+  unwindstack::Unwinder* unwinder = context->unwinder.get();
+  unwinder->SetRegs(regs);
+  unwinder->SetResolveNames(stack_map->ResolveNames());
   stack_map->SetArch(regs->Arch());
   if (stack_map->GetJitDebug() != nullptr) {
-    unwinder.SetJitDebug(stack_map->GetJitDebug(), regs->Arch());
+    unwinder->SetJitDebug(stack_map->GetJitDebug(), regs->Arch());
   }
 #if !defined(NO_LIBDEXFILE_SUPPORT)
   if (stack_map->GetDexFiles() != nullptr) {
-    unwinder.SetDexFiles(stack_map->GetDexFiles(), regs->Arch());
+    unwinder->SetDexFiles(stack_map->GetDexFiles(), regs->Arch());
   }
 #endif
-  unwinder.Unwind(skip_names, &stack_map->GetSuffixesToIgnore());
+  unwinder->Unwind(skip_names, &stack_map->GetSuffixesToIgnore());
+  unwinder->SwapFrames(&context->frames);
   if (error != nullptr) {
-    switch (unwinder.LastErrorCode()) {
+    switch (unwinder->LastErrorCode()) {
       case unwindstack::ERROR_NONE:
         error->error_code = BACKTRACE_UNWIND_NO_ERROR;
         break;
 
       case unwindstack::ERROR_MEMORY_INVALID:
         error->error_code = BACKTRACE_UNWIND_ERROR_ACCESS_MEM_FAILED;
-        error->error_info.addr = unwinder.LastErrorAddress();
+        error->error_info.addr = unwinder->LastErrorAddress();
         break;
 
       case unwindstack::ERROR_UNWIND_INFO:
@@ -93,18 +135,37 @@ bool Backtrace::Unwind(unwindstack::Regs* regs, BacktraceMap* back_map,
       case unwindstack::ERROR_INVALID_ELF:
         error->error_code = BACKTRACE_UNWIND_ERROR_INVALID_ELF;
         break;
+
+      case unwindstack::ERROR_BUDGET_EXCEEDED:
+        error->error_code = BACKTRACE_UNWIND_ERROR_BUDGET_EXCEEDED;
+        break;
     }
   }
+}
 
-  if (num_ignore_frames >= unwinder.NumFrames()) {
-    frames->resize(0);
-    return true;
-  }
+bool Backtrace::Unwind(unwindstack::Regs* regs, BacktraceMap* back_map,
+                       std::vector<backtrace_frame_data_t>* frames, size_t num_ignore_frames,
+                       std::vector<std::string>* skip_names, BacktraceUnwindError* error) {
+  UnwindStackMap* stack_map = reinterpret_cast<UnwindStackMap*>(back_map);
 
-  auto unwinder_frames = unwinder.frames();
-  frames->resize(unwinder.NumFrames() - num_ignore_frames);
+  // A signal handler that unwinds can interrupt an unwind on the same
+  // thread, so it gets an unwinder of its own.
+  UnwinderContext* context = GetThreadUnwinderContext();
+  UnwinderContext signal_context;
+  if (context->in_use) {
+    context = &signal_context;
+  }
+  context->in_use = true;
+  UnwindWithContext(context, regs, stack_map, MAX_BACKTRACE_FRAMES + num_ignore_frames,
+                    skip_names, error);
+
+  // The names are moved out of the unwinder frames, which are cleared by
+  // the next unwind anyway.
+  std::vector<unwindstack::FrameData>& unwinder_frames = context->frames;
+  size_t num_frames = unwinder_frames.size();
+  frames->resize(num_ignore_frames >= num_frames ? 0 : num_frames - num_ignore_frames);
   size_t cur_frame = 0;
-  for (size_t i = num_ignore_frames; i < unwinder.NumFrames(); i++) {
+  for (size_t i = num_ignore_frames; i < num_frames; i++) {
     auto frame = &unwinder_frames[i];
 
     backtrace_frame_data_t* back_frame = &frames->at(cur_frame);
@@ -115,16 +176,18 @@ bool Backtrace::Unwind(unwindstack::Regs* regs, BacktraceMap* back_map,
     back_frame->pc = frame->pc;
     back_frame->sp = frame->sp;
 
-    back_frame->func_name = demangle(frame->function_name.c_str());
+    back_frame->func_name = std::move(frame->function_name);
+    unwindstack::DemangleCache::Demangle(&back_frame->func_name);
     back_frame->func_offset = frame->function_offset;
 
-    back_frame->map.name = frame->map_name;
+    back_frame->map.name = std::move(frame->map_name);
     back_frame->map.start = frame->map_start;
     back_frame->map.end = frame->map_end;
     back_frame->map.offset = frame->map_elf_start_offset;
     back_frame->map.load_bias = frame->map_load_bias;
     back_frame->map.flags = frame->map_flags;
   }
+  context->in_use = false;
 
   return true;
 }
@@ -163,11 +226,10 @@ bool UnwindStackCurrent::UnwindFromContext(size_t num_ignore_frames, void* ucont
     regs.reset(unwindstack::Regs::CreateFromUcontext(unwindstack::Regs::CurrentArch(), ucontext));
   }
 
-  std::vector<std::string> skip_names{"libunwindstack.so", "libbacktrace.so"};
-  if (!skip_frames_) {
-    skip_names.clear();
-  }
-  return Backtrace::Unwind(regs.get(), GetMap(), &frames_, num_ignore_frames, &skip_names, &error_);
+  // Only read by the unwind, so it is shared by every unwind.
+  static auto* skip_names = new std::vector<std::string>{"libunwindstack.so", "libbacktrace.so"};
+  return Backtrace::Unwind(regs.get(), GetMap(), &frames_, num_ignore_frames,
+                           skip_frames_ ? skip_names : nullptr, &error_);
 }
 
 UnwindStackPtrace::UnwindStackPtrace(pid_t pid, pid_t tid, BacktraceMap* map)
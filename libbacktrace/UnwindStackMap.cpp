@@ -30,7 +30,9 @@
 #include "UnwindStackMap.h"
 
 //-------------------------------------------------------------------------
-UnwindStackMap::UnwindStackMap(pid_t pid) : BacktraceMap(pid) {}
+std::atomic_uint64_t UnwindStackMap::next_id_ = 1;
+
+UnwindStackMap::UnwindStackMap(pid_t pid) : BacktraceMap(pid), id_(next_id_++) {}
 
 bool UnwindStackMap::Build() {
   if (pid_ == 0) {
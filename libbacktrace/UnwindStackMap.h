@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -61,6 +62,10 @@ class UnwindStackMap : public BacktraceMap {
 
   void SetArch(unwindstack::ArchEnum arch) { arch_ = arch; }
 
+  // Different for every map object, even one created at the address of a
+  // map that was deleted.
+  uint64_t id() { return id_; }
+
  protected:
   uint64_t GetLoadBias(size_t index) override;
 
@@ -72,6 +77,9 @@ class UnwindStackMap : public BacktraceMap {
 #endif
 
   unwindstack::ArchEnum arch_ = unwindstack::ARCH_UNKNOWN;
+
+  uint64_t id_;
+  static std::atomic_uint64_t next_id_;
 };
 
 class UnwindStackOfflineMap : public UnwindStackMap {
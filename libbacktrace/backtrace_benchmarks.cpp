@@ -24,6 +24,7 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <memory>
 #include <string>
 
 #include <android-base/file.h>
@@ -163,4 +164,14 @@ static void BM_create_backtrace(benchmark::State& state) {
 }
 BENCHMARK(BM_create_backtrace);
 
+static void BM_unwind_backtrace(benchmark::State& state) {
+  std::unique_ptr<BacktraceMap> backtrace_map(BacktraceMap::Create(getpid()));
+  std::unique_ptr<Backtrace> backtrace(
+      Backtrace::Create(getpid(), android::base::GetThreadId(), backtrace_map.get()));
+  while (state.KeepRunning()) {
+    backtrace->Unwind(0);
+  }
+}
+BENCHMARK(BM_unwind_backtrace);
+
 BENCHMARK_MAIN();
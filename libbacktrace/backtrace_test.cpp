@@ -770,6 +770,123 @@ TEST_F(BacktraceTest, thread_multiple_dump_same_map) {
   MultipleThreadDumpTest(true);
 }
 
+TEST_F(BacktraceTest, thread_unwind_all) {
+  std::vector<thread_t> runners(NUM_THREADS);
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  for (size_t i = 0; i < NUM_THREADS; i++) {
+    runners[i].tid = 0;
+    runners[i].state = 0;
+    ASSERT_TRUE(pthread_create(&runners[i].threadId, &attr, ThreadLevelRun, &runners[i]) == 0);
+  }
+
+  // Wait for tids to be set.
+  for (std::vector<thread_t>::iterator it = runners.begin(); it != runners.end(); ++it) {
+    ASSERT_TRUE(WaitForNonZero(&it->state, 30));
+  }
+
+  struct sigaction cur_action;
+  ASSERT_TRUE(sigaction(THREAD_SIGNAL, nullptr, &cur_action) == 0);
+
+  std::unique_ptr<BacktraceMap> map(BacktraceMap::Create(getpid()));
+  ASSERT_TRUE(map.get() != nullptr);
+  std::vector<std::unique_ptr<Backtrace>> backtraces;
+  ASSERT_TRUE(Backtrace::UnwindAllThreads(map.get(), &backtraces));
+
+  pid_t tid = android::base::GetThreadId();
+  for (auto& backtrace : backtraces) {
+    ASSERT_NE(tid, backtrace->Tid());
+  }
+  for (size_t i = 0; i < NUM_THREADS; i++) {
+    auto backtrace = std::find_if(backtraces.begin(), backtraces.end(), [&](const auto& bt) {
+      return bt->Tid() == runners[i].tid;
+    });
+    ASSERT_TRUE(backtrace != backtraces.end()) << "Thread " << runners[i].tid << " not unwound";
+    VERIFY_NO_ERROR((*backtrace)->GetError().error_code);
+    VerifyLevelDump(backtrace->get());
+
+    // Tell the runner thread to exit its infinite loop.
+    android_atomic_acquire_store(0, &runners[i].state);
+  }
+
+  // Verify that the old action was restored.
+  struct sigaction new_action;
+  ASSERT_TRUE(sigaction(THREAD_SIGNAL, nullptr, &new_action) == 0);
+  EXPECT_EQ(cur_action.sa_sigaction, new_action.sa_sigaction);
+}
+
+static void* ThreadBlockSignalRun(void* data) {
+  thread_t* thread = reinterpret_cast<thread_t*>(data);
+
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, THREAD_SIGNAL);
+  pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+  thread->tid = android::base::GetThreadId();
+  ThreadSetState(data);
+  return nullptr;
+}
+
+TEST_F(BacktraceTest, thread_unwind_all_with_blocked_thread) {
+  std::vector<thread_t> runners(NUM_THREADS);
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  for (size_t i = 0; i < NUM_THREADS; i++) {
+    runners[i].tid = 0;
+    runners[i].state = 0;
+    ASSERT_TRUE(pthread_create(&runners[i].threadId, &attr, ThreadLevelRun, &runners[i]) == 0);
+  }
+  thread_t blocked = {0, 0, 0, nullptr};
+  ASSERT_TRUE(pthread_create(&blocked.threadId, &attr, ThreadBlockSignalRun, &blocked) == 0);
+
+  // Wait for tids to be set.
+  for (std::vector<thread_t>::iterator it = runners.begin(); it != runners.end(); ++it) {
+    ASSERT_TRUE(WaitForNonZero(&it->state, 30));
+  }
+  ASSERT_TRUE(WaitForNonZero(&blocked.state, 30));
+
+  // The blocked thread never stops, so the other threads have to stay
+  // stopped past the point where the wait for it times out.
+  std::unique_ptr<BacktraceMap> map(BacktraceMap::Create(getpid()));
+  ASSERT_TRUE(map.get() != nullptr);
+  std::vector<std::unique_ptr<Backtrace>> backtraces;
+  uint64_t start = NanoTime();
+  ASSERT_TRUE(Backtrace::UnwindAllThreads(map.get(), &backtraces));
+  // If the stopped threads had given up waiting in the signal handler, the
+  // wait for them to leave the handler would time out as well.
+  ASSERT_LT(NanoTime() - start, 9 * NS_PER_SEC);
+
+  auto find_backtrace = [&backtraces](pid_t tid) {
+    return std::find_if(backtraces.begin(), backtraces.end(),
+                        [tid](const auto& bt) { return bt->Tid() == tid; });
+  };
+  auto backtrace = find_backtrace(blocked.tid);
+  ASSERT_TRUE(backtrace != backtraces.end());
+  ASSERT_EQ(BACKTRACE_UNWIND_ERROR_THREAD_TIMEOUT, (*backtrace)->GetError().error_code);
+  android_atomic_acquire_store(0, &blocked.state);
+
+  for (size_t i = 0; i < NUM_THREADS; i++) {
+    backtrace = find_backtrace(runners[i].tid);
+    ASSERT_TRUE(backtrace != backtraces.end()) << "Thread " << runners[i].tid << " not unwound";
+    VERIFY_NO_ERROR((*backtrace)->GetError().error_code);
+    VerifyLevelDump(backtrace->get());
+
+    // Tell the runner thread to exit its infinite loop.
+    android_atomic_acquire_store(0, &runners[i].state);
+  }
+}
+
+TEST_F(BacktraceTest, thread_unwind_all_no_map) {
+  std::vector<std::unique_ptr<Backtrace>> backtraces;
+  ASSERT_FALSE(Backtrace::UnwindAllThreads(nullptr, &backtraces));
+  ASSERT_TRUE(backtraces.empty());
+}
+
 // This test is for UnwindMaps that should share the same map cursor when
 // multiple maps are created for the current process at the same time.
 TEST_F(BacktraceTest, simultaneous_maps) {
@@ -20,6 +20,7 @@
 #include <inttypes.h>
 #include <stdint.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -66,6 +67,8 @@ enum BacktraceUnwindErrorCode : uint32_t {
   BACKTRACE_UNWIND_ERROR_REPEATED_FRAME,
   // Unwind information stopped due to invalid elf.
   BACKTRACE_UNWIND_ERROR_INVALID_ELF,
+  // Unwind stopped because it ran out of time or memory reads.
+  BACKTRACE_UNWIND_ERROR_BUDGET_EXCEEDED,
 };
 
 struct BacktraceUnwindError {
@@ -158,6 +161,16 @@ class Backtrace {
                             std::vector<backtrace_frame_data_t>* frames,
                             BacktraceUnwindError* error = nullptr);
 
+  // Unwind every thread in the current process, except the calling thread.
+  // All of the threads are stopped at once, unwound in parallel, and then
+  // all of them are allowed to continue. One Backtrace object is added to
+  // backtraces for every thread, check the error of each object to find out
+  // whether that thread was unwound. The map is shared by all of the unwinds,
+  // it is still owned by the caller and must not be nullptr.
+  // Returns false if the threads could not be stopped at all.
+  static bool UnwindAllThreads(BacktraceMap* map,
+                               std::vector<std::unique_ptr<Backtrace>>* backtraces);
+
   // Get the function name and offset into the function given the pc.
   // If the string is empty, then no valid function name was found,
   // or the pc is not in any valid map.
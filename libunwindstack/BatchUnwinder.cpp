@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unwindstack/BatchUnwinder.h>
+#include <unwindstack/Maps.h>
+#include <unwindstack/Memory.h>
+#include <unwindstack/Regs.h>
+#include <unwindstack/Unwinder.h>
+
+namespace unwindstack {
+
+// The number of consecutive samples a worker takes at a time. The samples
+// are sorted, so neighbouring samples tend to share maps and unwind
+// information.
+static constexpr size_t kSamplesPerChunk = 16;
+
+class BatchUnwinder::Worker : public Unwinder {
+ public:
+  Worker(size_t max_frames, Maps* maps, std::shared_ptr<Memory> process_memory)
+      : Unwinder(max_frames, maps, process_memory), stack_snapshot_(process_memory) {
+    maps_unchanged_ = true;
+    stack_memory_ = &stack_snapshot_;
+  }
+  virtual ~Worker() = default;
+
+  void StartBatch() {
+    // The maps might have changed since the last batch.
+    last_maps_[0] = nullptr;
+    last_maps_[1] = nullptr;
+  }
+
+  void Unwind(UnwindSample* sample) {
+    stack_snapshot_.Reset(sample->stack, sample->stack_start,
+                          sample->stack_start + sample->stack_size);
+    regs_ = sample->regs;
+    Unwinder::Unwind();
+
+    // Hand the frames to the sample, and take its old frame buffer for the
+    // next unwind.
+    if (stack_hash_only_) {
+      sample->stack_hash = stack_hash_;
+      sample->num_frames = compact_frames_.size();
+    } else if (compact_frames_only_) {
+      sample->compact_frames.swap(compact_frames_);
+      compact_frames_.clear();
+    } else {
+      sample->frames.swap(frames_);
+      frames_.clear();
+    }
+    sample->error_code = last_error_.code;
+  }
+
+  void UnwindFrames(UnwindSample* sample) {
+    bool compact_frames_only = compact_frames_only_;
+    bool stack_hash_only = stack_hash_only_;
+    compact_frames_only_ = false;
+    stack_hash_only_ = false;
+    StartBatch();
+    Unwind(sample);
+    FinishBatch();
+    compact_frames_only_ = compact_frames_only;
+    stack_hash_only_ = stack_hash_only;
+  }
+
+  void FinishBatch() {
+    // Do not keep any pointer into the last sample.
+    stack_snapshot_.Reset(nullptr, 0, 0);
+    regs_ = nullptr;
+  }
+
+ private:
+  MemorySnapshot stack_snapshot_;
+};
+
+BatchUnwinder::BatchUnwinder(size_t max_frames, Maps* maps,
+                             std::shared_ptr<Memory> process_memory, size_t num_threads) {
+  num_threads = std::max(num_threads, static_cast<size_t>(1));
+  for (size_t i = 0; i < num_threads; i++) {
+    workers_.emplace_back(new Worker(max_frames, maps, process_memory));
+  }
+}
+
+BatchUnwinder::~BatchUnwinder() = default;
+
+void BatchUnwinder::SetResolveNames(bool resolve) {
+  for (auto& worker : workers_) {
+    worker->SetResolveNames(resolve);
+  }
+}
+
+void BatchUnwinder::SetCompactFrames(bool compact_frames) {
+  for (auto& worker : workers_) {
+    worker->SetCompactFrames(compact_frames);
+  }
+}
+
+void BatchUnwinder::SetStackHashOnly(bool stack_hash_only) {
+  for (auto& worker : workers_) {
+    worker->SetStackHashOnly(stack_hash_only);
+  }
+}
+
+void BatchUnwinder::SetFrameCache(size_t max_entries) {
+  for (auto& worker : workers_) {
+    worker->SetFrameCache(max_entries);
+  }
+}
+
+void BatchUnwinder::ClearFrameCache() {
+  for (auto& worker : workers_) {
+    worker->ClearFrameCache();
+  }
+}
+
+void BatchUnwinder::SetBudget(uint64_t timeout_ns, uint64_t max_memory_reads) {
+  for (auto& worker : workers_) {
+    worker->SetBudget(timeout_ns, max_memory_reads);
+  }
+}
+
+void BatchUnwinder::UnwindFrames(UnwindSample* sample) {
+  workers_[0]->UnwindFrames(sample);
+}
+
+void BatchUnwinder::UnwindBatch(UnwindSample* samples, size_t num_samples) {
+  // Unwind the samples in order of their pc, so that consecutive unwinds
+  // tend to find the same maps and use the same unwind information.
+  order_.clear();
+  order_.reserve(num_samples);
+  for (size_t i = 0; i < num_samples; i++) {
+    order_.emplace_back(samples[i].regs->pc(), i);
+  }
+  std::sort(order_.begin(), order_.end());
+
+  next_sample_ = 0;
+  std::vector<std::thread> threads;
+  // Do not start more threads than there are chunks of samples.
+  size_t num_threads =
+      std::min(workers_.size(), (num_samples + kSamplesPerChunk - 1) / kSamplesPerChunk);
+  for (size_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(&BatchUnwinder::RunWorker, this, workers_[i].get(), samples);
+  }
+  RunWorker(workers_[0].get(), samples);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void BatchUnwinder::RunWorker(Worker* worker, UnwindSample* samples) {
+  worker->StartBatch();
+  while (true) {
+    // Any idle worker takes the next chunk, so a worker that gets stuck on
+    // a few slow unwinds does not hold up the rest of the batch.
+    size_t first = next_sample_.fetch_add(kSamplesPerChunk);
+    if (first >= order_.size()) {
+      break;
+    }
+    size_t last = std::min(first + kSamplesPerChunk, order_.size());
+    for (size_t i = first; i < last; i++) {
+      worker->Unwind(&samples[order_[i].second]);
+    }
+  }
+  worker->FinishBatch();
+}
+
+}  // namespace unwindstack
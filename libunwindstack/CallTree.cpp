@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <android-base/stringprintf.h>
+
+#include <unwindstack/CallTree.h>
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Unwinder.h>
+
+namespace unwindstack {
+
+// The number of hash slots in an empty shard, must be a power of two.
+static constexpr size_t kInitialSlots = 256;
+
+struct CallTree::Shard {
+  Shard() { Reset(); }
+
+  void Reset() {
+    nodes.assign(1, Node());
+    slots.assign(kInitialSlots, 0);
+  }
+
+  size_t FindOrAdd(size_t parent, MapInfo* map_info, uint64_t rel_pc);
+  void Grow();
+
+  std::mutex mutex;
+  // All of the nodes of this shard, node 0 is the root.
+  std::vector<Node> nodes;
+  // A hash table with the index of every node but the root, keyed by the
+  // parent, map and relative pc of the node. Zero marks an empty slot.
+  std::vector<uint32_t> slots;
+};
+
+static inline size_t HashNode(size_t parent, MapInfo* map_info, uint64_t rel_pc) {
+  uint64_t hash = rel_pc;
+  hash ^= reinterpret_cast<uintptr_t>(map_info) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  hash ^= parent + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+size_t CallTree::Shard::FindOrAdd(size_t parent, MapInfo* map_info, uint64_t rel_pc) {
+  size_t mask = slots.size() - 1;
+  for (size_t slot = HashNode(parent, map_info, rel_pc) & mask;; slot = (slot + 1) & mask) {
+    size_t index = slots[slot];
+    if (index == 0) {
+      index = nodes.size();
+      nodes.emplace_back();
+      Node* node = &nodes.back();
+      node->parent = parent;
+      node->map_info = map_info;
+      node->rel_pc = rel_pc;
+      slots[slot] = index;
+      // Keep the table at most half full.
+      if (nodes.size() * 2 > slots.size()) {
+        Grow();
+      }
+      return index;
+    }
+    const Node& node = nodes[index];
+    if (node.parent == parent && node.map_info == map_info && node.rel_pc == rel_pc) {
+      return index;
+    }
+  }
+}
+
+void CallTree::Shard::Grow() {
+  slots.assign(slots.size() * 2, 0);
+  size_t mask = slots.size() - 1;
+  for (size_t index = 1; index < nodes.size(); index++) {
+    const Node& node = nodes[index];
+    size_t slot = HashNode(node.parent, node.map_info, node.rel_pc) & mask;
+    while (slots[slot] != 0) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = index;
+  }
+}
+
+CallTree::CallTree(size_t num_shards) {
+  num_shards = std::max(num_shards, static_cast<size_t>(1));
+  for (size_t i = 0; i < num_shards; i++) {
+    shards_.emplace_back(new Shard);
+  }
+}
+
+CallTree::~CallTree() = default;
+
+CallTree::Shard* CallTree::GetShard() {
+  // Give every thread its own shard, as long as there are enough of them.
+  static std::atomic_size_t next_thread_index;
+  static thread_local size_t thread_index = next_thread_index++;
+  return shards_[thread_index % shards_.size()].get();
+}
+
+void CallTree::Add(const CompactFrameData* frames, size_t num_frames, uint64_t count) {
+  Shard* shard = GetShard();
+  std::lock_guard<std::mutex> guard(shard->mutex);
+  size_t index = 0;
+  // The tree starts at the outermost frame.
+  for (size_t i = num_frames; i > 0; i--) {
+    const CompactFrameData& frame = frames[i - 1];
+    uint64_t rel_pc = frame.map_info != nullptr ? frame.rel_pc : frame.pc;
+    index = shard->FindOrAdd(index, frame.map_info, rel_pc);
+  }
+  shard->nodes[index].count += count;
+}
+
+std::vector<CallTree::Node> CallTree::GetNodes() {
+  Shard merged;
+  std::vector<size_t> merged_index;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->mutex);
+    merged.nodes[0].count += shard->nodes[0].count;
+    // A parent always comes before its children, so it has been merged
+    // by the time they are.
+    merged_index.resize(shard->nodes.size());
+    for (size_t index = 1; index < shard->nodes.size(); index++) {
+      const Node& node = shard->nodes[index];
+      size_t new_index =
+          merged.FindOrAdd(merged_index[node.parent], node.map_info, node.rel_pc);
+      merged.nodes[new_index].count += node.count;
+      merged_index[index] = new_index;
+    }
+  }
+  return std::move(merged.nodes);
+}
+
+uint64_t CallTree::TotalCount() {
+  uint64_t total = 0;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->mutex);
+    for (const Node& node : shard->nodes) {
+      total += node.count;
+    }
+  }
+  return total;
+}
+
+static void AppendULEB128(std::string* data, uint64_t value) {
+  do {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    if (value != 0) {
+      byte |= 0x80;
+    }
+    data->push_back(byte);
+  } while (value != 0);
+}
+
+static void AppendBytes(std::string* data, const std::string& bytes) {
+  AppendULEB128(data, bytes.size());
+  data->append(bytes);
+}
+
+std::string CallTree::Serialize() {
+  std::vector<Node> nodes = GetNodes();
+
+  std::vector<MapInfo*> maps;
+  std::unordered_map<MapInfo*, size_t> map_indexes;
+  for (const Node& node : nodes) {
+    if (node.map_info != nullptr && map_indexes.emplace(node.map_info, maps.size() + 1).second) {
+      maps.push_back(node.map_info);
+    }
+  }
+
+  std::string data("UWCT");
+  AppendULEB128(&data, kSerializeVersion);
+  AppendULEB128(&data, maps.size());
+  for (MapInfo* map_info : maps) {
+    AppendBytes(&data, map_info->name);
+    AppendULEB128(&data, map_info->elf_start_offset);
+    AppendBytes(&data, map_info->GetBuildID());
+  }
+  AppendULEB128(&data, nodes.size() - 1);
+  for (size_t index = 1; index < nodes.size(); index++) {
+    const Node& node = nodes[index];
+    AppendULEB128(&data, node.parent);
+    AppendULEB128(&data, node.map_info == nullptr ? 0 : map_indexes[node.map_info]);
+    AppendULEB128(&data, node.rel_pc);
+    AppendULEB128(&data, node.count);
+  }
+  return data;
+}
+
+static std::string FormatNode(const CallTree::Node& node) {
+  if (node.map_info == nullptr) {
+    return android::base::StringPrintf("0x%" PRIx64, node.rel_pc);
+  }
+  if (node.map_info->name.empty()) {
+    return android::base::StringPrintf("<anonymous:%" PRIx64 ">+0x%" PRIx64, node.map_info->start,
+                                       node.rel_pc);
+  }
+  return node.map_info->name + android::base::StringPrintf("+0x%" PRIx64, node.rel_pc);
+}
+
+std::string CallTree::FormatCollapsed() {
+  std::vector<Node> nodes = GetNodes();
+  // The stack of every node, built from the stack of its parent.
+  std::vector<std::string> stacks(nodes.size());
+  std::string data;
+  for (size_t index = 1; index < nodes.size(); index++) {
+    const Node& node = nodes[index];
+    if (node.parent != 0) {
+      stacks[index] = stacks[node.parent] + ';';
+    }
+    stacks[index] += FormatNode(node);
+    if (node.count != 0) {
+      data += stacks[index] + android::base::StringPrintf(" %" PRIu64 "\n", node.count);
+    }
+  }
+  return data;
+}
+
+void CallTree::Clear() {
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->mutex);
+    shard->Reset();
+  }
+}
+
+}  // namespace unwindstack
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stddef.h>
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <android-base/strings.h>
+
+#include <demangle.h>
+
+#include <unwindstack/DemangleCache.h>
+
+namespace unwindstack {
+
+// The names are spread across shards so that threads formatting
+// different frames rarely wait on each other.
+static constexpr size_t kDemangleShards = 8;
+
+struct DemangleCacheEntry {
+  std::string demangled;
+  std::list<const std::string*>::iterator lru;
+};
+
+struct DemangleCacheShard {
+  std::mutex lock;
+  std::unordered_map<std::string, DemangleCacheEntry> entries;
+  // The most recently used names are at the front.
+  std::list<const std::string*> lru;
+};
+
+struct DemangleCacheState {
+  std::atomic_size_t max_entries_per_shard{DemangleCache::kDefaultMaxEntries / kDemangleShards};
+  DemangleCacheShard shards[kDemangleShards];
+};
+
+static DemangleCacheState* GetState() {
+  static DemangleCacheState* state = new DemangleCacheState;
+  return state;
+}
+
+// Evict the least recently used names until there are at most
+// max_entries. Must be called with the shard lock held.
+static void EvictLocked(DemangleCacheShard* shard, size_t max_entries) {
+  while (shard->entries.size() > max_entries) {
+    auto entry = shard->entries.find(*shard->lru.back());
+    shard->lru.pop_back();
+    shard->entries.erase(entry);
+  }
+}
+
+std::string DemangleCache::Demangle(const std::string& name) {
+  // Only names using the Itanium C++ ABI mangling are changed by demangle.
+  if (!android::base::StartsWith(name, "_Z")) {
+    return name;
+  }
+
+  DemangleCacheState* state = GetState();
+  size_t max_entries = state->max_entries_per_shard;
+  if (max_entries == 0) {
+    return demangle(name.c_str());
+  }
+
+  DemangleCacheShard* shard = &state->shards[std::hash<std::string>()(name) % kDemangleShards];
+  {
+    std::lock_guard<std::mutex> guard(shard->lock);
+    auto entry = shard->entries.find(name);
+    if (entry != shard->entries.end()) {
+      shard->lru.splice(shard->lru.begin(), shard->lru, entry->second.lru);
+      return entry->second.demangled;
+    }
+  }
+
+  // Do not hold the lock while demangling.
+  std::string demangled(demangle(name.c_str()));
+  std::lock_guard<std::mutex> guard(shard->lock);
+  auto result = shard->entries.emplace(name, DemangleCacheEntry{demangled, {}});
+  if (result.second) {
+    shard->lru.push_front(&result.first->first);
+    result.first->second.lru = shard->lru.begin();
+    EvictLocked(shard, max_entries);
+  }
+  return demangled;
+}
+
+void DemangleCache::Demangle(std::string* name) {
+  if (android::base::StartsWith(*name, "_Z")) {
+    *name = Demangle(*name);
+  }
+}
+
+void DemangleCache::SetMaxEntries(size_t max_entries) {
+  DemangleCacheState* state = GetState();
+  size_t max_entries_per_shard = max_entries / kDemangleShards;
+  if (max_entries != 0 && max_entries_per_shard == 0) {
+    max_entries_per_shard = 1;
+  }
+  state->max_entries_per_shard = max_entries_per_shard;
+  for (auto& shard : state->shards) {
+    std::lock_guard<std::mutex> guard(shard.lock);
+    EvictLocked(&shard, max_entries_per_shard);
+  }
+}
+
+size_t DemangleCache::Total() {
+  size_t total = 0;
+  for (auto& shard : GetState()->shards) {
+    std::lock_guard<std::mutex> guard(shard.lock);
+    total += shard.entries.size();
+  }
+  return total;
+}
+
+void DemangleCache::Clear() {
+  for (auto& shard : GetState()->shards) {
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.entries.clear();
+    shard.lru.clear();
+  }
+}
+
+}  // namespace unwindstack
@@ -23,6 +23,7 @@
 #include "Check.h"
 #include "DwarfEhFrameWithHdr.h"
 #include "DwarfEncoding.h"
+#include "MemoryUsage.h"
 
 namespace unwindstack {
 
@@ -194,6 +195,11 @@ void DwarfEhFrameWithHdr<AddressType>::GetFdes(std::vector<const DwarfFde*>* fde
   }
 }
 
+template <typename AddressType>
+uint64_t DwarfEhFrameWithHdr<AddressType>::MemoryUsage() {
+  return DwarfSection::MemoryUsage() + ContainerMemoryUsage(fde_info_);
+}
+
 // Explicitly instantiate DwarfEhFrameWithHdr
 template class DwarfEhFrameWithHdr<uint32_t>;
 template class DwarfEhFrameWithHdr<uint64_t>;
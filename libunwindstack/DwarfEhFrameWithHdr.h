@@ -71,6 +71,8 @@ class DwarfEhFrameWithHdr : public DwarfSectionImpl<AddressType> {
 
   void GetFdes(std::vector<const DwarfFde*>* fdes) override;
 
+  uint64_t MemoryUsage() override;
+
  protected:
   uint8_t version_;
   uint8_t ptr_encoding_;
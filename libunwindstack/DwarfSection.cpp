@@ -30,6 +30,7 @@
 #include "DwarfEhFrame.h"
 #include "DwarfEncoding.h"
 #include "DwarfOp.h"
+#include "MemoryUsage.h"
 #include "RegsInfo.h"
 
 namespace unwindstack {
@@ -62,6 +63,17 @@ bool DwarfSection::Step(uint64_t pc, Regs* regs, Memory* process_memory, bool* f
   return Eval(it->second.cie, process_memory, it->second, regs, finished);
 }
 
+uint64_t DwarfSection::MemoryUsage() {
+  // Rows of register locations are small, so use a fixed estimate for each
+  // row rather than walking all of them.
+  constexpr uint64_t kRowLocations = 8;
+  constexpr uint64_t kRowUsage =
+      kRowLocations * (sizeof(dwarf_loc_regs_t::value_type) + 3 * sizeof(void*));
+  return ContainerMemoryUsage(fde_entries_) + ContainerMemoryUsage(cie_entries_) +
+         ContainerMemoryUsage(cie_loc_regs_) + ContainerMemoryUsage(loc_regs_) +
+         (cie_loc_regs_.size() + loc_regs_.size()) * kRowUsage;
+}
+
 template <typename AddressType>
 const DwarfCie* DwarfSectionImpl<AddressType>::GetCieFromOffset(uint64_t offset) {
   auto cie_entry = cie_entries_.find(offset);
@@ -802,6 +814,11 @@ const DwarfFde* DwarfSectionImplNoHdr<AddressType>::GetFdeFromPc(uint64_t pc) {
   return nullptr;
 }
 
+template <typename AddressType>
+uint64_t DwarfSectionImplNoHdr<AddressType>::MemoryUsage() {
+  return DwarfSection::MemoryUsage() + ContainerMemoryUsage(fdes_);
+}
+
 // Explicitly instantiate DwarfSectionImpl
 template class DwarfSectionImpl<uint32_t>;
 template class DwarfSectionImpl<uint64_t>;
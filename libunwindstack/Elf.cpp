@@ -16,17 +16,25 @@
 
 #include <elf.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #define LOG_TAG "unwind"
 #include <log/log.h>
 
 #include <unwindstack/Elf.h>
 #include <unwindstack/ElfInterface.h>
+#include <unwindstack/GnuDebugdataCache.h>
 #include <unwindstack/MapInfo.h>
 #include <unwindstack/Memory.h>
 #include <unwindstack/Regs.h>
@@ -36,9 +44,47 @@
 
 namespace unwindstack {
 
+static constexpr size_t kCacheShards = 16;
+
+struct ElfCacheKeyHash {
+  size_t operator()(const ElfCacheKey& key) const {
+    uint64_t hash = key.ino * 0x9e3779b97f4a7c15ULL;
+    hash ^= key.dev + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    hash ^= key.offset + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    return static_cast<size_t>(hash ^ (hash >> 32));
+  }
+};
+
+struct ElfCacheEntry {
+  std::shared_ptr<Elf> elf;
+  bool set_elf_offset = false;
+  // Set while a thread is creating the elf for this entry.
+  bool pending = false;
+  // The value of the cache clock when this entry was last used.
+  uint64_t last_used = 0;
+  std::string name;
+};
+
+struct ElfCacheShard {
+  std::mutex lock;
+  std::condition_variable cond;
+  std::unordered_map<ElfCacheKey, ElfCacheEntry, ElfCacheKeyHash> entries;
+};
+
+struct ElfCache {
+  ElfCacheShard shards[kCacheShards];
+  std::atomic<uint64_t> clock{0};
+  std::atomic<uint64_t> max_size{0};
+  // The estimated size of the cached elf objects. An elf adds its size when
+  // it is added, and every scan of the cache corrects the estimate, so the
+  // cache is only scanned when it might be larger than the maximum size.
+  std::atomic<uint64_t> total_size{0};
+  // Only one thread evicts elf objects at a time.
+  std::mutex evict_lock;
+};
+
 bool Elf::cache_enabled_;
-std::unordered_map<std::string, std::pair<std::shared_ptr<Elf>, bool>>* Elf::cache_;
-std::mutex* Elf::cache_lock_;
+ElfCache* Elf::cache_;
 
 bool Elf::Init() {
   load_bias_ = 0;
@@ -68,7 +114,23 @@ void Elf::InitGnuDebugdata() {
     return;
   }
 
-  gnu_debugdata_memory_.reset(interface_->CreateGnuDebugdataMemory());
+  // The decompressed data only depends on the file contents, so it can be
+  // shared with any other elf that has the same build id.
+  std::string build_id;
+  if (GnuDebugdataCache::Enabled()) {
+    build_id = interface_->GetBuildID();
+  }
+  if (!build_id.empty()) {
+    gnu_debugdata_memory_ = GnuDebugdataCache::Get(build_id);
+  }
+  if (gnu_debugdata_memory_ == nullptr) {
+    std::shared_ptr<MemoryBuffer> memory(interface_->CreateGnuDebugdataMemory());
+    if (memory != nullptr && !build_id.empty()) {
+      gnu_debugdata_memory_ = GnuDebugdataCache::Add(build_id, memory);
+    } else {
+      gnu_debugdata_memory_ = memory;
+    }
+  }
   gnu_debugdata_interface_.reset(CreateInterfaceFromMemory(gnu_debugdata_memory_.get()));
   ElfInterface* gnu = gnu_debugdata_interface_.get();
   if (gnu == nullptr) {
@@ -83,11 +145,27 @@ void Elf::InitGnuDebugdata() {
     interface_->SetGnuDebugdataInterface(gnu);
   } else {
     // Free all of the memory associated with the gnu_debugdata section.
-    gnu_debugdata_memory_.reset(nullptr);
+    gnu_debugdata_memory_.reset();
     gnu_debugdata_interface_.reset(nullptr);
   }
 }
 
+uint64_t Elf::MemoryUsage() {
+  std::lock_guard<std::mutex> guard(lock_);
+  uint64_t usage = sizeof(*this);
+  if (interface_) {
+    usage += interface_->MemoryUsage();
+  }
+  if (gnu_debugdata_interface_) {
+    usage += gnu_debugdata_interface_->MemoryUsage();
+  }
+  uint64_t size;
+  if (gnu_debugdata_memory_ != nullptr && GetInfo(gnu_debugdata_memory_.get(), &size)) {
+    usage += size;
+  }
+  return usage;
+}
+
 void Elf::Invalidate() {
   interface_.reset(nullptr);
   valid_ = false;
@@ -112,6 +190,17 @@ bool Elf::GetFunctionName(uint64_t addr, std::string* name, uint64_t* func_offse
                      gnu_debugdata_interface_->GetFunctionName(addr, name, func_offset)));
 }
 
+void Elf::GetFunctionNames(const uint64_t* addrs, size_t count, FunctionInfo* functions) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (!valid_) {
+    return;
+  }
+  interface_->GetFunctionNames(addrs, count, functions);
+  if (gnu_debugdata_interface_ != nullptr) {
+    gnu_debugdata_interface_->GetFunctionNames(addrs, count, functions);
+  }
+}
+
 bool Elf::GetGlobalVariable(const std::string& name, uint64_t* memory_address) {
   if (!valid_) {
     return false;
@@ -317,78 +406,258 @@ uint64_t Elf::GetLoadBias(Memory* memory) {
   return 0;
 }
 
-void Elf::SetCachingEnabled(bool enable) {
+static ElfCacheShard* GetCacheShard(ElfCache* cache, const ElfCacheKey& key) {
+  return &cache->shards[ElfCacheKeyHash()(key) % kCacheShards];
+}
+
+// Must be called with the shard lock for the entry held.
+static void CacheMarkUsed(ElfCache* cache, ElfCacheEntry* entry) {
+  entry->last_used = ++cache->clock;
+}
+
+struct ElfCacheCandidate {
+  std::shared_ptr<Elf> elf;
+  uint64_t last_used = 0;
+  uint64_t size = 0;
+  std::vector<ElfCacheKey> keys;
+};
+
+// Gather every elf in the cache, along with all of the keys that refer
+// to it, sorted from the least recently used to the most recently used.
+// The sizes are estimated without holding any shard lock, since that
+// requires taking the lock of each elf.
+static std::vector<ElfCacheCandidate> CacheGetCandidates(ElfCache* cache, uint64_t* total_size) {
+  std::unordered_map<Elf*, ElfCacheCandidate> elfs;
+  for (size_t i = 0; i < kCacheShards; i++) {
+    ElfCacheShard* shard = &cache->shards[i];
+    std::lock_guard<std::mutex> guard(shard->lock);
+    for (const auto& entry : shard->entries) {
+      if (entry.second.pending) {
+        continue;
+      }
+      ElfCacheCandidate* candidate = &elfs[entry.second.elf.get()];
+      candidate->elf = entry.second.elf;
+      candidate->last_used = std::max(candidate->last_used, entry.second.last_used);
+      candidate->keys.push_back(entry.first);
+    }
+  }
+
+  std::vector<ElfCacheCandidate> candidates;
+  candidates.reserve(elfs.size());
+  *total_size = 0;
+  for (auto& entry : elfs) {
+    entry.second.size = entry.second.elf->MemoryUsage();
+    *total_size += entry.second.size;
+    candidates.push_back(std::move(entry.second));
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const ElfCacheCandidate& a, const ElfCacheCandidate& b) {
+              return a.last_used < b.last_used;
+            });
+  return candidates;
+}
+
+// Remove the least recently used elf objects until the estimated size of
+// the cache is no larger than the maximum size. The elf objects are only
+// freed once no map refers to them anymore. Unless always_scan is set, the
+// cache is only scanned if the estimated size is over the maximum.
+static void CacheEvict(ElfCache* cache, bool always_scan = false) {
+  uint64_t max_size = cache->max_size;
+  if (max_size == 0 || (!always_scan && cache->total_size <= max_size)) {
+    return;
+  }
+  std::unique_lock<std::mutex> evict_lock(cache->evict_lock, std::try_to_lock);
+  if (!evict_lock.owns_lock()) {
+    // Another thread is already doing this.
+    return;
+  }
+
+  uint64_t estimated_size = cache->total_size;
+  uint64_t total_size;
+  std::vector<ElfCacheCandidate> candidates(CacheGetCandidates(cache, &total_size));
+  // Never evict the most recently used elf.
+  for (size_t i = 0; i + 1 < candidates.size() && total_size > max_size; i++) {
+    const ElfCacheCandidate& candidate = candidates[i];
+    bool evicted = true;
+    for (const auto& key : candidate.keys) {
+      ElfCacheShard* shard = GetCacheShard(cache, key);
+      std::lock_guard<std::mutex> guard(shard->lock);
+      auto entry = shard->entries.find(key);
+      if (entry == shard->entries.end()) {
+        continue;
+      }
+      // Leave the entry if it changed or was used since it was examined.
+      if (entry->second.pending || entry->second.elf != candidate.elf ||
+          entry->second.last_used > candidate.last_used) {
+        evicted = false;
+        continue;
+      }
+      shard->entries.erase(entry);
+    }
+    if (evicted) {
+      total_size -= candidate.size;
+    }
+  }
+  // Replace the estimate this scan started from with the size found, but
+  // keep anything added by other threads in the meantime. The unsigned
+  // arithmetic wraps correctly when the size went down.
+  cache->total_size += total_size - estimated_size;
+}
+
+void Elf::SetCachingEnabled(bool enable, uint64_t max_size) {
   if (!cache_enabled_ && enable) {
     cache_enabled_ = true;
-    cache_ = new std::unordered_map<std::string, std::pair<std::shared_ptr<Elf>, bool>>;
-    cache_lock_ = new std::mutex;
+    cache_ = new ElfCache;
+    cache_->max_size = max_size;
   } else if (cache_enabled_ && !enable) {
     cache_enabled_ = false;
     delete cache_;
-    delete cache_lock_;
+  } else if (cache_enabled_) {
+    cache_->max_size = max_size;
+    CacheEvict(cache_, true);
+  }
+}
+
+uint64_t Elf::CacheSize() {
+  if (!cache_enabled_) {
+    return 0;
+  }
+  uint64_t total_size;
+  CacheGetCandidates(cache_, &total_size);
+  return total_size;
+}
+
+void Elf::CacheGetEntries(std::vector<ElfCacheEntryInfo>* entries) {
+  entries->clear();
+  if (!cache_enabled_) {
+    return;
+  }
+
+  uint64_t total_size;
+  for (const auto& candidate : CacheGetCandidates(cache_, &total_size)) {
+    bool first = true;
+    for (const auto& key : candidate.keys) {
+      ElfCacheShard* shard = GetCacheShard(cache_, key);
+      std::lock_guard<std::mutex> guard(shard->lock);
+      auto entry = shard->entries.find(key);
+      if (entry == shard->entries.end() || entry->second.elf != candidate.elf) {
+        continue;
+      }
+      entries->push_back(ElfCacheEntryInfo{key, entry->second.name, first ? candidate.size : 0});
+      first = false;
+    }
   }
 }
 
-void Elf::CacheLock() {
-  cache_lock_->lock();
+bool Elf::CacheGetKey(MapInfo* info, ElfCacheKey* key) {
+  struct stat buf;
+  if (info->name.empty() || stat(info->name.c_str(), &buf) == -1) {
+    return false;
+  }
+  key->dev = buf.st_dev;
+  key->ino = buf.st_ino;
+  key->offset = info->offset;
+  return true;
 }
 
-void Elf::CacheUnlock() {
-  cache_lock_->unlock();
+// Publish the elf for the entry this thread claimed in CacheGet, and wake
+// up any threads waiting for it.
+static void CachePublish(ElfCache* cache, const ElfCacheKey& key, MapInfo* info,
+                         bool set_elf_offset) {
+  ElfCacheShard* shard = GetCacheShard(cache, key);
+  std::lock_guard<std::mutex> guard(shard->lock);
+  ElfCacheEntry& entry = shard->entries[key];
+  entry.elf = info->elf;
+  entry.set_elf_offset = set_elf_offset;
+  entry.pending = false;
+  entry.name = info->name;
+  CacheMarkUsed(cache, &entry);
+  shard->cond.notify_all();
 }
 
-void Elf::CacheAdd(MapInfo* info) {
-  // If elf_offset != 0, then cache both name:offset and name.
-  // The cached name is used to do lookups if multiple maps for the same
-  // named elf file exist.
+void Elf::CacheAdd(const ElfCacheKey& key, MapInfo* info) {
+  // If elf_offset != 0, then cache both the entry at offset and the
+  // entry at offset zero, which represents the whole file.
+  // The whole file entry is used to do lookups if multiple maps for the
+  // same elf file exist.
   // For example, if there are two maps boot.odex:1000 and boot.odex:2000
   // where each reference the entire boot.odex, the cache will properly
   // use the same cached elf object.
-
-  if (info->offset == 0 || info->elf_offset != 0) {
-    (*cache_)[info->name] = std::make_pair(info->elf, true);
+  if (info->offset != 0 && info->elf_offset != 0) {
+    ElfCacheKey file_key{key.dev, key.ino, 0};
+    ElfCacheShard* shard = GetCacheShard(cache_, file_key);
+    std::lock_guard<std::mutex> guard(shard->lock);
+    // Never replace an existing entry, another thread might be creating it.
+    auto entry = shard->entries.try_emplace(file_key);
+    if (entry.second) {
+      entry.first->second.elf = info->elf;
+      entry.first->second.set_elf_offset = true;
+      entry.first->second.name = info->name;
+      CacheMarkUsed(cache_, &entry.first->second);
+    }
   }
 
-  if (info->offset != 0) {
-    // The second element in the pair indicates whether elf_offset should
-    // be set to offset when getting out of the cache.
-    (*cache_)[info->name + ':' + std::to_string(info->offset)] =
-        std::make_pair(info->elf, info->elf_offset != 0);
-  }
+  // The set_elf_offset value indicates whether elf_offset should be set
+  // to offset when getting out of the cache.
+  CachePublish(cache_, key, info, info->offset == 0 || info->elf_offset != 0);
+
+  // Only a newly created elf adds to the size, CacheAfterCreateMemory reuses
+  // an elf that is already in the cache.
+  cache_->total_size += info->elf->MemoryUsage();
+  CacheEvict(cache_);
 }
 
-bool Elf::CacheAfterCreateMemory(MapInfo* info) {
-  if (info->name.empty() || info->offset == 0 || info->elf_offset == 0) {
+bool Elf::CacheAfterCreateMemory(const ElfCacheKey& key, MapInfo* info) {
+  if (info->offset == 0 || info->elf_offset == 0) {
     return false;
   }
 
-  auto entry = cache_->find(info->name);
-  if (entry == cache_->end()) {
-    return false;
+  ElfCacheKey file_key{key.dev, key.ino, 0};
+  {
+    ElfCacheShard* shard = GetCacheShard(cache_, file_key);
+    std::unique_lock<std::mutex> lock(shard->lock);
+    auto entry = shard->entries.find(file_key);
+    while (entry != shard->entries.end() && entry->second.pending) {
+      shard->cond.wait(lock);
+      entry = shard->entries.find(file_key);
+    }
+    if (entry == shard->entries.end()) {
+      return false;
+    }
+    info->elf = entry->second.elf;
+    CacheMarkUsed(cache_, &entry->second);
   }
 
-  // In this case, the whole file is the elf, and the name has already
-  // been cached. Add an entry at name:offset to get this directly out
+  // In this case, the whole file is the elf, and the whole file has already
+  // been cached. Complete the entry at offset to get this directly out
   // of the cache next time.
-  info->elf = entry->second.first;
-  (*cache_)[info->name + ':' + std::to_string(info->offset)] = std::make_pair(info->elf, true);
+  CachePublish(cache_, key, info, true);
   return true;
 }
 
-bool Elf::CacheGet(MapInfo* info) {
-  std::string name(info->name);
-  if (info->offset != 0) {
-    name += ':' + std::to_string(info->offset);
-  }
-  auto entry = cache_->find(name);
-  if (entry != cache_->end()) {
-    info->elf = entry->second.first;
-    if (entry->second.second) {
-      info->elf_offset = info->offset;
+bool Elf::CacheGet(const ElfCacheKey& key, MapInfo* info) {
+  ElfCacheShard* shard = GetCacheShard(cache_, key);
+  std::unique_lock<std::mutex> lock(shard->lock);
+  while (true) {
+    auto entry = shard->entries.find(key);
+    if (entry == shard->entries.end()) {
+      // Claim the entry. The caller creates the elf without holding any
+      // lock, and must then call CacheAdd or CacheAfterCreateMemory.
+      shard->entries[key].pending = true;
+      return false;
     }
-    return true;
+    if (!entry->second.pending) {
+      info->elf = entry->second.elf;
+      if (entry->second.set_elf_offset) {
+        info->elf_offset = info->offset;
+      }
+      CacheMarkUsed(cache_, &entry->second);
+      return true;
+    }
+    // Another thread is creating this elf, wait for it rather than doing
+    // the same work again.
+    shard->cond.wait(lock);
   }
-  return false;
 }
 
 std::string Elf::GetBuildID(Memory* memory) {
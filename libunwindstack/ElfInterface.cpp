@@ -16,10 +16,12 @@
 
 #include <elf.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <7zCrc.h>
 #include <Xz.h>
@@ -31,14 +33,66 @@
 #include <unwindstack/Log.h>
 #include <unwindstack/Memory.h>
 #include <unwindstack/Regs.h>
+#include <unwindstack/SFrameSection.h>
 
 #include "DwarfDebugFrame.h"
 #include "DwarfEhFrame.h"
 #include "DwarfEhFrameWithHdr.h"
+#include "MemoryUsage.h"
 #include "Symbols.h"
 
+#if !defined(PT_GNU_SFRAME)
+#define PT_GNU_SFRAME 0x6474e554
+#endif
+
+#if !defined(SHT_GNU_SFRAME)
+#define SHT_GNU_SFRAME 0x6ffffff4
+#endif
+
 namespace unwindstack {
 
+// Tables larger than this are read one entry at a time.
+static constexpr uint64_t kMaxBulkReadSize = 1024 * 1024;
+
+// Reads a table of program or section headers with a single read instead
+// of one read per entry, which matters when every read of the memory is a
+// system call. Any entry beyond what the bulk read returned is read
+// individually, so the results are the same as reading each entry.
+template <typename HdrType>
+class ElfHeaderTable {
+ public:
+  ElfHeaderTable(Memory* memory, uint64_t offset, size_t num_entries, size_t entry_size)
+      : memory_(memory), offset_(offset), num_entries_(num_entries), entry_size_(entry_size) {
+    if (num_entries == 0) {
+      return;
+    }
+    uint64_t table_size = (num_entries - 1) * entry_size + sizeof(HdrType);
+    if (table_size > kMaxBulkReadSize) {
+      return;
+    }
+    data_.resize(table_size);
+    data_.resize(memory->Read(offset, data_.data(), table_size));
+  }
+
+  bool Get(size_t index, HdrType* hdr) {
+    uint64_t entry_offset = index * entry_size_;
+    if (entry_offset + sizeof(HdrType) <= data_.size()) {
+      memcpy(hdr, &data_[entry_offset], sizeof(HdrType));
+      return true;
+    }
+    return memory_->ReadFully(offset_ + entry_offset, hdr, sizeof(HdrType));
+  }
+
+  size_t num_entries() { return num_entries_; }
+
+ private:
+  Memory* memory_;
+  uint64_t offset_;
+  size_t num_entries_;
+  size_t entry_size_;
+  std::vector<uint8_t> data_;
+};
+
 ElfInterface::~ElfInterface() {
   for (auto symbol : symbols_) {
     delete symbol;
@@ -66,10 +120,33 @@ bool ElfInterface::IsValidPc(uint64_t pc) {
     return true;
   }
 
+  SFrameSection::Fde fde;
+  if (sframe_ != nullptr && sframe_->GetFdeFromPc(pc, &fde)) {
+    return true;
+  }
+
   return false;
 }
 
-Memory* ElfInterface::CreateGnuDebugdataMemory() {
+uint64_t ElfInterface::MemoryUsage() {
+  uint64_t usage = sizeof(*this) + soname_.capacity() + ContainerMemoryUsage(pt_loads_) +
+                   ContainerMemoryUsage(symbols_) + ContainerMemoryUsage(strtabs_);
+  for (auto symbol : symbols_) {
+    usage += symbol->MemoryUsage();
+  }
+  if (eh_frame_ != nullptr) {
+    usage += eh_frame_->MemoryUsage();
+  }
+  if (debug_frame_ != nullptr) {
+    usage += debug_frame_->MemoryUsage();
+  }
+  if (sframe_ != nullptr) {
+    usage += sframe_->MemoryUsage();
+  }
+  return usage;
+}
+
+MemoryBuffer* ElfInterface::CreateGnuDebugdataMemory() {
   if (gnu_debugdata_offset_ == 0 || gnu_debugdata_size_ == 0) {
     return nullptr;
   }
@@ -156,6 +233,15 @@ void ElfInterface::InitHeadersWithTemplate(uint64_t load_bias) {
       debug_frame_size_ = static_cast<uint64_t>(-1);
     }
   }
+
+  if (sframe_offset_ != 0) {
+    sframe_.reset(new SFrameSection(memory_));
+    if (!sframe_->Init(sframe_offset_, sframe_size_, load_bias)) {
+      sframe_.reset(nullptr);
+      sframe_offset_ = 0;
+      sframe_size_ = static_cast<uint64_t>(-1);
+    }
+  }
 }
 
 template <typename EhdrType, typename PhdrType, typename ShdrType>
@@ -181,10 +267,10 @@ uint64_t ElfInterface::GetLoadBias(Memory* memory) {
     return false;
   }
 
-  uint64_t offset = ehdr.e_phoff;
-  for (size_t i = 0; i < ehdr.e_phnum; i++, offset += ehdr.e_phentsize) {
+  ElfHeaderTable<PhdrType> phdrs(memory, ehdr.e_phoff, ehdr.e_phnum, ehdr.e_phentsize);
+  for (size_t i = 0; i < phdrs.num_entries(); i++) {
     PhdrType phdr;
-    if (!memory->ReadFully(offset, &phdr, sizeof(phdr))) {
+    if (!phdrs.Get(i, &phdr)) {
       return 0;
     }
     if (phdr.p_type == PT_LOAD && phdr.p_offset == 0) {
@@ -196,10 +282,10 @@ uint64_t ElfInterface::GetLoadBias(Memory* memory) {
 
 template <typename EhdrType, typename PhdrType>
 void ElfInterface::ReadProgramHeaders(const EhdrType& ehdr, uint64_t* load_bias) {
-  uint64_t offset = ehdr.e_phoff;
-  for (size_t i = 0; i < ehdr.e_phnum; i++, offset += ehdr.e_phentsize) {
+  ElfHeaderTable<PhdrType> phdrs(memory_, ehdr.e_phoff, ehdr.e_phnum, ehdr.e_phentsize);
+  for (size_t i = 0; i < phdrs.num_entries(); i++) {
     PhdrType phdr;
-    if (!memory_->ReadFully(offset, &phdr, sizeof(phdr))) {
+    if (!phdrs.Get(i, &phdr)) {
       return;
     }
 
@@ -224,6 +310,12 @@ void ElfInterface::ReadProgramHeaders(const EhdrType& ehdr, uint64_t* load_bias)
       eh_frame_hdr_size_ = phdr.p_memsz;
       break;
 
+    case PT_GNU_SFRAME:
+      // The .sframe section, in case there are no section headers.
+      sframe_offset_ = phdr.p_offset;
+      sframe_size_ = phdr.p_memsz;
+      break;
+
     case PT_DYNAMIC:
       dynamic_offset_ = phdr.p_offset;
       dynamic_vaddr_ = phdr.p_vaddr;
@@ -289,28 +381,45 @@ std::string ElfInterface::ReadBuildID() {
   return "";
 }
 
+// Get the name of a section from the section header string table. The
+// whole table is read at once, but a name that is not terminated inside
+// the table is read directly from memory.
+static bool GetSectionName(Memory* memory, uint64_t sec_offset, const std::string& sec_data,
+                           uint64_t name_offset, std::string* name) {
+  if (name_offset < sec_data.size()) {
+    size_t end = sec_data.find('\0', name_offset);
+    if (end != std::string::npos) {
+      name->assign(sec_data, name_offset, end - name_offset);
+      return true;
+    }
+  }
+  return memory->ReadString(sec_offset + name_offset, name);
+}
+
 template <typename EhdrType, typename ShdrType>
 void ElfInterface::ReadSectionHeaders(const EhdrType& ehdr) {
-  uint64_t offset = ehdr.e_shoff;
+  ElfHeaderTable<ShdrType> shdrs(memory_, ehdr.e_shoff, ehdr.e_shnum, ehdr.e_shentsize);
   uint64_t sec_offset = 0;
   uint64_t sec_size = 0;
+  std::string sec_data;
 
   // Get the location of the section header names.
   // If something is malformed in the header table data, we aren't going
   // to terminate, we'll simply ignore this part.
   ShdrType shdr;
-  if (ehdr.e_shstrndx < ehdr.e_shnum) {
-    uint64_t sh_offset = offset + ehdr.e_shstrndx * ehdr.e_shentsize;
-    if (memory_->ReadFully(sh_offset, &shdr, sizeof(shdr))) {
-      sec_offset = shdr.sh_offset;
-      sec_size = shdr.sh_size;
+  if (ehdr.e_shstrndx < ehdr.e_shnum && shdrs.Get(ehdr.e_shstrndx, &shdr)) {
+    sec_offset = shdr.sh_offset;
+    sec_size = shdr.sh_size;
+    // Read all of the names at once rather than a byte at a time.
+    if (sec_size <= kMaxBulkReadSize) {
+      sec_data.resize(sec_size);
+      sec_data.resize(memory_->Read(sec_offset, &sec_data[0], sec_size));
     }
   }
 
   // Skip the first header, it's always going to be NULL.
-  offset += ehdr.e_shentsize;
-  for (size_t i = 1; i < ehdr.e_shnum; i++, offset += ehdr.e_shentsize) {
-    if (!memory_->ReadFully(offset, &shdr, sizeof(shdr))) {
+  for (size_t i = 1; i < shdrs.num_entries(); i++) {
+    if (!shdrs.Get(i, &shdr)) {
       return;
     }
 
@@ -321,8 +430,7 @@ void ElfInterface::ReadSectionHeaders(const EhdrType& ehdr) {
       if (shdr.sh_link >= ehdr.e_shnum) {
         continue;
       }
-      uint64_t str_offset = ehdr.e_shoff + shdr.sh_link * ehdr.e_shentsize;
-      if (!memory_->ReadFully(str_offset, &str_shdr, sizeof(str_shdr))) {
+      if (!shdrs.Get(shdr.sh_link, &str_shdr)) {
         continue;
       }
       if (str_shdr.sh_type != SHT_STRTAB) {
@@ -330,11 +438,12 @@ void ElfInterface::ReadSectionHeaders(const EhdrType& ehdr) {
       }
       symbols_.push_back(new Symbols(shdr.sh_offset, shdr.sh_size, shdr.sh_entsize,
                                      str_shdr.sh_offset, str_shdr.sh_size));
-    } else if (shdr.sh_type == SHT_PROGBITS && sec_size != 0) {
-      // Look for the .debug_frame and .gnu_debugdata.
+    } else if ((shdr.sh_type == SHT_PROGBITS || shdr.sh_type == SHT_GNU_SFRAME) &&
+               sec_size != 0) {
+      // Look for the .debug_frame, .gnu_debugdata and the unwind sections.
       if (shdr.sh_name < sec_size) {
         std::string name;
-        if (memory_->ReadString(sec_offset + shdr.sh_name, &name)) {
+        if (GetSectionName(memory_, sec_offset, sec_data, shdr.sh_name, &name)) {
           uint64_t* offset_ptr = nullptr;
           uint64_t* size_ptr = nullptr;
           if (name == ".debug_frame") {
@@ -349,6 +458,9 @@ void ElfInterface::ReadSectionHeaders(const EhdrType& ehdr) {
           } else if (eh_frame_hdr_offset_ == 0 && name == ".eh_frame_hdr") {
             offset_ptr = &eh_frame_hdr_offset_;
             size_ptr = &eh_frame_hdr_size_;
+          } else if (sframe_offset_ == 0 && name == ".sframe") {
+            offset_ptr = &sframe_offset_;
+            size_ptr = &sframe_size_;
           }
           if (offset_ptr != nullptr) {
             *offset_ptr = shdr.sh_offset;
@@ -363,7 +475,7 @@ void ElfInterface::ReadSectionHeaders(const EhdrType& ehdr) {
     } else if (shdr.sh_type == SHT_NOTE) {
       if (shdr.sh_name < sec_size) {
         std::string name;
-        if (memory_->ReadString(sec_offset + shdr.sh_name, &name) &&
+        if (GetSectionName(memory_, sec_offset, sec_data, shdr.sh_name, &name) &&
             name == ".note.gnu.build-id") {
           gnu_build_id_offset_ = shdr.sh_offset;
           gnu_build_id_size_ = shdr.sh_size;
@@ -442,6 +554,26 @@ bool ElfInterface::GetFunctionNameWithTemplate(uint64_t addr, std::string* name,
   return false;
 }
 
+void ElfInterface::GetFunctionNames(const uint64_t* addrs, size_t count,
+                                    FunctionInfo* functions) {
+  for (size_t i = 0; i < count; i++) {
+    std::string name;
+    uint64_t offset;
+    if (functions[i].name.empty() && GetFunctionName(addrs[i], &name, &offset)) {
+      functions[i].name = std::move(name);
+      functions[i].offset = offset;
+    }
+  }
+}
+
+template <typename SymType>
+void ElfInterface::GetFunctionNamesWithTemplate(const uint64_t* addrs, size_t count,
+                                                FunctionInfo* functions) {
+  for (const auto symbol : symbols_) {
+    symbol->GetNames<SymType>(addrs, count, memory_, functions);
+  }
+}
+
 template <typename SymType>
 bool ElfInterface::GetGlobalVariableWithTemplate(const std::string& name, uint64_t* memory_address) {
   if (symbols_.empty()) {
@@ -460,7 +592,15 @@ bool ElfInterface::Step(uint64_t pc, Regs* regs, Memory* process_memory, bool* f
   last_error_.code = ERROR_NONE;
   last_error_.address = 0;
 
-  // Try the debug_frame first since it contains the most specific unwind
+  // Try the sframe first, it is the fastest to use. It only describes the
+  // cfa, return address and frame pointer, if the function needs more than
+  // that its sframe step fails and the dwarf information is used instead.
+  SFrameSection* sframe = sframe_.get();
+  if (sframe != nullptr && sframe->Step(pc, regs, process_memory, finished)) {
+    return true;
+  }
+
+  // Try the debug_frame next since it contains the most specific unwind
   // information.
   DwarfSection* debug_frame = debug_frame_.get();
   if (debug_frame != nullptr && debug_frame->Step(pc, regs, process_memory, finished)) {
@@ -487,6 +627,9 @@ bool ElfInterface::Step(uint64_t pc, Regs* regs, Memory* process_memory, bool* f
   } else if (gnu_debugdata_interface_ != nullptr) {
     last_error_ = gnu_debugdata_interface_->last_error();
     return false;
+  } else if (sframe_ != nullptr) {
+    last_error_ = sframe_->last_error();
+    return false;
   } else {
     return false;
   }
@@ -543,7 +686,6 @@ bool GetBuildIDInfo(Memory* memory, uint64_t* build_id_offset, uint64_t* build_i
     return false;
   }
 
-  uint64_t offset = ehdr.e_shoff;
   uint64_t sec_offset;
   uint64_t sec_size;
   ShdrType shdr;
@@ -551,22 +693,27 @@ bool GetBuildIDInfo(Memory* memory, uint64_t* build_id_offset, uint64_t* build_i
     return false;
   }
 
-  uint64_t sh_offset = offset + ehdr.e_shstrndx * ehdr.e_shentsize;
-  if (!memory->ReadFully(sh_offset, &shdr, sizeof(shdr))) {
+  ElfHeaderTable<ShdrType> shdrs(memory, ehdr.e_shoff, ehdr.e_shnum, ehdr.e_shentsize);
+  if (!shdrs.Get(ehdr.e_shstrndx, &shdr)) {
     return false;
   }
   sec_offset = shdr.sh_offset;
   sec_size = shdr.sh_size;
+  std::string sec_data;
+  if (sec_size <= kMaxBulkReadSize) {
+    sec_data.resize(sec_size);
+    sec_data.resize(memory->Read(sec_offset, &sec_data[0], sec_size));
+  }
 
   // Skip the first header, it's always going to be NULL.
-  offset += ehdr.e_shentsize;
-  for (size_t i = 1; i < ehdr.e_shnum; i++, offset += ehdr.e_shentsize) {
-    if (!memory->ReadFully(offset, &shdr, sizeof(shdr))) {
+  for (size_t i = 1; i < shdrs.num_entries(); i++) {
+    if (!shdrs.Get(i, &shdr)) {
       return false;
     }
     std::string name;
     if (shdr.sh_type == SHT_NOTE && shdr.sh_name < sec_size &&
-        memory->ReadString(sec_offset + shdr.sh_name, &name) && name == ".note.gnu.build-id") {
+        GetSectionName(memory, sec_offset, sec_data, shdr.sh_name, &name) &&
+        name == ".note.gnu.build-id") {
       *build_id_offset = shdr.sh_offset;
       *build_id_size = shdr.sh_size;
       return true;
@@ -659,6 +806,11 @@ template bool ElfInterface::GetFunctionNameWithTemplate<Elf32_Sym>(uint64_t, std
 template bool ElfInterface::GetFunctionNameWithTemplate<Elf64_Sym>(uint64_t, std::string*,
                                                                    uint64_t*);
 
+template void ElfInterface::GetFunctionNamesWithTemplate<Elf32_Sym>(const uint64_t*, size_t,
+                                                                    FunctionInfo*);
+template void ElfInterface::GetFunctionNamesWithTemplate<Elf64_Sym>(const uint64_t*, size_t,
+                                                                    FunctionInfo*);
+
 template bool ElfInterface::GetGlobalVariableWithTemplate<Elf32_Sym>(const std::string&, uint64_t*);
 template bool ElfInterface::GetGlobalVariableWithTemplate<Elf64_Sym>(const std::string&, uint64_t*);
 
@@ -17,15 +17,30 @@
 #include <elf.h>
 #include <stdint.h>
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 #include <unwindstack/MachineArm.h>
 #include <unwindstack/Memory.h>
 #include <unwindstack/RegsArm.h>
 
 #include "ArmExidx.h"
 #include "ElfInterfaceArm.h"
+#include "MemoryUsage.h"
 
 namespace unwindstack {
 
+// The number of entries decoded with a single read.
+static constexpr size_t kEntriesPerChunk = 512;
+
+// Tables with more entries than this are almost certainly malformed, so
+// search them without keeping any decoded data.
+static constexpr size_t kMaxDecodedEntries = 1 << 22;
+
+// The maximum number of entries whose unwind opcodes are kept.
+static constexpr size_t kMaxEntryOps = 4096;
+
 bool ElfInterfaceArm::Init(uint64_t* load_bias) {
   if (!ElfInterface32::Init(load_bias)) {
     return false;
@@ -44,12 +59,9 @@ bool ElfInterfaceArm::FindEntry(uint32_t pc, uint64_t* entry_offset) {
   size_t last = total_entries_;
   while (first < last) {
     size_t current = (first + last) / 2;
-    uint32_t addr = addrs_[current];
-    if (addr == 0) {
-      if (!GetPrel31Addr(start_offset_ + current * 8, &addr)) {
-        return false;
-      }
-      addrs_[current] = addr;
+    uint32_t addr;
+    if (!GetEntryAddr(current, &addr)) {
+      return false;
     }
     if (pc == addr) {
       *entry_offset = start_offset_ + current * 8;
@@ -83,6 +95,69 @@ bool ElfInterfaceArm::GetPrel31Addr(uint32_t offset, uint32_t* addr) {
   return true;
 }
 
+// Read and decode all of the entries in a chunk of the table with a
+// single read, instead of one read for each entry that is examined.
+void ElfInterfaceArm::DecodeEntries(size_t chunk) {
+  size_t first = chunk * kEntriesPerChunk;
+  size_t num_entries = std::min(kEntriesPerChunk, total_entries_ - first);
+  uint32_t offset = start_offset_ + first * 8;
+  // Only the chunks that are searched are allocated, so a table size
+  // taken from a malformed header does not allocate anything up front.
+  std::unique_ptr<uint32_t[]> addrs(new uint32_t[num_entries]());
+  std::vector<uint32_t> data(num_entries * 2);
+  size_t bytes = memory_->Read(offset, data.data(), num_entries * 8);
+  for (size_t i = 0; i < num_entries && i * 8 + sizeof(uint32_t) <= bytes; i++) {
+    // Sign extend the value if necessary.
+    int32_t value = (static_cast<int32_t>(data[i * 2]) << 1) >> 1;
+    addrs[i] = offset + i * 8 + value;
+  }
+  chunks_[chunk] = std::move(addrs);
+  num_decoded_entries_ += num_entries;
+}
+
+bool ElfInterfaceArm::GetEntryAddr(size_t index, uint32_t* addr) {
+  if (total_entries_ > kMaxDecodedEntries) {
+    return GetPrel31Addr(start_offset_ + index * 8, addr);
+  }
+
+  if (chunks_.empty()) {
+    chunks_.resize((total_entries_ + kEntriesPerChunk - 1) / kEntriesPerChunk);
+  }
+  size_t chunk = index / kEntriesPerChunk;
+  if (chunks_[chunk] == nullptr) {
+    DecodeEntries(chunk);
+  }
+
+  uint32_t* chunk_addr = &chunks_[chunk][index % kEntriesPerChunk];
+  *addr = *chunk_addr;
+  if (*addr == 0) {
+    // The chunk read did not cover this entry, so read it by itself.
+    if (!GetPrel31Addr(start_offset_ + index * 8, addr)) {
+      return false;
+    }
+    *chunk_addr = *addr;
+  }
+  return true;
+}
+
+bool ElfInterfaceArm::ExtractEntryOps(ArmExidx* arm, uint64_t entry_offset) {
+  auto entry = entry_ops_.find(entry_offset);
+  if (entry != entry_ops_.end()) {
+    arm->data()->assign(entry->second.begin(), entry->second.end());
+    return true;
+  }
+
+  if (!arm->ExtractEntryData(entry_offset)) {
+    return false;
+  }
+  if (entry_ops_.size() >= kMaxEntryOps) {
+    entry_ops_.clear();
+  }
+  entry_ops_.emplace(entry_offset,
+                     std::vector<uint8_t>(arm->data()->begin(), arm->data()->end()));
+  return true;
+}
+
 #if !defined(PT_ARM_EXIDX)
 #define PT_ARM_EXIDX 0x70000001
 #endif
@@ -98,6 +173,10 @@ void ElfInterfaceArm::HandleUnknownType(uint32_t type, uint64_t ph_offset, uint6
   // Always use filesz instead of memsz. In most cases they are the same,
   // but some shared libraries wind up setting one correctly and not the other.
   total_entries_ = ph_filesz / 8;
+
+  chunks_.clear();
+  num_decoded_entries_ = 0;
+  entry_ops_.clear();
 }
 
 bool ElfInterfaceArm::Step(uint64_t pc, Regs* regs, Memory* process_memory, bool* finished) {
@@ -126,7 +205,7 @@ bool ElfInterfaceArm::StepExidx(uint64_t pc, Regs* regs, Memory* process_memory,
   ArmExidx arm(regs_arm, memory_, process_memory);
   arm.set_cfa(regs_arm->sp());
   bool return_value = false;
-  if (arm.ExtractEntryData(entry_offset) && arm.Eval()) {
+  if (ExtractEntryOps(&arm, entry_offset) && arm.Eval()) {
     // If the pc was not set, then use the LR registers for the PC.
     if (!arm.pc_set()) {
       (*regs_arm)[ARM_REG_PC] = (*regs_arm)[ARM_REG_LR];
@@ -181,4 +260,14 @@ bool ElfInterfaceArm::GetFunctionName(uint64_t addr, std::string* name, uint64_t
   return false;
 }
 
+uint64_t ElfInterfaceArm::MemoryUsage() {
+  uint64_t usage = ElfInterface32::MemoryUsage() + sizeof(*this) - sizeof(ElfInterface32) +
+                   ContainerMemoryUsage(chunks_) + num_decoded_entries_ * sizeof(uint32_t) +
+                   ContainerMemoryUsage(entry_ops_);
+  for (const auto& entry : entry_ops_) {
+    usage += ContainerMemoryUsage(entry.second);
+  }
+  return usage;
+}
+
 }  // namespace unwindstack
@@ -21,13 +21,18 @@
 #include <stdint.h>
 
 #include <iterator>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include <unwindstack/ElfInterface.h>
 #include <unwindstack/Memory.h>
 
 namespace unwindstack {
 
+// Forward declarations.
+class ArmExidx;
+
 class ElfInterfaceArm : public ElfInterface32 {
  public:
   ElfInterfaceArm(Memory* memory) : ElfInterface32(memory) {}
@@ -46,12 +51,9 @@ class ElfInterfaceArm : public ElfInterface32 {
     bool operator!=(const iterator& rhs) { return this->index_ != rhs.index_; }
 
     uint32_t operator*() {
-      uint32_t addr = interface_->addrs_[index_];
-      if (addr == 0) {
-        if (!interface_->GetPrel31Addr(interface_->start_offset_ + index_ * 8, &addr)) {
-          return 0;
-        }
-        interface_->addrs_[index_] = addr;
+      uint32_t addr;
+      if (!interface_->GetEntryAddr(index_, &addr)) {
+        return 0;
       }
       return addr;
     }
@@ -68,6 +70,8 @@ class ElfInterfaceArm : public ElfInterface32 {
 
   bool GetPrel31Addr(uint32_t offset, uint32_t* addr);
 
+  bool GetEntryAddr(size_t index, uint32_t* addr);
+
   bool FindEntry(uint32_t pc, uint64_t* entry_offset);
 
   void HandleUnknownType(uint32_t type, uint64_t ph_offset, uint64_t ph_filesz) override;
@@ -78,6 +82,8 @@ class ElfInterfaceArm : public ElfInterface32 {
 
   bool GetFunctionName(uint64_t addr, std::string* name, uint64_t* offset) override;
 
+  uint64_t MemoryUsage() override;
+
   uint64_t start_offset() { return start_offset_; }
 
   size_t total_entries() { return total_entries_; }
@@ -85,11 +91,22 @@ class ElfInterfaceArm : public ElfInterface32 {
   void set_load_bias(uint64_t load_bias) { load_bias_ = load_bias; }
 
  protected:
+  void DecodeEntries(size_t chunk);
+
+  bool ExtractEntryOps(ArmExidx* arm, uint64_t entry_offset);
+
   uint64_t start_offset_ = 0;
   size_t total_entries_ = 0;
   uint64_t load_bias_ = 0;
 
-  std::unordered_map<size_t, uint32_t> addrs_;
+  // The decoded address of every entry, by chunk. A chunk is allocated
+  // the first time it is searched. A value of zero means the entry has
+  // not been read yet.
+  std::vector<std::unique_ptr<uint32_t[]>> chunks_;
+  size_t num_decoded_entries_ = 0;
+
+  // The unwind opcodes of recently used entries, keyed by entry offset.
+  std::unordered_map<uint64_t, std::vector<uint8_t>> entry_ops_;
 };
 
 }  // namespace unwindstack
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <unwindstack/Error.h>
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Memory.h>
+#include <unwindstack/Regs.h>
+#include <unwindstack/Unwinder.h>
+
+#include "FrameCache.h"
+
+namespace unwindstack {
+
+void FrameCache::RecordingMemory::Reset(Memory* memory) {
+  memory_ = memory;
+  reads_.clear();
+  data_.clear();
+}
+
+size_t FrameCache::RecordingMemory::Read(uint64_t addr, void* dst, size_t size) {
+  size_t bytes = memory_->Read(addr, dst, size);
+  reads_.push_back(StackRead{addr, size, bytes, data_.size()});
+  data_.append(reinterpret_cast<const char*>(dst), bytes);
+  return bytes;
+}
+
+void FrameCache::RecordingMemory::Append(const std::vector<StackRead>& reads,
+                                         const std::string& data) {
+  size_t offset = data_.size();
+  for (const StackRead& read : reads) {
+    reads_.push_back(read);
+    reads_.back().offset += offset;
+  }
+  data_ += data;
+}
+
+Memory* FrameCache::StartUnwind(Memory* stack_memory) {
+  memory_.Reset(stack_memory);
+  checkpoints_.clear();
+  num_frames_checked_ = 0;
+  return &memory_;
+}
+
+void FrameCache::SetState(Regs* regs) {
+  uint64_t values[3] = {regs->pc(), regs->sp(), regs->dex_pc()};
+  state_.assign(reinterpret_cast<const char*>(values), sizeof(values));
+  void* raw_data = regs->RawData();
+  if (raw_data != nullptr) {
+    size_t reg_size = regs->Is32Bit() ? sizeof(uint32_t) : sizeof(uint64_t);
+    state_.append(reinterpret_cast<const char*>(raw_data), regs->total_regs() * reg_size);
+  }
+}
+
+bool FrameCache::ReadsMatch(const Entry& entry) {
+  Memory* memory = memory_.memory();
+  for (const StackRead& read : entry.reads) {
+    buffer_.resize(read.size);
+    if (memory->Read(read.addr, buffer_.data(), read.size) != read.bytes_read ||
+        memcmp(buffer_.data(), &entry.data[read.offset], read.bytes_read) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FrameCache::Find(Regs* regs, size_t max_frames, std::vector<CompactFrameData>* frames,
+                      ErrorData* last_error, bool* speculative_end) {
+  SetState(regs);
+  auto entry = entries_.find(state_);
+  if (entry != entries_.end()) {
+    const Entry& cached = entry->second;
+    if (cached.error_before.code == last_error->code &&
+        cached.error_before.address == last_error->address &&
+        frames->size() + cached.frames.size() < max_frames && ReadsMatch(cached)) {
+      frames->insert(frames->end(), cached.frames.begin(), cached.frames.end());
+      *last_error = cached.error;
+      *speculative_end = cached.speculative_end;
+      // Any state before this one can be cached with these reads too.
+      memory_.Append(cached.reads, cached.data);
+      return true;
+    }
+  }
+
+  // Only remember the states at frames 1, 2, 4, 8 and so on, so that the
+  // cache does not hold a copy of every suffix of a deep stack.
+  num_frames_checked_++;
+  if ((num_frames_checked_ & (num_frames_checked_ - 1)) == 0) {
+    checkpoints_.emplace_back(
+        Checkpoint{state_, *last_error, frames->size(), memory_.reads().size()});
+  }
+  return false;
+}
+
+void FrameCache::FinishUnwind(const std::vector<CompactFrameData>& frames,
+                              const ErrorData& last_error, bool speculative_end,
+                              const CompactFrameData* speculative_frame) {
+  // An unwind cut short by the maximum number of frames could have gone
+  // further from a frame closer to the top of the stack. The same goes for
+  // an unwind that ran out of its budget.
+  if (last_error.code == ERROR_MAX_FRAMES_EXCEEDED || last_error.code == ERROR_BUDGET_EXCEEDED) {
+    checkpoints_.clear();
+  }
+
+  // Frames found through the jit debug information are not cached, the
+  // code in the jit maps can change at any time.
+  size_t first_cacheable_frame = 0;
+  for (size_t i = 0; i < frames.size(); i++) {
+    const CompactFrameData& frame = frames[i];
+    if (frame.elf != nullptr && frame.map_info != nullptr &&
+        frame.elf != frame.map_info->elf.get()) {
+      first_cacheable_frame = i + 1;
+    }
+  }
+
+  for (const Checkpoint& checkpoint : checkpoints_) {
+    if (checkpoint.frame_index < first_cacheable_frame) {
+      continue;
+    }
+
+    if (entries_.size() >= max_entries_) {
+      entries_.clear();
+    }
+    // Replace any entry for the same state, it did not match this stack.
+    Entry* entry = &entries_[checkpoint.state];
+    *entry = Entry();
+    entry->error_before = checkpoint.error_before;
+    entry->frames.assign(frames.begin() + checkpoint.frame_index, frames.end());
+    if (speculative_frame != nullptr) {
+      entry->frames.push_back(*speculative_frame);
+    }
+    entry->error = last_error;
+    entry->speculative_end = speculative_end;
+
+    // Merge reads of consecutive memory, so that checking the entry takes
+    // fewer reads.
+    const std::vector<StackRead>& reads = memory_.reads();
+    for (size_t i = checkpoint.read_index; i < reads.size(); i++) {
+      const StackRead& read = reads[i];
+      const char* data = &memory_.data()[read.offset];
+      if (!entry->reads.empty()) {
+        StackRead* last = &entry->reads.back();
+        if (last->bytes_read == last->size && read.bytes_read == read.size &&
+            last->addr + last->size == read.addr) {
+          last->size += read.size;
+          last->bytes_read += read.bytes_read;
+          entry->data.append(data, read.bytes_read);
+          continue;
+        }
+      }
+      entry->reads.push_back(StackRead{read.addr, read.size, read.bytes_read, entry->data.size()});
+      entry->data.append(data, read.bytes_read);
+    }
+  }
+  checkpoints_.clear();
+  // Do not keep a pointer to the stack memory after the unwind.
+  memory_.Reset(nullptr);
+}
+
+}  // namespace unwindstack
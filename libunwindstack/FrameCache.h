@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBUNWINDSTACK_FRAME_CACHE_H
+#define _LIBUNWINDSTACK_FRAME_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <unwindstack/Error.h>
+#include <unwindstack/Memory.h>
+#include <unwindstack/Unwinder.h>
+
+namespace unwindstack {
+
+// Forward declarations.
+class Regs;
+
+// Remembers how unwinds ended, so that an unwind that reaches a state
+// seen before can add the frames found the last time instead of
+// stepping through them again.
+//
+// The rest of an unwind only depends on the registers, the memory it
+// reads and the maps. A state is the full set of registers, and every
+// read made from that state on is recorded with it. A cached unwind is
+// only used if all of those reads still return the same data. The maps
+// are not checked, so the cache must be cleared whenever they change.
+class FrameCache {
+ public:
+  explicit FrameCache(size_t max_entries) : max_entries_(max_entries) {}
+  ~FrameCache() = default;
+
+  // Start a new unwind that reads the stack from stack_memory. Returns
+  // the memory the unwind must use instead, which records every read.
+  Memory* StartUnwind(Memory* stack_memory);
+
+  // Called for every frame after a successful step. If the unwind from
+  // this state is known and adds less than max_frames in total, its
+  // frames are added to frames, last_error is set to the error it ended
+  // with and true is returned. speculative_end is set if the last frame
+  // added came from the pc in the return address register, and might
+  // have to be removed. Otherwise, the state is remembered so that the
+  // unwind from here can be cached when it finishes.
+  bool Find(Regs* regs, size_t max_frames, std::vector<CompactFrameData>* frames,
+            ErrorData* last_error, bool* speculative_end);
+
+  // Cache the unwind from the states remembered by Find. If the unwind
+  // removed a speculative frame at the end, it is passed in as
+  // speculative_frame.
+  void FinishUnwind(const std::vector<CompactFrameData>& frames, const ErrorData& last_error,
+                    bool speculative_end, const CompactFrameData* speculative_frame);
+
+  void Clear() { entries_.clear(); }
+
+ private:
+  struct StackRead {
+    uint64_t addr;
+    size_t size;
+    // The number of bytes the read returned, which is less than size if
+    // the read failed part of the way.
+    size_t bytes_read;
+    // Where the data read is in the data of the recording.
+    size_t offset;
+  };
+
+  class RecordingMemory : public Memory {
+   public:
+    RecordingMemory() = default;
+    virtual ~RecordingMemory() = default;
+
+    void Reset(Memory* memory);
+
+    size_t Read(uint64_t addr, void* dst, size_t size) override;
+
+    void Append(const std::vector<StackRead>& reads, const std::string& data);
+
+    Memory* memory() { return memory_; }
+    const std::vector<StackRead>& reads() { return reads_; }
+    const std::string& data() { return data_; }
+
+   private:
+    Memory* memory_ = nullptr;
+    std::vector<StackRead> reads_;
+    std::string data_;
+  };
+
+  struct Entry {
+    // The error of the unwind when it reached the state.
+    ErrorData error_before;
+    std::vector<CompactFrameData> frames;
+    ErrorData error;
+    bool speculative_end;
+    std::vector<StackRead> reads;
+    std::string data;
+  };
+
+  struct Checkpoint {
+    std::string state;
+    ErrorData error_before;
+    size_t frame_index;
+    size_t read_index;
+  };
+
+  void SetState(Regs* regs);
+  bool ReadsMatch(const Entry& entry);
+
+  size_t max_entries_;
+  // Keyed by the state, so that a lookup compares all of the registers.
+  std::unordered_map<std::string, Entry> entries_;
+
+  RecordingMemory memory_;
+  std::vector<Checkpoint> checkpoints_;
+  size_t num_frames_checked_ = 0;
+  // Reused for every state and read, to avoid allocating.
+  std::string state_;
+  std::vector<uint8_t> buffer_;
+};
+
+}  // namespace unwindstack
+
+#endif  // _LIBUNWINDSTACK_FRAME_CACHE_H
@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <android-base/threads.h>
+#include <android-base/unique_fd.h>
+
+#include <unwindstack/Elf.h>
+#include <unwindstack/GnuDebugdataCache.h>
+#include <unwindstack/Memory.h>
+
+namespace unwindstack {
+
+static constexpr const char* kDiskSuffix = ".gnu_debugdata";
+
+struct GnuDebugdataCacheEntry {
+  std::shared_ptr<Memory> memory;
+  size_t size;
+  std::list<std::string>::iterator lru;
+};
+
+struct GnuDebugdataCacheState {
+  std::mutex lock;
+  bool enabled = false;
+  size_t max_size = 0;
+  size_t size = 0;
+  std::unordered_map<std::string, GnuDebugdataCacheEntry> entries;
+  // The most recently used entries are at the front.
+  std::list<std::string> lru;
+
+  std::string disk_dir;
+  uint64_t disk_max_size = 0;
+};
+
+std::atomic_bool GnuDebugdataCache::enabled_;
+// Created the first time the cache is used, and never freed, since
+// another thread might still be using it after the cache is disabled.
+static GnuDebugdataCacheState* g_state;
+static std::once_flag g_state_once;
+
+static GnuDebugdataCacheState* GetState() {
+  std::call_once(g_state_once, []() { g_state = new GnuDebugdataCacheState; });
+  return g_state;
+}
+
+// Evict the least recently used entries until at least size bytes are free.
+// Must be called with the lock held.
+static void EvictLocked(GnuDebugdataCacheState* state, size_t size) {
+  while (!state->lru.empty() && state->size + size > state->max_size) {
+    auto entry = state->entries.find(state->lru.back());
+    state->size -= entry->second.size;
+    state->entries.erase(entry);
+    state->lru.pop_back();
+  }
+}
+
+void GnuDebugdataCache::SetEnabled(bool enable, size_t max_size) {
+  GnuDebugdataCacheState* state = GetState();
+  std::lock_guard<std::mutex> guard(state->lock);
+  if (enable) {
+    state->enabled = true;
+    state->max_size = max_size;
+    EvictLocked(state, 0);
+  } else {
+    // Free all of the entries, but keep the state, since another thread
+    // might be in the middle of a Get or Add.
+    state->enabled = false;
+    state->max_size = 0;
+    state->size = 0;
+    state->entries.clear();
+    state->lru.clear();
+    state->disk_dir.clear();
+  }
+  enabled_ = enable;
+}
+
+void GnuDebugdataCache::SetDiskCache(const std::string& dir, uint64_t max_size) {
+  if (!enabled_) {
+    return;
+  }
+  GnuDebugdataCacheState* state = GetState();
+  std::lock_guard<std::mutex> guard(state->lock);
+  state->disk_dir = dir;
+  state->disk_max_size = max_size;
+}
+
+size_t GnuDebugdataCache::Total() {
+  if (!enabled_) {
+    return 0;
+  }
+  GnuDebugdataCacheState* state = GetState();
+  std::lock_guard<std::mutex> guard(state->lock);
+  return state->entries.size();
+}
+
+size_t GnuDebugdataCache::Size() {
+  if (!enabled_) {
+    return 0;
+  }
+  GnuDebugdataCacheState* state = GetState();
+  std::lock_guard<std::mutex> guard(state->lock);
+  return state->size;
+}
+
+static std::string GetDiskPath(const std::string& dir, const std::string& build_id) {
+  std::string path(dir + '/');
+  for (const char& c : build_id) {
+    // Use %hhx to avoid sign extension on abis that have signed chars.
+    path += android::base::StringPrintf("%02hhx", c);
+  }
+  return path + kDiskSuffix;
+}
+
+static std::shared_ptr<Memory> GetFromDisk(const std::string& path, size_t* size) {
+  std::shared_ptr<MemoryFileAtOffset> memory(new MemoryFileAtOffset);
+  if (!memory->Init(path, 0) || !Elf::IsValidElf(memory.get())) {
+    return nullptr;
+  }
+  // Update the modification time so that trimming the directory removes
+  // the least recently used files first.
+  utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+  *size = memory->Size();
+  return memory;
+}
+
+// Remove the oldest files in the directory until the total size of
+// all of the cache files is less than max_size.
+static void TrimDisk(const std::string& dir, uint64_t max_size) {
+  DIR* dirp = opendir(dir.c_str());
+  if (dirp == nullptr) {
+    return;
+  }
+
+  struct DiskEntry {
+    std::string path;
+    uint64_t size;
+    struct timespec mtime;
+  };
+  std::vector<DiskEntry> files;
+  uint64_t total_size = 0;
+  struct dirent* entry;
+  while ((entry = readdir(dirp)) != nullptr) {
+    if (!android::base::EndsWith(entry->d_name, kDiskSuffix)) {
+      continue;
+    }
+    std::string path(dir + '/' + entry->d_name);
+    struct stat buf;
+    if (stat(path.c_str(), &buf) == -1 || !S_ISREG(buf.st_mode)) {
+      continue;
+    }
+    files.push_back(DiskEntry{path, static_cast<uint64_t>(buf.st_size), buf.st_mtim});
+    total_size += buf.st_size;
+  }
+  closedir(dirp);
+  if (total_size <= max_size) {
+    return;
+  }
+
+  std::sort(files.begin(), files.end(), [](const DiskEntry& a, const DiskEntry& b) {
+    if (a.mtime.tv_sec != b.mtime.tv_sec) {
+      return a.mtime.tv_sec < b.mtime.tv_sec;
+    }
+    return a.mtime.tv_nsec < b.mtime.tv_nsec;
+  });
+  for (const auto& file : files) {
+    if (total_size <= max_size) {
+      break;
+    }
+    if (unlink(file.path.c_str()) == 0) {
+      total_size -= file.size;
+    }
+  }
+}
+
+static void AddToDisk(const std::string& dir, const std::string& path, uint64_t max_size,
+                      MemoryBuffer* memory) {
+  if (memory->Size() == 0 || memory->Size() > max_size) {
+    return;
+  }
+
+  // Write to a temporary file and rename it so that no other process can
+  // ever see a partially written file.
+  std::string tmp_path(path + android::base::StringPrintf(".%" PRIu64 ".tmp",
+                                                          android::base::GetThreadId()));
+  android::base::unique_fd fd(TEMP_FAILURE_RETRY(
+      open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644)));
+  if (fd == -1) {
+    return;
+  }
+  if (!android::base::WriteFully(fd, memory->GetPtr(0), memory->Size())) {
+    unlink(tmp_path.c_str());
+    return;
+  }
+  fd.reset();
+  if (rename(tmp_path.c_str(), path.c_str()) == -1) {
+    unlink(tmp_path.c_str());
+    return;
+  }
+
+  TrimDisk(dir, max_size);
+}
+
+static std::shared_ptr<Memory> Insert(const std::string& build_id,
+                                      const std::shared_ptr<Memory>& memory, size_t size) {
+  GnuDebugdataCacheState* state = GetState();
+  std::lock_guard<std::mutex> guard(state->lock);
+  auto entry = state->entries.find(build_id);
+  if (entry != state->entries.end()) {
+    state->lru.splice(state->lru.begin(), state->lru, entry->second.lru);
+    return entry->second.memory;
+  }
+
+  if (!state->enabled || size > state->max_size) {
+    // The cache was disabled, or the data is too large to ever fit, so
+    // don't throw away everything else.
+    return memory;
+  }
+  EvictLocked(state, size);
+  state->lru.push_front(build_id);
+  state->entries[build_id] = GnuDebugdataCacheEntry{memory, size, state->lru.begin()};
+  state->size += size;
+  return memory;
+}
+
+std::shared_ptr<Memory> GnuDebugdataCache::Get(const std::string& build_id) {
+  GnuDebugdataCacheState* state = GetState();
+  std::string path;
+  {
+    std::lock_guard<std::mutex> guard(state->lock);
+    auto entry = state->entries.find(build_id);
+    if (entry != state->entries.end()) {
+      state->lru.splice(state->lru.begin(), state->lru, entry->second.lru);
+      return entry->second.memory;
+    }
+    if (state->disk_dir.empty()) {
+      return nullptr;
+    }
+    path = GetDiskPath(state->disk_dir, build_id);
+  }
+
+  // Do not hold the lock while reading from disk.
+  size_t size;
+  std::shared_ptr<Memory> memory(GetFromDisk(path, &size));
+  if (memory == nullptr) {
+    return nullptr;
+  }
+  return Insert(build_id, memory, size);
+}
+
+std::shared_ptr<Memory> GnuDebugdataCache::Add(const std::string& build_id,
+                                               const std::shared_ptr<MemoryBuffer>& memory) {
+  GnuDebugdataCacheState* state = GetState();
+  std::string dir;
+  uint64_t disk_max_size;
+  {
+    std::lock_guard<std::mutex> guard(state->lock);
+    auto entry = state->entries.find(build_id);
+    if (entry != state->entries.end()) {
+      return entry->second.memory;
+    }
+    dir = state->disk_dir;
+    disk_max_size = state->disk_max_size;
+  }
+
+  if (!dir.empty()) {
+    AddToDisk(dir, GetDiskPath(dir, build_id), disk_max_size, memory.get());
+  }
+  return Insert(build_id, memory, memory->Size());
+}
+
+}  // namespace unwindstack
@@ -26,11 +26,12 @@
  * SUCH DAMAGE.
  */
 
-#include <pthread.h>
 #include <stdint.h>
+#include <sys/mman.h>
 
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <unwindstack/Elf.h>
@@ -40,12 +41,27 @@
 #include <unwindstack/Memory.h>
 #include <unwindstack/Regs.h>
 #include <unwindstack/RegsGetLocal.h>
+#include <unwindstack/Unwinder.h>
 
 namespace unwindstack {
 
-bool LocalUnwinder::Init() {
-  pthread_rwlock_init(&maps_rwlock_, nullptr);
+LocalFrameData::LocalFrameData(MapInfo* map_info, uint64_t pc, uint64_t rel_pc,
+                               const std::string& function_name, uint64_t function_offset)
+    : map_info(map_info),
+      pc(pc),
+      rel_pc(rel_pc),
+      function_name(function_name),
+      function_offset(function_offset) {
+  if (map_info != nullptr) {
+    map_name = map_info->name;
+    map_start = map_info->start;
+    map_end = map_info->end;
+    map_offset = map_info->offset;
+    map_flags = map_info->flags;
+  }
+}
 
+bool LocalUnwinder::Init() {
   // Create the maps.
   maps_.reset(new unwindstack::LocalUpdatableMaps());
   if (!maps_->Parse()) {
@@ -58,30 +74,45 @@ bool LocalUnwinder::Init() {
   return true;
 }
 
-bool LocalUnwinder::ShouldSkipLibrary(const std::string& map_name) {
-  for (const std::string& skip_library : skip_libraries_) {
-    if (skip_library == map_name) {
+bool LocalUnwinder::InitSignalSafe() {
+  if (!Init()) {
+    return false;
+  }
+
+  ArchEnum arch = Regs::CurrentArch();
+  for (const auto& map_info : *maps_) {
+    if ((map_info->flags & PROT_EXEC) && !(map_info->flags & MAPS_FLAGS_DEVICE_MAP)) {
+      map_info->GetElf(process_memory_, arch);
+    }
+  }
+  return true;
+}
+
+// Compare against a view so that no std::string is made for an empty
+// map name, which keeps this usable from a signal handler.
+static bool IsLibraryInList(const std::vector<std::string>& libraries, std::string_view name) {
+  for (const std::string& library : libraries) {
+    if (library == name) {
       return true;
     }
   }
   return false;
 }
 
-MapInfo* LocalUnwinder::GetMapInfo(uint64_t pc) {
-  pthread_rwlock_rdlock(&maps_rwlock_);
-  MapInfo* map_info = maps_->Find(pc);
-  pthread_rwlock_unlock(&maps_rwlock_);
+bool LocalUnwinder::ShouldSkipLibrary(const std::string& map_name) {
+  return IsLibraryInList(skip_libraries_, map_name);
+}
 
+MapInfo* LocalUnwinder::GetMapInfo(uint64_t pc) {
+  // The search does not take a lock, so threads unwinding at the same
+  // time do not contend with each other.
+  MapInfo* map_info = maps_->FindShared(pc);
   if (map_info == nullptr) {
-    pthread_rwlock_wrlock(&maps_rwlock_);
-    // This is guaranteed not to invalidate any previous MapInfo objects so
-    // we don't need to worry about any MapInfo* values already in use.
-    if (maps_->Reparse()) {
-      map_info = maps_->Find(pc);
-    }
-    pthread_rwlock_unlock(&maps_rwlock_);
+    // This does not free any MapInfo objects that an unwind in progress
+    // might be using, so we don't need to worry about any MapInfo* values
+    // already in use.
+    map_info = maps_->ReparseAndFind(pc);
   }
-
   return map_info;
 }
 
@@ -90,6 +121,10 @@ bool LocalUnwinder::Unwind(std::vector<LocalFrameData>* frame_info, size_t max_f
   unwindstack::RegsGetLocal(regs.get());
   ArchEnum arch = regs->Arch();
 
+  // Keep any map found during this unwind from being freed by a Reparse
+  // on another thread.
+  uint64_t maps_epoch = maps_->BeginRead();
+
   size_t num_frames = 0;
   bool adjust_pc = false;
   while (true) {
@@ -139,7 +174,62 @@ bool LocalUnwinder::Unwind(std::vector<LocalFrameData>* frame_info, size_t max_f
     }
     adjust_pc = true;
   }
+  maps_->EndRead(maps_epoch);
   return num_frames != 0;
 }
 
+size_t LocalUnwinder::UnwindFramePointers(Regs* regs, CompactFrameData* frames, size_t max_frames) {
+  unwindstack::RegsGetLocal(regs);
+
+  // Only atomic operations are used to keep the maps from being freed
+  // and to search them.
+  uint64_t maps_epoch = maps_->BeginRead();
+
+  size_t num_frames = 0;
+  bool adjust_pc = false;
+  while (num_frames < max_frames) {
+    uint64_t cur_pc = regs->pc();
+    uint64_t cur_sp = regs->sp();
+
+    MapInfo* map_info = maps_->FindShared(cur_pc);
+    if (map_info == nullptr || (map_info->flags & MAPS_FLAGS_DEVICE_MAP)) {
+      break;
+    }
+    MapInfo* sp_info = maps_->FindShared(cur_sp);
+    if (sp_info != nullptr && (sp_info->flags & MAPS_FLAGS_DEVICE_MAP)) {
+      break;
+    }
+    Elf* elf = map_info->GetElfIfCreated();
+    if (elf == nullptr) {
+      break;
+    }
+
+    uint64_t rel_pc = elf->GetRelPc(cur_pc, map_info);
+    uint64_t pc_adjustment = 0;
+    bool stepped;
+    if (elf->StepIfSignalHandler(rel_pc, regs, process_memory_.get())) {
+      // The signal handler pc should not be adjusted.
+      stepped = true;
+    } else {
+      if (adjust_pc) {
+        pc_adjustment = regs->GetPcAdjustment(rel_pc, elf);
+      }
+      stepped = regs->StepFromFramePointer(process_memory_.get());
+    }
+
+    // Skip any locations that are within this library.
+    if (num_frames != 0 || !IsLibraryInList(skip_libraries_, map_info->name.view())) {
+      frames[num_frames++] =
+          CompactFrameData{cur_pc - pc_adjustment, rel_pc - pc_adjustment, cur_sp, map_info, elf};
+    }
+
+    if (!stepped || (cur_pc == regs->pc() && cur_sp == regs->sp())) {
+      break;
+    }
+    adjust_pc = true;
+  }
+  maps_->EndRead(maps_epoch);
+  return num_frames;
+}
+
 }  // namespace unwindstack
@@ -34,12 +34,13 @@ namespace unwindstack {
 bool MapInfo::InitFileMemoryFromPreviousReadOnlyMap(MemoryFileAtOffset* memory) {
   // One last attempt, see if the previous map is read-only with the
   // same name and stretches across this map.
-  if (prev_map == nullptr || prev_map->flags != PROT_READ) {
+  MapInfo* prev_info = prev_map.load(std::memory_order_acquire);
+  if (prev_info == nullptr || prev_info->flags != PROT_READ) {
     return false;
   }
 
-  uint64_t map_size = end - prev_map->end;
-  if (!memory->Init(name, prev_map->offset, map_size)) {
+  uint64_t map_size = end - prev_info->end;
+  if (!memory->Init(name, prev_info->offset, map_size)) {
     return false;
   }
 
@@ -48,12 +49,12 @@ bool MapInfo::InitFileMemoryFromPreviousReadOnlyMap(MemoryFileAtOffset* memory)
     return false;
   }
 
-  if (!memory->Init(name, prev_map->offset, max_size)) {
+  if (!memory->Init(name, prev_info->offset, max_size)) {
     return false;
   }
 
-  elf_offset = offset - prev_map->offset;
-  elf_start_offset = prev_map->offset;
+  elf_offset = offset - prev_info->offset;
+  elf_start_offset = prev_info->offset;
   return true;
 }
 
@@ -109,8 +110,9 @@ Memory* MapInfo::GetFileMemory() {
     // Need to check how to set the elf start offset. If this map is not
     // the r-x map of a r-- map, then use the real offset value. Otherwise,
     // use 0.
-    if (prev_map == nullptr || prev_map->offset != 0 || prev_map->flags != PROT_READ ||
-        prev_map->name != name) {
+    MapInfo* prev_info = prev_map.load(std::memory_order_acquire);
+    if (prev_info == nullptr || prev_info->offset != 0 || prev_info->flags != PROT_READ ||
+        prev_info->name != name) {
       elf_start_offset = offset;
     }
     return memory.release();
@@ -169,20 +171,21 @@ Memory* MapInfo::CreateMemory(const std::shared_ptr<Memory>& process_memory) {
   // doesn't guarantee that this invariant will always be true. However,
   // if that changes, there is likely something else that will change and
   // break something.
-  if (offset == 0 || name.empty() || prev_map == nullptr || prev_map->name != name ||
-      prev_map->offset >= offset) {
+  MapInfo* prev_info = prev_map.load(std::memory_order_acquire);
+  if (offset == 0 || name.empty() || prev_info == nullptr || prev_info->name != name ||
+      prev_info->offset >= offset) {
     return nullptr;
   }
 
   // Make sure that relative pc values are corrected properly.
-  elf_offset = offset - prev_map->offset;
+  elf_offset = offset - prev_info->offset;
   // Use this as the elf start offset, otherwise, you always get offsets into
   // the r-x section, which is not quite the right information.
-  elf_start_offset = prev_map->offset;
+  elf_start_offset = prev_info->offset;
 
   MemoryRanges* ranges = new MemoryRanges;
   ranges->Insert(
-      new MemoryRange(process_memory, prev_map->start, prev_map->end - prev_map->start, 0));
+      new MemoryRange(process_memory, prev_info->start, prev_info->end - prev_info->start, 0));
   ranges->Insert(new MemoryRange(process_memory, start, end - start, elf_offset));
 
   memory_backed_elf = true;
@@ -192,29 +195,25 @@ Memory* MapInfo::CreateMemory(const std::shared_ptr<Memory>& process_memory) {
 Elf* MapInfo::GetElf(const std::shared_ptr<Memory>& process_memory, ArchEnum expected_arch) {
   {
     // Make sure no other thread is trying to add the elf to this map.
-    std::lock_guard<std::mutex> guard(mutex_);
+    std::lock_guard<std::mutex> guard(mutex());
 
     if (elf.get() != nullptr) {
-      return elf.get();
+      return PublishElf();
     }
 
-    bool locked = false;
-    if (Elf::CachingEnabled() && !name.empty()) {
-      Elf::CacheLock();
-      locked = true;
-      if (Elf::CacheGet(this)) {
-        Elf::CacheUnlock();
-        return elf.get();
-      }
+    ElfCacheKey key;
+    bool cached = Elf::CachingEnabled() && Elf::CacheGetKey(this, &key);
+    if (cached && Elf::CacheGet(key, this)) {
+      return PublishElf();
     }
 
+    // If caching, this thread now owns the creation of the cache entry.
+    // No cache lock is held while creating the memory and the elf, so
+    // other threads creating different elf objects are not blocked.
     Memory* memory = CreateMemory(process_memory);
-    if (locked) {
-      if (Elf::CacheAfterCreateMemory(this)) {
-        delete memory;
-        Elf::CacheUnlock();
-        return elf.get();
-      }
+    if (cached && Elf::CacheAfterCreateMemory(key, this)) {
+      delete memory;
+      return PublishElf();
     }
     elf.reset(new Elf(memory));
     // If the init fails, keep the elf around as an invalid object so we
@@ -225,30 +224,48 @@ Elf* MapInfo::GetElf(const std::shared_ptr<Memory>& process_memory, ArchEnum exp
       elf->Invalidate();
     }
 
-    if (locked) {
-      Elf::CacheAdd(this);
-      Elf::CacheUnlock();
+    if (cached) {
+      Elf::CacheAdd(key, this);
     }
+    PublishElf();
   }
 
   // If there is a read-only map then a read-execute map that represents the
   // same elf object, make sure the previous map is using the same elf
   // object if it hasn't already been set.
-  if (prev_map != nullptr && elf_start_offset != offset && prev_map->offset == elf_start_offset &&
-      prev_map->name == name) {
-    std::lock_guard<std::mutex> guard(prev_map->mutex_);
-    if (prev_map->elf.get() == nullptr) {
-      prev_map->elf = elf;
-      prev_map->memory_backed_elf = memory_backed_elf;
+  MapInfo* prev_info = prev_map.load(std::memory_order_acquire);
+  if (prev_info != nullptr && elf_start_offset != offset && prev_info->offset == elf_start_offset &&
+      prev_info->name == name) {
+    std::lock_guard<std::mutex> guard(prev_info->mutex());
+    if (prev_info->elf.get() == nullptr) {
+      prev_info->elf = elf;
+      prev_info->memory_backed_elf = memory_backed_elf;
+      prev_info->PublishElf();
     }
   }
   return elf.get();
 }
 
+Elf* MapInfo::PublishElf() {
+  // The elf object is fully created at this point, and it is not deleted
+  // until this map is.
+  GetElfFields().elf_.store(elf.get(), std::memory_order_release);
+  return elf.get();
+}
+
+Elf* MapInfo::GetElfIfCreated() {
+  // The fields are always allocated before the elf is published.
+  ElfFields* elf_fields = elf_fields_.load(std::memory_order_acquire);
+  if (elf_fields == nullptr) {
+    return nullptr;
+  }
+  return elf_fields->elf_.load(std::memory_order_acquire);
+}
+
 bool MapInfo::GetFunctionName(uint64_t addr, std::string* name, uint64_t* func_offset) {
   {
     // Make sure no other thread is trying to update this elf object.
-    std::lock_guard<std::mutex> guard(mutex_);
+    std::lock_guard<std::mutex> guard(mutex());
     if (elf == nullptr) {
       return false;
     }
@@ -266,7 +283,7 @@ uint64_t MapInfo::GetLoadBias(const std::shared_ptr<Memory>& process_memory) {
 
   {
     // Make sure no other thread is trying to add the elf to this map.
-    std::lock_guard<std::mutex> guard(mutex_);
+    std::lock_guard<std::mutex> guard(mutex());
     if (elf != nullptr) {
       if (elf->valid()) {
         cur_load_bias = elf->GetLoadBias();
@@ -292,11 +309,26 @@ MapInfo::~MapInfo() {
   if (id != 0) {
     delete reinterpret_cast<std::string*>(id);
   }
+  delete elf_fields_.load();
+}
+
+MapInfo::ElfFields& MapInfo::GetElfFields() {
+  ElfFields* elf_fields = elf_fields_.load();
+  if (elf_fields != nullptr) {
+    return *elf_fields;
+  }
+  // No need to lock, if multiple threads do this at the same time only
+  // one of them will save the data.
+  std::unique_ptr<ElfFields> new_elf_fields(new ElfFields);
+  if (elf_fields_.compare_exchange_strong(elf_fields, new_elf_fields.get())) {
+    return *new_elf_fields.release();
+  }
+  return *elf_fields;
 }
 
 std::string MapInfo::GetBuildID() {
   uintptr_t id = build_id.load();
-  if (build_id != 0) {
+  if (id != 0) {
     return *reinterpret_cast<std::string*>(id);
   }
 
@@ -307,9 +339,9 @@ std::string MapInfo::GetBuildID() {
 
   // Now need to see if the elf object exists.
   // Make sure no other thread is trying to add the elf to this map.
-  mutex_.lock();
+  mutex().lock();
   Elf* elf_obj = elf.get();
-  mutex_.unlock();
+  mutex().unlock();
   if (elf_obj != nullptr) {
     *cur_build_id = elf_obj->GetBuildID();
   } else {
@@ -344,4 +376,39 @@ std::string MapInfo::GetPrintableBuildID() {
   return printable_build_id;
 }
 
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+  // FNV-1a.
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+uint64_t MapInfo::GetBuildIDToken() {
+  std::atomic_uint64_t& build_id_token = GetElfFields().build_id_token_;
+  uint64_t token = build_id_token.load(std::memory_order_relaxed);
+  if (token != 0) {
+    return token;
+  }
+
+  token = 0xcbf29ce484222325ULL;
+  std::string build_id = GetBuildID();
+  if (!build_id.empty()) {
+    token = HashBytes(token, build_id.data(), build_id.size());
+  } else {
+    token = HashBytes(token, name.c_str(), name.size());
+    token = HashBytes(token, &elf_start_offset, sizeof(elf_start_offset));
+  }
+  if (token == 0) {
+    // Zero means the token has not been computed yet.
+    token = 1;
+  }
+  // Every thread computes the same value, so there is no need to check
+  // if another thread got here first.
+  build_id_token.store(token, std::memory_order_relaxed);
+  return token;
+}
+
 }  // namespace unwindstack
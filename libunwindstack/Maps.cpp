@@ -24,53 +24,116 @@
 #include <sys/types.h>
 #include <unistd.h>
 
-#include <android-base/unique_fd.h>
-#include <procinfo/process_map.h>
-
 #include <algorithm>
 #include <cctype>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <unwindstack/Elf.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
 
+#include "Check.h"
+#include "MapsParser.h"
+
 namespace unwindstack {
 
+// Interns the names of the maps created by one parse. Processes usually
+// have many more maps than distinct map names.
+class MapNamePool {
+ public:
+  // Reuse name for any map with the same name, such as when reparsing.
+  void Add(const SharedString& name) { names_.emplace(name.str(), name); }
+
+  SharedString Get(std::string_view name) {
+    auto entry = names_.find(name);
+    if (entry != names_.end()) {
+      return entry->second;
+    }
+    SharedString shared_name{std::string(name)};
+    // The key refers to the data owned by the value.
+    names_.emplace(shared_name.str(), shared_name);
+    return shared_name;
+  }
+
+ private:
+  std::unordered_map<std::string_view, SharedString> names_;
+};
+
+// Mark a device map in /dev/ and not in /dev/ashmem/ specially.
+static bool IsDeviceMap(std::string_view name) {
+  return name.compare(0, 5, "/dev/") == 0 && name.compare(5, 7, "ashmem/") != 0;
+}
+
+// Returns a callback that appends every parsed map to maps.
+static MapsParserCallback AddParsedMap(std::vector<std::unique_ptr<MapInfo>>* maps,
+                                       MapNamePool* names) {
+  return [maps, names](uint64_t start, uint64_t end, uint16_t flags, uint64_t pgoff,
+                       std::string_view name) {
+    if (IsDeviceMap(name)) {
+      flags |= MAPS_FLAGS_DEVICE_MAP;
+    }
+    maps->emplace_back(new MapInfo(maps->empty() ? nullptr : maps->back().get(), start, end,
+                                   pgoff, flags, names->Get(name)));
+  };
+}
+
+// Find the index of the range containing pc, or starts.size() if there is
+// none. The loop always runs the same number of iterations, and the
+// compiler turns the comparison into a conditional move rather than a
+// branch.
+static size_t FindRange(const std::vector<uint64_t>& starts, const std::vector<uint64_t>& ends,
+                        uint64_t pc) {
+  if (starts.empty()) {
+    return 0;
+  }
+  // Find the last range that starts at or before pc.
+  const uint64_t* base = starts.data();
+  size_t total = starts.size();
+  while (total > 1) {
+    size_t half = total / 2;
+    base = (base[half] <= pc) ? base + half : base;
+    total -= half;
+  }
+  size_t index = base - starts.data();
+  if (*base > pc || pc >= ends[index]) {
+    return starts.size();
+  }
+  return index;
+}
+
 MapInfo* Maps::Find(uint64_t pc) {
   if (maps_.empty()) {
     return nullptr;
   }
-  size_t first = 0;
-  size_t last = maps_.size();
-  while (first < last) {
-    size_t index = (first + last) / 2;
-    const auto& cur = maps_[index];
-    if (pc >= cur->start && pc < cur->end) {
-      return cur.get();
-    } else if (pc < cur->start) {
-      last = index;
-    } else {
-      first = index + 1;
-    }
+  CHECK(map_starts_.size() == maps_.size());
+
+  size_t index = FindRange(map_starts_, map_ends_, pc);
+  if (index == maps_.size()) {
+    return nullptr;
+  }
+  return maps_[index].get();
+}
+
+void Maps::UpdateRanges() {
+  map_starts_.resize(maps_.size());
+  map_ends_.resize(maps_.size());
+  for (size_t i = 0; i < maps_.size(); i++) {
+    map_starts_[i] = maps_[i]->start;
+    map_ends_[i] = maps_[i]->end;
   }
-  return nullptr;
 }
 
 bool Maps::Parse() {
-  return android::procinfo::ReadMapFile(
-      GetMapsFile(),
-      [&](uint64_t start, uint64_t end, uint16_t flags, uint64_t pgoff, ino_t, const char* name) {
-        // Mark a device map in /dev/ and not in /dev/ashmem/ specially.
-        if (strncmp(name, "/dev/", 5) == 0 && strncmp(name + 5, "ashmem/", 7) != 0) {
-          flags |= unwindstack::MAPS_FLAGS_DEVICE_MAP;
-        }
-        maps_.emplace_back(
-            new MapInfo(maps_.empty() ? nullptr : maps_.back().get(), start, end, pgoff,
-                        flags, name));
-      });
+  MapNamePool names;
+  bool parsed = ParseMapsFile(GetMapsFile(), AddParsedMap(&maps_, &names));
+  UpdateRanges();
+  return parsed;
 }
 
 void Maps::Add(uint64_t start, uint64_t end, uint64_t offset, uint64_t flags,
@@ -80,6 +143,8 @@ void Maps::Add(uint64_t start, uint64_t end, uint64_t offset, uint64_t flags,
                                 flags, name);
   map_info->load_bias = load_bias;
   maps_.emplace_back(std::move(map_info));
+  map_starts_.push_back(start);
+  map_ends_.push_back(end);
 }
 
 void Maps::Sort() {
@@ -87,27 +152,119 @@ void Maps::Sort() {
             [](const std::unique_ptr<MapInfo>& a, const std::unique_ptr<MapInfo>& b) {
               return a->start < b->start; });
 
-  // Set the prev_map values on the info objects.
+  LinkMaps();
+  UpdateRanges();
+}
+
+void Maps::LinkMaps() {
   MapInfo* prev_map = nullptr;
   for (const auto& map_info : maps_) {
-    map_info->prev_map = prev_map;
+    // Readers of maps that are kept might load prev_map at the same time.
+    map_info->prev_map.store(prev_map, std::memory_order_release);
     prev_map = map_info.get();
   }
 }
 
+size_t Maps::RemoveRange(uint64_t start, uint64_t end) {
+  // Find the first map that ends after start.
+  auto it = std::upper_bound(maps_.begin(), maps_.end(), start,
+                             [](uint64_t addr, const std::unique_ptr<MapInfo>& map_info) {
+                               return addr < map_info->end;
+                             });
+  size_t index = it - maps_.begin();
+  while (index < maps_.size() && maps_[index]->start < end) {
+    MapInfo* info = maps_[index].get();
+    if (info->start < start) {
+      // Keep the beginning of this map in the existing object.
+      if (info->end > end) {
+        // The range is in the middle of the map, so split it.
+        maps_.emplace(maps_.begin() + index + 1,
+                      new MapInfo(info, end, info->end, info->offset + end - info->start,
+                                  info->flags, info->name));
+      }
+      info->end = start;
+      index++;
+    } else if (info->end > end) {
+      // The start of the map moves, so the end of it becomes a new map.
+      auto map_info = std::make_unique<MapInfo>(info->prev_map.load(), end, info->end,
+                                                info->offset + end - info->start, info->flags,
+                                                info->name);
+      RetireMap(std::move(maps_[index]));
+      maps_[index] = std::move(map_info);
+      break;
+    } else {
+      RetireMap(std::move(maps_[index]));
+      maps_.erase(maps_.begin() + index);
+    }
+  }
+  return index;
+}
+
+void Maps::ApplyMmap(uint64_t start, uint64_t end, uint64_t pgoff, uint64_t prot,
+                     const std::string& name) {
+  if (start >= end) {
+    return;
+  }
+  ReleaseRetiredMaps();
+
+  uint64_t flags = prot & (PROT_READ | PROT_WRITE | PROT_EXEC);
+  if (IsDeviceMap(name)) {
+    flags |= MAPS_FLAGS_DEVICE_MAP;
+  }
+
+  // Nothing changes if the same map is mapped again.
+  MapInfo* info = Find(start);
+  if (info != nullptr && info->start == start && info->name == name) {
+    if (info->end == end && info->offset == pgoff &&
+        (info->flags & ~MAPS_FLAGS_USER_FLAGS) == flags) {
+      return;
+    }
+    flags |= info->flags & MAPS_FLAGS_USER_FLAGS;
+  }
+
+  // Two maps are merged the same way the kernel merges them, but not once
+  // an Elf object has been created for either of them.
+  auto can_merge = [](const MapInfo* first, const MapInfo* second) {
+    if (first->end != second->start || first->flags != second->flags ||
+        first->name != second->name || first->elf != nullptr || second->elf != nullptr) {
+      return false;
+    }
+    return first->name.empty() || first->offset + first->end - first->start == second->offset;
+  };
+
+  size_t index = RemoveRange(start, end);
+  auto map_info = std::make_unique<MapInfo>(nullptr, start, end, pgoff, flags, name);
+  if (index > 0 && can_merge(maps_[index - 1].get(), map_info.get())) {
+    index--;
+    maps_[index]->end = end;
+  } else {
+    maps_.emplace(maps_.begin() + index, std::move(map_info));
+  }
+  if (index + 1 < maps_.size() && can_merge(maps_[index].get(), maps_[index + 1].get())) {
+    maps_[index]->end = maps_[index + 1]->end;
+    RetireMap(std::move(maps_[index + 1]));
+    maps_.erase(maps_.begin() + index + 1);
+  }
+
+  LinkMaps();
+  UpdateRanges();
+}
+
+void Maps::ApplyMunmap(uint64_t start, uint64_t end) {
+  if (start >= end) {
+    return;
+  }
+  ReleaseRetiredMaps();
+  RemoveRange(start, end);
+  LinkMaps();
+  UpdateRanges();
+}
+
 bool BufferMaps::Parse() {
-  std::string content(buffer_);
-  return android::procinfo::ReadMapFileContent(
-      &content[0],
-      [&](uint64_t start, uint64_t end, uint16_t flags, uint64_t pgoff, ino_t, const char* name) {
-        // Mark a device map in /dev/ and not in /dev/ashmem/ specially.
-        if (strncmp(name, "/dev/", 5) == 0 && strncmp(name + 5, "ashmem/", 7) != 0) {
-          flags |= unwindstack::MAPS_FLAGS_DEVICE_MAP;
-        }
-        maps_.emplace_back(
-            new MapInfo(maps_.empty() ? nullptr : maps_.back().get(), start, end, pgoff,
-                        flags, name));
-      });
+  MapNamePool names;
+  bool parsed = ParseMapsBuffer(buffer_, strlen(buffer_), AddParsedMap(&maps_, &names));
+  UpdateRanges();
+  return parsed;
 }
 
 const std::string RemoteMaps::GetMapsFile() const {
@@ -118,68 +275,163 @@ const std::string LocalUpdatableMaps::GetMapsFile() const {
   return "/proc/self/maps";
 }
 
-bool LocalUpdatableMaps::Reparse() {
-  // New maps will be added at the end without deleting the old ones.
-  size_t last_map_idx = maps_.size();
-  if (!Parse()) {
-    maps_.resize(last_map_idx);
+bool RemoteUpdatableMaps::Reparse() {
+  ReleaseRetiredMaps();
+
+  // Parse into a separate list so that the current maps are untouched if
+  // the parse fails.
+  std::vector<std::unique_ptr<MapInfo>> new_maps;
+  // The names of the current maps are reused, so that a name shared by
+  // the kept maps and the new maps is only stored once.
+  MapNamePool names;
+  for (const auto& map_info : maps_) {
+    names.Add(map_info->name);
+  }
+  if (!ParseMapsFile(GetMapsFile(), AddParsedMap(&new_maps, &names))) {
     return false;
   }
 
-  size_t total_entries = maps_.size();
-  size_t search_map_idx = 0;
-  for (size_t new_map_idx = last_map_idx; new_map_idx < maps_.size(); new_map_idx++) {
-    auto& new_map_info = maps_[new_map_idx];
-    uint64_t start = new_map_info->start;
-    uint64_t end = new_map_info->end;
-    uint64_t flags = new_map_info->flags;
-    std::string* name = &new_map_info->name;
-    for (size_t old_map_idx = search_map_idx; old_map_idx < last_map_idx; old_map_idx++) {
+  // Both lists are sorted, so merge them in a single pass. An old map is
+  // kept if an identical map is present in the new list, otherwise it is
+  // retired and replaced by the new map.
+  std::vector<std::unique_ptr<MapInfo>> merged_maps;
+  merged_maps.reserve(new_maps.size());
+  size_t old_map_idx = 0;
+  bool changed = false;
+  for (auto& new_map_info : new_maps) {
+    while (old_map_idx < maps_.size() && maps_[old_map_idx]->start < new_map_info->start) {
+      RetireMap(std::move(maps_[old_map_idx++]));
+      changed = true;
+    }
+    if (old_map_idx < maps_.size()) {
       auto& info = maps_[old_map_idx];
-      if (start == info->start && end == info->end && flags == info->flags && *name == info->name) {
-        // No need to check
-        search_map_idx = old_map_idx + 1;
-        maps_[new_map_idx] = nullptr;
-        total_entries--;
-        break;
-      } else if (info->start > start) {
-        // Stop, there isn't going to be a match.
-        search_map_idx = old_map_idx;
-        break;
+      if (info->start == new_map_info->start && info->name == new_map_info->name) {
+        if (info->end == new_map_info->end && info->offset == new_map_info->offset &&
+            (info->flags & ~MAPS_FLAGS_USER_FLAGS) == new_map_info->flags) {
+          merged_maps.emplace_back(std::move(info));
+          old_map_idx++;
+          continue;
+        }
+        new_map_info->flags |= info->flags & MAPS_FLAGS_USER_FLAGS;
       }
-
-      // Never delete these maps, they may be in use. The assumption is
-      // that there will only every be a handfull of these so waiting
-      // to destroy them is not too expensive.
-      saved_maps_.emplace_back(std::move(info));
-      maps_[old_map_idx] = nullptr;
-      total_entries--;
     }
-    if (search_map_idx >= last_map_idx) {
-      break;
+    merged_maps.emplace_back(std::move(new_map_info));
+    changed = true;
+  }
+  for (; old_map_idx < maps_.size(); old_map_idx++) {
+    RetireMap(std::move(maps_[old_map_idx]));
+    changed = true;
+  }
+  maps_ = std::move(merged_maps);
+  if (!changed) {
+    // Every map was kept, so the links and ranges are still correct.
+    return true;
+  }
+
+  // The prev_map values may point to retired maps, so set them again.
+  LinkMaps();
+  UpdateRanges();
+
+  return true;
+}
+
+bool LocalUpdatableMaps::Reparse() {
+  std::lock_guard<std::mutex> guard(reparse_mutex_);
+  return RemoteUpdatableMaps::Reparse();
+}
+
+uint64_t LocalUpdatableMaps::BeginRead() {
+  while (true) {
+    uint64_t epoch = epoch_.load();
+    readers_[epoch & 1]++;
+    // If the epoch moved on, a Reparse might not have seen this reader.
+    if (epoch_.load() == epoch) {
+      return epoch;
     }
+    readers_[epoch & 1]--;
   }
+}
 
-  // Now move out any of the maps that never were found.
-  for (size_t i = search_map_idx; i < last_map_idx; i++) {
-    saved_maps_.emplace_back(std::move(maps_[i]));
-    maps_[i] = nullptr;
-    total_entries--;
+void LocalUpdatableMaps::EndRead(uint64_t epoch) {
+  readers_[epoch & 1]--;
+}
+
+MapInfo* LocalUpdatableMaps::FindShared(uint64_t pc) {
+  const Snapshot* snapshot = snapshot_.load(std::memory_order_acquire);
+  if (snapshot == nullptr) {
+    return nullptr;
+  }
+  size_t index = FindRange(snapshot->starts, snapshot->ends, pc);
+  if (index == snapshot->maps.size()) {
+    return nullptr;
   }
+  return snapshot->maps[index];
+}
 
-  // Sort all of the values such that the nullptrs wind up at the end, then
-  // resize them away.
-  std::sort(maps_.begin(), maps_.end(), [](const auto& a, const auto& b) {
-    if (a == nullptr) {
-      return false;
-    } else if (b == nullptr) {
-      return true;
-    }
-    return a->start < b->start;
-  });
-  maps_.resize(total_entries);
+MapInfo* LocalUpdatableMaps::ReparseAndFind(uint64_t pc) {
+  std::lock_guard<std::mutex> guard(reparse_mutex_);
+  // Another thread may have reparsed while this one waited for the lock.
+  MapInfo* map_info = FindShared(pc);
+  if (map_info == nullptr && RemoteUpdatableMaps::Reparse()) {
+    map_info = FindShared(pc);
+  }
+  return map_info;
+}
 
-  return true;
+void LocalUpdatableMaps::UpdateRanges() {
+  RemoteUpdatableMaps::UpdateRanges();
+
+  auto snapshot = std::make_unique<Snapshot>();
+  snapshot->starts = map_starts_;
+  snapshot->ends = map_ends_;
+  snapshot->maps.reserve(maps_.size());
+  for (const auto& map_info : maps_) {
+    snapshot->maps.push_back(map_info.get());
+  }
+  snapshot_.store(snapshot.get(), std::memory_order_release);
+
+  // A reader might still be searching the old snapshot, so it is freed
+  // along with the maps retired by this update.
+  if (current_snapshot_ != nullptr) {
+    retired_snapshots_.emplace_back(std::move(current_snapshot_));
+  }
+  current_snapshot_ = std::move(snapshot);
+}
+
+// Free the entries of a pending list that were retired at least two epochs
+// before epoch.
+template <typename T>
+static void FreePending(std::deque<std::pair<uint64_t, std::unique_ptr<T>>>* pending,
+                        uint64_t epoch) {
+  auto it = pending->begin();
+  while (it != pending->end() && it->first + 2 <= epoch) {
+    ++it;
+  }
+  pending->erase(pending->begin(), it);
+}
+
+void LocalUpdatableMaps::ReleaseRetiredMaps() {
+  // The maps and snapshots retired by the previous update were retired
+  // during the current epoch.
+  uint64_t epoch = epoch_.load();
+  for (auto& map_info : retired_maps_) {
+    pending_maps_.emplace_back(epoch, std::move(map_info));
+  }
+  retired_maps_.clear();
+  for (auto& snapshot : retired_snapshots_) {
+    pending_snapshots_.emplace_back(epoch, std::move(snapshot));
+  }
+  retired_snapshots_.clear();
+
+  // Readers that started in the previous epoch share a counter with the
+  // next epoch. Once they are gone, advance the epoch. Any reader that
+  // could have found a map retired two epochs ago has then finished.
+  if (readers_[(epoch + 1) & 1] != 0) {
+    return;
+  }
+  epoch_ = ++epoch;
+  FreePending(&pending_maps_, epoch);
+  FreePending(&pending_snapshots_, epoch);
 }
 
 }  // namespace unwindstack
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <android-base/unique_fd.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MapsParser.h"
+
+namespace unwindstack {
+
+// The size of each read of a maps file. A typical maps file line is
+// around 100 bytes, so this covers several hundred lines.
+static constexpr size_t kReadSize = 64 * 1024;
+
+static constexpr uint8_t kNotHexDigit = 0xff;
+
+struct HexDigits {
+  constexpr HexDigits() : values() {
+    for (size_t i = 0; i < sizeof(values); i++) {
+      values[i] = kNotHexDigit;
+    }
+    for (uint8_t i = 0; i < 10; i++) {
+      values['0' + i] = i;
+    }
+    for (uint8_t i = 0; i < 6; i++) {
+      values['a' + i] = 10 + i;
+      values['A' + i] = 10 + i;
+    }
+  }
+
+  uint8_t values[256];
+};
+
+static constexpr HexDigits kHexDigits;
+
+static bool ParseHex(const char*& p, const char* end, uint64_t* value) {
+  const char* start = p;
+  uint64_t result = 0;
+  for (; p != end; p++) {
+    uint8_t digit = kHexDigits.values[static_cast<uint8_t>(*p)];
+    if (digit == kNotHexDigit) {
+      break;
+    }
+    result = (result << 4) | digit;
+  }
+  *value = result;
+  return p != start;
+}
+
+static bool PassDecimal(const char*& p, const char* end) {
+  const char* start = p;
+  while (p != end && *p >= '0' && *p <= '9') {
+    p++;
+  }
+  return p != start;
+}
+
+static bool PassSpace(const char*& p, const char* end) {
+  if (p == end || *p != ' ') {
+    return false;
+  }
+  do {
+    p++;
+  } while (p != end && *p == ' ');
+  return true;
+}
+
+// Parse a single line that does not include the newline, for example:
+//   7b29b000-7b29e000 r-xp a0000000 fc:02 44171565   /system/lib/libc.so
+static bool ParseLine(const char* p, const char* end, const MapsParserCallback& callback) {
+  uint64_t start;
+  if (!ParseHex(p, end, &start) || p == end || *p++ != '-') {
+    return false;
+  }
+  uint64_t map_end;
+  if (!ParseHex(p, end, &map_end) || !PassSpace(p, end)) {
+    return false;
+  }
+
+  if (end - p < 4) {
+    return false;
+  }
+  uint16_t flags = 0;
+  if (p[0] == 'r') {
+    flags |= PROT_READ;
+  } else if (p[0] != '-') {
+    return false;
+  }
+  if (p[1] == 'w') {
+    flags |= PROT_WRITE;
+  } else if (p[1] != '-') {
+    return false;
+  }
+  if (p[2] == 'x') {
+    flags |= PROT_EXEC;
+  } else if (p[2] != '-') {
+    return false;
+  }
+  if (p[3] != 'p' && p[3] != 's') {
+    return false;
+  }
+  p += 4;
+  if (!PassSpace(p, end)) {
+    return false;
+  }
+
+  uint64_t pgoff;
+  if (!ParseHex(p, end, &pgoff) || !PassSpace(p, end)) {
+    return false;
+  }
+
+  // Skip the major:minor device numbers.
+  uint64_t device;
+  if (!ParseHex(p, end, &device) || p == end || *p++ != ':' || !ParseHex(p, end, &device) ||
+      !PassSpace(p, end)) {
+    return false;
+  }
+
+  // Skip the inode.
+  if (!PassDecimal(p, end) || (p != end && !PassSpace(p, end))) {
+    return false;
+  }
+
+  callback(start, map_end, flags, pgoff, std::string_view(p, end - p));
+  return true;
+}
+
+bool ParseMapsBuffer(const char* buffer, size_t size, const MapsParserCallback& callback) {
+  const char* p = buffer;
+  const char* end = buffer + size;
+  while (p < end) {
+    // memchr is vectorized by libc, so this is much faster than checking
+    // every character while parsing the line.
+    const char* line_end = reinterpret_cast<const char*>(memchr(p, '\n', end - p));
+    if (line_end == nullptr) {
+      line_end = end;
+    }
+    if (!ParseLine(p, line_end, callback)) {
+      return false;
+    }
+    p = line_end + 1;
+  }
+  return true;
+}
+
+bool ParseMapsFile(const std::string& file, const MapsParserCallback& callback) {
+  android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(file.c_str(), O_RDONLY | O_CLOEXEC)));
+  if (fd == -1) {
+    return false;
+  }
+
+  std::vector<char> buffer(kReadSize);
+  size_t used = 0;
+  while (true) {
+    if (used == buffer.size()) {
+      // A single line does not fit in the buffer.
+      buffer.resize(buffer.size() * 2);
+    }
+    ssize_t bytes = TEMP_FAILURE_RETRY(read(fd, buffer.data() + used, buffer.size() - used));
+    if (bytes < 0) {
+      return false;
+    }
+    if (bytes == 0) {
+      break;
+    }
+    used += bytes;
+
+    // Parse all of the complete lines, and keep any partial line for the
+    // next read.
+    const char* data = buffer.data();
+    const char* last_newline = reinterpret_cast<const char*>(memrchr(data, '\n', used));
+    if (last_newline == nullptr) {
+      continue;
+    }
+    size_t parsed = last_newline + 1 - data;
+    if (!ParseMapsBuffer(data, parsed, callback)) {
+      return false;
+    }
+    memmove(buffer.data(), data + parsed, used - parsed);
+    used -= parsed;
+  }
+  return ParseMapsBuffer(buffer.data(), used, callback);
+}
+
+}  // namespace unwindstack
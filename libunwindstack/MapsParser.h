@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBUNWINDSTACK_MAPS_PARSER_H
+#define _LIBUNWINDSTACK_MAPS_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace unwindstack {
+
+// Called for every line of a maps file. The name is only valid for the
+// duration of the call.
+typedef std::function<void(uint64_t start, uint64_t end, uint16_t flags, uint64_t pgoff,
+                           std::string_view name)>
+    MapsParserCallback;
+
+// Parse the lines of a maps file that is already in memory. Returns false
+// if any line is malformed.
+bool ParseMapsBuffer(const char* buffer, size_t size, const MapsParserCallback& callback);
+
+// Read and parse a maps file, such as /proc/<pid>/maps, in large chunks.
+// Returns false if the file cannot be read or any line is malformed.
+bool ParseMapsFile(const std::string& file, const MapsParserCallback& callback);
+
+}  // namespace unwindstack
+
+#endif  // _LIBUNWINDSTACK_MAPS_PARSER_H
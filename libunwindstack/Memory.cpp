@@ -384,6 +384,24 @@ size_t MemoryOfflineBuffer::Read(uint64_t addr, void* dst, size_t size) {
   return read_length;
 }
 
+void MemorySnapshot::Reset(const uint8_t* data, uint64_t start, uint64_t end) {
+  data_ = data;
+  start_ = start;
+  end_ = end;
+}
+
+size_t MemorySnapshot::Read(uint64_t addr, void* dst, size_t size) {
+  if (addr >= start_ && addr < end_) {
+    size_t read_length = std::min(size, static_cast<size_t>(end_ - addr));
+    memcpy(dst, &data_[addr - start_], read_length);
+    return read_length;
+  }
+  if (memory_ == nullptr) {
+    return 0;
+  }
+  return memory_->Read(addr, dst, size);
+}
+
 MemoryOfflineParts::~MemoryOfflineParts() {
   for (auto memory : memories_) {
     delete memory;
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBUNWINDSTACK_MEMORY_USAGE_H
+#define _LIBUNWINDSTACK_MEMORY_USAGE_H
+
+#include <stdint.h>
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace unwindstack {
+
+// Rough estimates of the heap used by the standard containers. These do
+// not include anything allocated by the elements themselves.
+
+template <typename Key, typename Value, typename Hash>
+static inline uint64_t ContainerMemoryUsage(const std::unordered_map<Key, Value, Hash>& map) {
+  // Each node holds the value and a next pointer, plus one bucket pointer.
+  return map.size() * (sizeof(typename std::unordered_map<Key, Value, Hash>::value_type) +
+                       sizeof(void*) + sizeof(size_t)) +
+         map.bucket_count() * sizeof(void*);
+}
+
+template <typename Key, typename Value>
+static inline uint64_t ContainerMemoryUsage(const std::map<Key, Value>& map) {
+  // Each node holds the value, three pointers and the color.
+  return map.size() *
+         (sizeof(typename std::map<Key, Value>::value_type) + 4 * sizeof(void*));
+}
+
+template <typename Value>
+static inline uint64_t ContainerMemoryUsage(const std::vector<Value>& vector) {
+  return vector.capacity() * sizeof(Value);
+}
+
+}  // namespace unwindstack
+
+#endif  // _LIBUNWINDSTACK_MEMORY_USAGE_H
@@ -92,6 +92,13 @@ bool RegsArm::SetPcFromReturnAddress(Memory*) {
   return true;
 }
 
+bool RegsArm::StepFromFramePointer(Memory*) {
+  // Arm and thumb code use different frame pointer registers, and the
+  // layout of the frame depends on the compiler, so there is no frame
+  // record that can be trusted.
+  return false;
+}
+
 void RegsArm::IterateRegisters(std::function<void(const char*, uint64_t)> fn) {
   fn("r0", regs_[ARM_REG_R0]);
   fn("r1", regs_[ARM_REG_R1]);
@@ -69,6 +69,30 @@ bool RegsArm64::SetPcFromReturnAddress(Memory*) {
   return true;
 }
 
+bool RegsArm64::StepFromFramePointer(Memory* process_memory) {
+  // The frame pointer points to a frame record with the caller's frame
+  // pointer and the return address.
+  uint64_t fp = regs_[ARM64_REG_R29];
+  uint64_t frame[2];
+  if (fp < regs_[ARM64_REG_SP] || (fp & (sizeof(uint64_t) - 1)) != 0 ||
+      !process_memory->ReadFully(fp, frame, sizeof(frame))) {
+    return false;
+  }
+  // The caller's frame must be further up the stack, unless there is none.
+  if ((frame[0] != 0 && frame[0] <= fp) || frame[1] == 0) {
+    return false;
+  }
+
+  regs_[ARM64_REG_R29] = frame[0];
+  regs_[ARM64_REG_PC] = frame[1];
+  // The frame record is not always at the top of the frame, so this is
+  // the lowest the caller's sp can be rather than its exact value. The
+  // lr of the caller cannot be recovered either. The Unwinder only
+  // follows the frame pointer chain from here.
+  regs_[ARM64_REG_SP] = fp + sizeof(frame);
+  return true;
+}
+
 void RegsArm64::IterateRegisters(std::function<void(const char*, uint64_t)> fn) {
   fn("x0", regs_[ARM64_REG_R0]);
   fn("x1", regs_[ARM64_REG_R1]);
@@ -70,6 +70,11 @@ bool RegsMips::SetPcFromReturnAddress(Memory*) {
   return true;
 }
 
+bool RegsMips::StepFromFramePointer(Memory*) {
+  // There is no standard frame record to follow.
+  return false;
+}
+
 void RegsMips::IterateRegisters(std::function<void(const char*, uint64_t)> fn) {
   fn("r0", regs_[MIPS_REG_R0]);
   fn("r1", regs_[MIPS_REG_R1]);
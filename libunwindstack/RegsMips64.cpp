@@ -70,6 +70,11 @@ bool RegsMips64::SetPcFromReturnAddress(Memory*) {
   return true;
 }
 
+bool RegsMips64::StepFromFramePointer(Memory*) {
+  // There is no standard frame record to follow.
+  return false;
+}
+
 void RegsMips64::IterateRegisters(std::function<void(const char*, uint64_t)> fn) {
   fn("r0", regs_[MIPS64_REG_R0]);
   fn("r1", regs_[MIPS64_REG_R1]);
@@ -69,6 +69,26 @@ bool RegsX86::SetPcFromReturnAddress(Memory* process_memory) {
   return true;
 }
 
+bool RegsX86::StepFromFramePointer(Memory* process_memory) {
+  // The frame pointer points to the caller's frame pointer, followed by
+  // the return address.
+  uint32_t fp = regs_[X86_REG_EBP];
+  uint32_t frame[2];
+  if (fp < regs_[X86_REG_SP] || (fp & (sizeof(uint32_t) - 1)) != 0 ||
+      !process_memory->ReadFully(fp, frame, sizeof(frame))) {
+    return false;
+  }
+  // The caller's frame must be further up the stack, unless there is none.
+  if ((frame[0] != 0 && frame[0] <= fp) || frame[1] == 0) {
+    return false;
+  }
+
+  regs_[X86_REG_EBP] = frame[0];
+  regs_[X86_REG_PC] = frame[1];
+  regs_[X86_REG_SP] = fp + sizeof(frame);
+  return true;
+}
+
 void RegsX86::IterateRegisters(std::function<void(const char*, uint64_t)> fn) {
   fn("eax", regs_[X86_REG_EAX]);
   fn("ebx", regs_[X86_REG_EBX]);
@@ -70,6 +70,26 @@ bool RegsX86_64::SetPcFromReturnAddress(Memory* process_memory) {
   return true;
 }
 
+bool RegsX86_64::StepFromFramePointer(Memory* process_memory) {
+  // The frame pointer points to the caller's frame pointer, followed by
+  // the return address.
+  uint64_t fp = regs_[X86_64_REG_RBP];
+  uint64_t frame[2];
+  if (fp < regs_[X86_64_REG_SP] || (fp & (sizeof(uint64_t) - 1)) != 0 ||
+      !process_memory->ReadFully(fp, frame, sizeof(frame))) {
+    return false;
+  }
+  // The caller's frame must be further up the stack, unless there is none.
+  if ((frame[0] != 0 && frame[0] <= fp) || frame[1] == 0) {
+    return false;
+  }
+
+  regs_[X86_64_REG_RBP] = frame[0];
+  regs_[X86_64_REG_PC] = frame[1];
+  regs_[X86_64_REG_SP] = fp + sizeof(frame);
+  return true;
+}
+
 void RegsX86_64::IterateRegisters(std::function<void(const char*, uint64_t)> fn) {
   fn("rax", regs_[X86_64_REG_RAX]);
   fn("rbx", regs_[X86_64_REG_RBX]);
@@ -0,0 +1,376 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <unwindstack/Elf.h>
+#include <unwindstack/Error.h>
+#include <unwindstack/MachineArm64.h>
+#include <unwindstack/MachineX86_64.h>
+#include <unwindstack/Memory.h>
+#include <unwindstack/Regs.h>
+#include <unwindstack/SFrameSection.h>
+
+#include "MemoryUsage.h"
+
+namespace unwindstack {
+
+static constexpr uint16_t kSFrameMagic = 0xdee2;
+
+static constexpr uint8_t kSFrameVersion1 = 1;
+static constexpr uint8_t kSFrameVersion2 = 2;
+
+static constexpr uint8_t kSFrameFlagFdeSorted = 0x1;
+static constexpr uint8_t kSFrameFlagFdeFuncStartPcRel = 0x4;
+
+static constexpr uint8_t kSFrameAbiAarch64EndianLittle = 2;
+static constexpr uint8_t kSFrameAbiAmd64EndianLittle = 3;
+
+// The size of the preamble and the header, without the auxiliary header.
+static constexpr size_t kSFrameHeaderSize = 28;
+static constexpr size_t kSFrameFdeSizeV1 = 17;
+static constexpr size_t kSFrameFdeSizeV2 = 20;
+
+// The fields of the info byte of an FDE.
+static constexpr uint8_t kFdeFreTypeMask = 0xf;
+static constexpr uint8_t kFdeTypePcMask = 0x10;
+
+// The fields of the info byte of an FRE.
+static constexpr uint8_t kFreBaseRegSp = 0x1;
+static constexpr uint8_t kFreMangledRa = 0x80;
+
+// Version 1 has no repeated block size, pc mask FDEs are only used for
+// plt entries, which are 16 bytes.
+static constexpr uint8_t kSFrameV1RepSize = 16;
+
+template <typename Type>
+static inline Type ReadValue(const uint8_t* data) {
+  Type value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+bool SFrameSection::Init(uint64_t offset, uint64_t size, uint64_t load_bias) {
+  load_bias_ = load_bias;
+  section_offset_ = offset;
+
+  uint8_t header[kSFrameHeaderSize];
+  if (!memory_->ReadFully(offset, header, sizeof(header))) {
+    last_error_.code = ERROR_MEMORY_INVALID;
+    last_error_.address = offset;
+    return false;
+  }
+
+  // This also rejects sections with the other endianness.
+  if (ReadValue<uint16_t>(&header[0]) != kSFrameMagic) {
+    last_error_.code = ERROR_UNWIND_INFO;
+    return false;
+  }
+  version_ = header[2];
+  flags_ = header[3];
+  abi_arch_ = header[4];
+  if (version_ == kSFrameVersion1) {
+    fde_size_ = kSFrameFdeSizeV1;
+  } else if (version_ == kSFrameVersion2) {
+    fde_size_ = kSFrameFdeSizeV2;
+  } else {
+    last_error_.code = ERROR_UNSUPPORTED;
+    return false;
+  }
+  if ((flags_ & kSFrameFlagFdeSorted) == 0 ||
+      (abi_arch_ != kSFrameAbiAarch64EndianLittle && abi_arch_ != kSFrameAbiAmd64EndianLittle)) {
+    last_error_.code = ERROR_UNSUPPORTED;
+    return false;
+  }
+  fixed_fp_offset_ = static_cast<int8_t>(header[5]);
+  fixed_ra_offset_ = static_cast<int8_t>(header[6]);
+  uint8_t aux_header_size = header[7];
+  num_fdes_ = ReadValue<uint32_t>(&header[8]);
+  uint32_t fres_size = ReadValue<uint32_t>(&header[16]);
+
+  uint64_t data_offset = offset + kSFrameHeaderSize + aux_header_size;
+  fdes_offset_ = data_offset + ReadValue<uint32_t>(&header[20]);
+  fres_offset_ = data_offset + ReadValue<uint32_t>(&header[24]);
+  fres_end_ = fres_offset_ + fres_size;
+  if (num_fdes_ == 0 || fdes_offset_ + num_fdes_ * fde_size_ > offset + size ||
+      fres_end_ > offset + size) {
+    last_error_.code = ERROR_UNWIND_INFO;
+    return false;
+  }
+  return true;
+}
+
+const SFrameSection::Fde* SFrameSection::GetFdeFromIndex(size_t index) {
+  auto entry = fdes_.find(index);
+  if (entry != fdes_.end()) {
+    return &entry->second;
+  }
+
+  uint64_t entry_offset = fdes_offset_ + index * fde_size_;
+  uint8_t data[kSFrameFdeSizeV2];
+  if (!memory_->ReadFully(entry_offset, data, fde_size_)) {
+    last_error_.code = ERROR_MEMORY_INVALID;
+    last_error_.address = entry_offset;
+    return nullptr;
+  }
+
+  Fde* fde = &fdes_[index];
+  // The start of the function is relative to the start of the section,
+  // or to the field itself.
+  uint64_t base = (flags_ & kSFrameFlagFdeFuncStartPcRel) ? entry_offset : section_offset_;
+  fde->pc_start = base + ReadValue<int32_t>(&data[0]) + load_bias_;
+  fde->pc_end = fde->pc_start + ReadValue<uint32_t>(&data[4]);
+  fde->fres_offset = fres_offset_ + ReadValue<uint32_t>(&data[8]);
+  fde->num_fres = ReadValue<uint32_t>(&data[12]);
+  fde->info = data[16];
+  fde->rep_size = (version_ == kSFrameVersion1) ? kSFrameV1RepSize : data[17];
+  return fde;
+}
+
+bool SFrameSection::GetFdeFromPc(uint64_t pc, Fde* fde) {
+  // Find the last FDE that starts at or before the pc.
+  size_t first = 0;
+  size_t last = num_fdes_;
+  while (first < last) {
+    size_t current = (first + last) / 2;
+    const Fde* entry = GetFdeFromIndex(current);
+    if (entry == nullptr) {
+      return false;
+    }
+    if (pc < entry->pc_start) {
+      last = current;
+    } else {
+      first = current + 1;
+    }
+  }
+  if (last == 0) {
+    last_error_.code = ERROR_UNWIND_INFO;
+    return false;
+  }
+  const Fde* entry = GetFdeFromIndex(last - 1);
+  if (entry == nullptr) {
+    return false;
+  }
+  if (pc >= entry->pc_end) {
+    last_error_.code = ERROR_UNWIND_INFO;
+    return false;
+  }
+  *fde = *entry;
+  return true;
+}
+
+bool SFrameSection::GetFreFromPc(const Fde& fde, uint64_t pc, Fre* fre) {
+  uint64_t pc_offset = pc - fde.pc_start;
+  uint64_t base = fde.pc_start;
+  uint64_t end = fde.pc_end;
+  if (fde.info & kFdeTypePcMask) {
+    if (fde.rep_size == 0) {
+      last_error_.code = ERROR_UNWIND_INFO;
+      return false;
+    }
+    pc_offset %= fde.rep_size;
+    base = pc - pc_offset;
+    end = std::min(end, base + fde.rep_size);
+  }
+
+  size_t addr_size;
+  switch (fde.info & kFdeFreTypeMask) {
+    case 0:
+      addr_size = 1;
+      break;
+    case 1:
+      addr_size = 2;
+      break;
+    case 2:
+      addr_size = 4;
+      break;
+    default:
+      last_error_.code = ERROR_UNSUPPORTED;
+      return false;
+  }
+
+  // The FREs are sorted, use the last one that starts at or before the pc.
+  uint64_t offset = fde.fres_offset;
+  bool found = false;
+  uint64_t offsets_offset = 0;
+  size_t offset_size = 0;
+  for (uint32_t i = 0; i < fde.num_fres; i++) {
+    uint8_t data[5] = {};
+    if (offset + addr_size + 1 > fres_end_ || !memory_->ReadFully(offset, data, addr_size + 1)) {
+      last_error_.code = ERROR_MEMORY_INVALID;
+      last_error_.address = offset;
+      return false;
+    }
+    uint32_t start = ReadValue<uint32_t>(data) & (0xffffffffULL >> (32 - 8 * addr_size));
+    if (start > pc_offset) {
+      end = base + start;
+      break;
+    }
+    uint8_t info = data[addr_size];
+    uint8_t size_type = (info >> 5) & 0x3;
+    if (size_type == 3) {
+      last_error_.code = ERROR_UNSUPPORTED;
+      return false;
+    }
+    found = true;
+    fre->pc_start = base + start;
+    fre->info = info;
+    fre->num_offsets = (info >> 1) & 0xf;
+    offset_size = 1 << size_type;
+    offsets_offset = offset + addr_size + 1;
+    offset = offsets_offset + fre->num_offsets * offset_size;
+  }
+  if (!found) {
+    last_error_.code = ERROR_UNWIND_INFO;
+    return false;
+  }
+  fre->pc_end = end;
+
+  // At most the cfa, return address and frame pointer offsets.
+  if (fre->num_offsets > 3) {
+    last_error_.code = ERROR_UNSUPPORTED;
+    return false;
+  }
+  uint8_t data[3 * sizeof(int32_t)];
+  if (!memory_->ReadFully(offsets_offset, data, fre->num_offsets * offset_size)) {
+    last_error_.code = ERROR_MEMORY_INVALID;
+    last_error_.address = offsets_offset;
+    return false;
+  }
+  for (size_t i = 0; i < fre->num_offsets; i++) {
+    const uint8_t* value = &data[i * offset_size];
+    switch (offset_size) {
+      case 1:
+        fre->offsets[i] = ReadValue<int8_t>(value);
+        break;
+      case 2:
+        fre->offsets[i] = ReadValue<int16_t>(value);
+        break;
+      default:
+        fre->offsets[i] = ReadValue<int32_t>(value);
+        break;
+    }
+  }
+  return true;
+}
+
+bool SFrameSection::Step(uint64_t pc, Regs* regs, Memory* process_memory, bool* finished) {
+  last_error_.code = ERROR_NONE;
+  last_error_.address = 0;
+
+  uint16_t fp_reg;
+  uint16_t lr_reg;
+  if (abi_arch_ == kSFrameAbiAmd64EndianLittle && regs->Arch() == ARCH_X86_64) {
+    fp_reg = X86_64_REG_RBP;
+    // The return address is always on the stack.
+    lr_reg = X86_64_REG_LAST;
+  } else if (abi_arch_ == kSFrameAbiAarch64EndianLittle && regs->Arch() == ARCH_ARM64) {
+    fp_reg = ARM64_REG_R29;
+    lr_reg = ARM64_REG_LR;
+  } else {
+    last_error_.code = ERROR_UNSUPPORTED;
+    return false;
+  }
+
+  // Lookup the pc in the cache.
+  auto entry = fres_.upper_bound(pc);
+  if (entry == fres_.end() || pc < entry->second.pc_start) {
+    Fde fde;
+    Fre fre;
+    if (!GetFdeFromPc(pc, &fde) || !GetFreFromPc(fde, pc, &fre)) {
+      return false;
+    }
+    entry = fres_.insert_or_assign(fre.pc_end, fre).first;
+  }
+  const Fre& fre = entry->second;
+
+  // A signed return address would need to be authenticated first.
+  if (fre.info & kFreMangledRa) {
+    last_error_.code = ERROR_UNSUPPORTED;
+    return false;
+  }
+
+  RegsImpl<uint64_t>* cur_regs = reinterpret_cast<RegsImpl<uint64_t>*>(regs);
+  // An FRE without any offsets marks the outermost frame.
+  if (fre.num_offsets == 0) {
+    cur_regs->set_pc(0);
+    *finished = true;
+    return true;
+  }
+
+  uint64_t cfa = (fre.info & kFreBaseRegSp) ? cur_regs->sp() : (*cur_regs)[fp_reg];
+  cfa += fre.offsets[0];
+  size_t next_offset = 1;
+
+  uint64_t return_address;
+  int32_t ra_offset;
+  if (fixed_ra_offset_ != 0) {
+    ra_offset = fixed_ra_offset_;
+  } else if (next_offset < fre.num_offsets) {
+    ra_offset = fre.offsets[next_offset++];
+  } else {
+    ra_offset = 0;
+  }
+  if (ra_offset != 0) {
+    if (!process_memory->ReadFully(cfa + ra_offset, &return_address, sizeof(return_address))) {
+      last_error_.code = ERROR_MEMORY_INVALID;
+      last_error_.address = cfa + ra_offset;
+      return false;
+    }
+  } else if (lr_reg < cur_regs->total_regs()) {
+    // The return address has not been saved yet.
+    return_address = (*cur_regs)[lr_reg];
+  } else {
+    last_error_.code = ERROR_UNWIND_INFO;
+    return false;
+  }
+
+  int32_t fp_offset;
+  if (fixed_fp_offset_ != 0) {
+    fp_offset = fixed_fp_offset_;
+  } else if (next_offset < fre.num_offsets) {
+    fp_offset = fre.offsets[next_offset];
+  } else {
+    // The frame pointer has not been saved, so it is unchanged.
+    fp_offset = 0;
+  }
+  if (fp_offset != 0) {
+    uint64_t fp;
+    if (!process_memory->ReadFully(cfa + fp_offset, &fp, sizeof(fp))) {
+      last_error_.code = ERROR_MEMORY_INVALID;
+      last_error_.address = cfa + fp_offset;
+      return false;
+    }
+    (*cur_regs)[fp_reg] = fp;
+  }
+
+  // Always set the dex pc to zero when evaluating.
+  cur_regs->set_dex_pc(0);
+  cur_regs->set_pc(return_address);
+  cur_regs->set_sp(cfa);
+  // If the pc was set to zero, consider this the final frame.
+  *finished = return_address == 0;
+  return true;
+}
+
+uint64_t SFrameSection::MemoryUsage() {
+  return ContainerMemoryUsage(fdes_) + ContainerMemoryUsage(fres_);
+}
+
+}  // namespace unwindstack
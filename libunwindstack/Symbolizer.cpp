@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unwindstack/DexFiles.h>
+#include <unwindstack/Elf.h>
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Maps.h>
+#include <unwindstack/Symbolizer.h>
+
+namespace unwindstack {
+
+uint64_t Symbolizer::GetFunctionPc(const CompactFrameData& frame) {
+  if (frame.elf != frame.map_info->elf.get() ||
+      (frame.map_info->flags & MAPS_FLAGS_JIT_SYMFILE_MAP)) {
+    return frame.pc;
+  }
+  return frame.rel_pc;
+}
+
+void Symbolizer::Add(const CompactFrameData& frame) {
+  if (frame.map_info == nullptr) {
+    return;
+  }
+  if (frame.elf == nullptr) {
+    // This is a dex frame.
+    if (dex_functions_.emplace(frame.pc, FunctionInfo()).second) {
+      pending_dex_.emplace_back(frame.pc, frame.map_info);
+    }
+    return;
+  }
+  Add(frame.elf, GetFunctionPc(frame));
+}
+
+void Symbolizer::Add(Elf* elf, uint64_t addr) {
+  if (elf != last_elf_) {
+    last_elf_ = elf;
+    auto entry = elfs_.try_emplace(elf);
+    last_elf_functions_ = &entry.first->second;
+    if (entry.second) {
+      elf_order_.emplace_back(elf, last_elf_functions_);
+    }
+  }
+  // Only queue an address the first time it is seen.
+  if (last_elf_functions_->functions.emplace(addr, FunctionInfo()).second) {
+    last_elf_functions_->pending.push_back(addr);
+  }
+}
+
+const FunctionInfo* Symbolizer::Find(const CompactFrameData& frame) const {
+  if (frame.map_info == nullptr) {
+    return nullptr;
+  }
+  if (frame.elf == nullptr) {
+    auto entry = dex_functions_.find(frame.pc);
+    return entry == dex_functions_.end() ? nullptr : &entry->second;
+  }
+  return Find(frame.elf, GetFunctionPc(frame));
+}
+
+const FunctionInfo* Symbolizer::Find(Elf* elf, uint64_t addr) const {
+  auto elf_entry = elfs_.find(elf);
+  if (elf_entry == elfs_.end()) {
+    return nullptr;
+  }
+  auto entry = elf_entry->second.functions.find(addr);
+  return entry == elf_entry->second.functions.end() ? nullptr : &entry->second;
+}
+
+void Symbolizer::ResolveElf(Elf* elf, ElfFunctions* elf_functions) {
+  std::vector<uint64_t>& addrs = elf_functions->pending;
+  std::sort(addrs.begin(), addrs.end());
+
+  std::vector<FunctionInfo> functions(addrs.size());
+  elf->GetFunctionNames(addrs.data(), addrs.size(), functions.data());
+  for (size_t i = 0; i < addrs.size(); i++) {
+    elf_functions->functions[addrs[i]] = std::move(functions[i]);
+  }
+  addrs.clear();
+}
+
+void Symbolizer::ResolveDex() {
+#if !defined(NO_LIBDEXFILE_SUPPORT)
+  if (dex_files_ != nullptr) {
+    for (const auto& entry : pending_dex_) {
+      std::string method_name;
+      uint64_t method_offset = 0;
+      dex_files_->GetMethodInformation(maps_, entry.second, entry.first, &method_name,
+                                       &method_offset);
+      FunctionInfo* function = &dex_functions_[entry.first];
+      function->name = std::move(method_name);
+      function->offset = method_offset;
+    }
+  }
+#endif
+  pending_dex_.clear();
+}
+
+void Symbolizer::RunWorker() {
+  while (true) {
+    size_t index = next_work_.fetch_add(1);
+    if (index >= work_.size()) {
+      break;
+    }
+    ResolveElf(work_[index].first, work_[index].second);
+  }
+}
+
+void Symbolizer::Resolve() {
+  work_.clear();
+  for (const auto& entry : elf_order_) {
+    if (!entry.second->pending.empty()) {
+      work_.push_back(entry);
+    }
+  }
+  // Start with the Elf objects that have the most functions to find, so
+  // that one large group does not end up running alone at the end. Ties
+  // keep the order the Elf objects were first added in, so that a single
+  // thread always looks them up in the same order.
+  std::stable_sort(work_.begin(), work_.end(), [](const auto& a, const auto& b) {
+    return a.second->pending.size() > b.second->pending.size();
+  });
+
+  next_work_ = 0;
+  std::vector<std::thread> threads;
+  size_t num_threads = std::min(num_threads_, work_.size());
+  for (size_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(&Symbolizer::RunWorker, this);
+  }
+  RunWorker();
+  ResolveDex();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  work_.clear();
+}
+
+void Symbolizer::Clear() {
+  elfs_.clear();
+  elf_order_.clear();
+  last_elf_ = nullptr;
+  last_elf_functions_ = nullptr;
+  work_.clear();
+  pending_dex_.clear();
+  dex_functions_.clear();
+}
+
+size_t Symbolizer::NumFunctions() const {
+  size_t total = dex_functions_.size();
+  for (const auto& entry : elfs_) {
+    total += entry.second.functions.size();
+  }
+  return total;
+}
+
+}  // namespace unwindstack
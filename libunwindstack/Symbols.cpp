@@ -16,10 +16,13 @@
 
 #include <elf.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <algorithm>
 #include <string>
+#include <vector>
 
+#include <unwindstack/ElfInterface.h>
 #include <unwindstack/Memory.h>
 
 #include "Check.h"
@@ -103,6 +106,87 @@ bool Symbols::GetName(uint64_t addr, Memory* elf_memory, std::string* name, uint
   return return_value;
 }
 
+template <typename SymType>
+void Symbols::ReadAllSymbols(Memory* elf_memory) {
+  // Read many entries at a time, instead of one read per entry.
+  constexpr size_t kMaxEntries = 256;
+  std::vector<uint8_t> buffer;
+  bool symbol_added = false;
+  while (entry_size_ != 0 && cur_offset_ < end_ && cur_offset_ + entry_size_ <= end_) {
+    size_t entries = std::min<uint64_t>(kMaxEntries, (end_ - cur_offset_) / entry_size_);
+    buffer.resize(entries * entry_size_);
+    if (!elf_memory->ReadFully(cur_offset_, buffer.data(), buffer.size())) {
+      // Stop all processing, something looks like it is corrupted.
+      cur_offset_ = UINT64_MAX;
+      break;
+    }
+    cur_offset_ += buffer.size();
+
+    for (size_t i = 0; i < entries; i++) {
+      SymType entry = {};
+      memcpy(&entry, &buffer[i * entry_size_], std::min(sizeof(entry), entry_size_));
+      if (entry.st_shndx != SHN_UNDEF && ELF32_ST_TYPE(entry.st_info) == STT_FUNC) {
+        symbols_.emplace_back(entry.st_value, entry.st_value + entry.st_size,
+                              str_offset_ + entry.st_name);
+        symbol_added = true;
+      }
+    }
+  }
+
+  if (symbol_added) {
+    std::sort(symbols_.begin(), symbols_.end(),
+              [](const Info& a, const Info& b) { return a.start_offset < b.start_offset; });
+  }
+}
+
+template <typename SymType>
+void Symbols::GetNames(const uint64_t* addrs, size_t count, Memory* elf_memory,
+                       FunctionInfo* functions) {
+  ReadAllSymbols<SymType>(elf_memory);
+  if (symbols_.empty()) {
+    return;
+  }
+
+  // Both the addresses and the symbols are sorted, so the next symbol
+  // that starts after an address only ever moves forward.
+  size_t next = 0;
+  const Info* last_info = nullptr;
+  SharedString last_name;
+  for (size_t i = 0; i < count; i++) {
+    FunctionInfo* function = &functions[i];
+    if (!function->name.empty()) {
+      continue;
+    }
+    uint64_t addr = addrs[i];
+    while (next < symbols_.size() && symbols_[next].start_offset <= addr) {
+      next++;
+    }
+    const Info* info = nullptr;
+    if (next != 0 && addr < symbols_[next - 1].end_offset) {
+      info = &symbols_[next - 1];
+    } else if (next != 0) {
+      // The address could still be in an earlier symbol that overlaps.
+      info = GetInfoFromCache(addr);
+    }
+    if (info == nullptr) {
+      continue;
+    }
+
+    // Many addresses tend to be in the same function.
+    if (info != last_info) {
+      std::string name;
+      if (info->str_offset >= str_end_ ||
+          !elf_memory->ReadString(info->str_offset, &name, str_end_ - info->str_offset)) {
+        continue;
+      }
+      last_info = info;
+      last_name = std::move(name);
+    }
+    function->name = last_name;
+    function->offset = addr - info->start_offset;
+  }
+}
+
 template <typename SymType>
 bool Symbols::GetGlobal(Memory* elf_memory, const std::string& name, uint64_t* memory_address) {
   uint64_t cur_offset = offset_;
@@ -132,6 +216,9 @@ bool Symbols::GetGlobal(Memory* elf_memory, const std::string& name, uint64_t* m
 template bool Symbols::GetName<Elf32_Sym>(uint64_t, Memory*, std::string*, uint64_t*);
 template bool Symbols::GetName<Elf64_Sym>(uint64_t, Memory*, std::string*, uint64_t*);
 
+template void Symbols::GetNames<Elf32_Sym>(const uint64_t*, size_t, Memory*, FunctionInfo*);
+template void Symbols::GetNames<Elf64_Sym>(const uint64_t*, size_t, Memory*, FunctionInfo*);
+
 template bool Symbols::GetGlobal<Elf32_Sym>(Memory*, const std::string&, uint64_t*);
 template bool Symbols::GetGlobal<Elf64_Sym>(Memory*, const std::string&, uint64_t*);
 }  // namespace unwindstack
@@ -24,8 +24,9 @@
 
 namespace unwindstack {
 
-// Forward declaration.
+// Forward declarations.
 class Memory;
+struct FunctionInfo;
 
 class Symbols {
   struct Info {
@@ -46,9 +47,16 @@ class Symbols {
   template <typename SymType>
   bool GetName(uint64_t addr, Memory* elf_memory, std::string* name, uint64_t* func_offset);
 
+  // Finds the function of every sorted address that does not have one yet.
+  // The whole table is read once, and then walked in address order.
+  template <typename SymType>
+  void GetNames(const uint64_t* addrs, size_t count, Memory* elf_memory, FunctionInfo* functions);
+
   template <typename SymType>
   bool GetGlobal(Memory* elf_memory, const std::string& name, uint64_t* memory_address);
 
+  uint64_t MemoryUsage() { return sizeof(*this) + symbols_.capacity() * sizeof(Info); }
+
   void ClearCache() {
     symbols_.clear();
     cur_offset_ = offset_;
@@ -62,6 +70,9 @@ class Symbols {
   uint64_t str_offset_;
   uint64_t str_end_;
 
+  template <typename SymType>
+  void ReadAllSymbols(Memory* elf_memory);
+
   std::vector<Info> symbols_;
 };
 
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#include <unwindstack/Memory.h>
+
+#include "UnwindBudget.h"
+
+namespace unwindstack {
+
+static uint64_t NanoTime() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<uint64_t>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+}
+
+Memory* UnwindBudget::Start(Memory* stack_memory) {
+  memory_ = stack_memory;
+  deadline_ns_ = timeout_ns_ != 0 ? NanoTime() + timeout_ns_ : 0;
+  num_reads_ = 0;
+  num_checks_ = 0;
+  out_of_reads_ = false;
+  out_of_time_ = false;
+  return this;
+}
+
+bool UnwindBudget::OutOfTime() {
+  if (out_of_time_) {
+    return true;
+  }
+  if (deadline_ns_ != 0 && ++num_checks_ % kClockCheckInterval == 0 &&
+      NanoTime() >= deadline_ns_) {
+    out_of_time_ = true;
+  }
+  return out_of_time_;
+}
+
+size_t UnwindBudget::Read(uint64_t addr, void* dst, size_t size) {
+  if (max_reads_ != 0 && num_reads_ >= max_reads_) {
+    out_of_reads_ = true;
+  }
+  if (Exceeded()) {
+    return 0;
+  }
+  num_reads_++;
+  return memory_->Read(addr, dst, size);
+}
+
+}  // namespace unwindstack
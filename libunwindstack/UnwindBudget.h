@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBUNWINDSTACK_UNWIND_BUDGET_H
+#define _LIBUNWINDSTACK_UNWIND_BUDGET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unwindstack/Memory.h>
+
+namespace unwindstack {
+
+// Limits the time an unwind takes and the number of times it reads the
+// stack. The unwind reads the stack through this object, which fails
+// every read once the budget is used up, so that a step in progress
+// stops as soon as possible.
+class UnwindBudget : public Memory {
+ public:
+  // Zero means no limit.
+  UnwindBudget(uint64_t timeout_ns, uint64_t max_reads)
+      : timeout_ns_(timeout_ns), max_reads_(max_reads) {}
+  virtual ~UnwindBudget() = default;
+
+  // Start a new unwind that reads the stack from stack_memory. Returns the
+  // memory the unwind must use instead.
+  Memory* Start(Memory* stack_memory);
+
+  // Stop counting against the budget, until the next Start.
+  void Finish() { memory_ = nullptr; }
+
+  size_t Read(uint64_t addr, void* dst, size_t size) override;
+
+  // Returns true if the budget of the current unwind is used up.
+  bool Exceeded() { return out_of_reads_ || OutOfTime(); }
+
+  // Returns true if the time of the current unwind is used up. Reading
+  // the clock costs about as much as a small step, so it is only read on
+  // every kClockCheckInterval checks and stack reads.
+  bool OutOfTime();
+
+  bool active() { return memory_ != nullptr; }
+  // Returns true if the budget was found to be used up, without checking.
+  bool exceeded() { return out_of_reads_ || out_of_time_; }
+  uint64_t num_reads() { return num_reads_; }
+
+  static constexpr uint32_t kClockCheckInterval = 8;
+
+ private:
+  uint64_t timeout_ns_;
+  uint64_t max_reads_;
+
+  Memory* memory_ = nullptr;
+  uint64_t deadline_ns_ = 0;
+  uint64_t num_reads_ = 0;
+  uint32_t num_checks_ = 0;
+  bool out_of_reads_ = false;
+  bool out_of_time_ = false;
+};
+
+}  // namespace unwindstack
+
+#endif  // _LIBUNWINDSTACK_UNWIND_BUDGET_H
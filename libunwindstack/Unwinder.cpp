@@ -27,21 +27,60 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 
-#include <demangle.h>
-
+#include <unwindstack/DemangleCache.h>
 #include <unwindstack/Elf.h>
 #include <unwindstack/JitDebug.h>
+#include <unwindstack/MachineArm64.h>
 #include <unwindstack/MapInfo.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
+#include <unwindstack/RegsArm64.h>
+#include <unwindstack/Symbolizer.h>
 #include <unwindstack/Unwinder.h>
 
 #if !defined(NO_LIBDEXFILE_SUPPORT)
 #include <unwindstack/DexFiles.h>
 #endif
 
+#include "FrameCache.h"
+#include "UnwindBudget.h"
+
 namespace unwindstack {
 
+MapInfo* Unwinder::FindMap(uint64_t pc) {
+  for (MapInfo* map_info : last_maps_) {
+    if (map_info != nullptr && pc >= map_info->start && pc < map_info->end) {
+      return map_info;
+    }
+  }
+  MapInfo* map_info = maps_->Find(pc);
+  if (map_info != nullptr) {
+    last_maps_[next_last_map_] = map_info;
+    next_last_map_ ^= 1;
+  }
+  return map_info;
+}
+
+Unwinder::Unwinder(size_t max_frames, Maps* maps, Regs* regs,
+                   std::shared_ptr<Memory> process_memory)
+    : max_frames_(max_frames), maps_(maps), regs_(regs), process_memory_(process_memory) {
+  frames_.reserve(max_frames);
+  compact_frames_.reserve(max_frames);
+}
+
+Unwinder::Unwinder(size_t max_frames, Maps* maps, std::shared_ptr<Memory> process_memory)
+    : max_frames_(max_frames), maps_(maps), process_memory_(process_memory) {
+  frames_.reserve(max_frames);
+  compact_frames_.reserve(max_frames);
+}
+
+Unwinder::Unwinder(size_t max_frames) : max_frames_(max_frames) {
+  frames_.reserve(max_frames);
+  compact_frames_.reserve(max_frames);
+}
+
+Unwinder::~Unwinder() = default;
+
 // Inject extra 'virtual' frame that represents the dex pc data.
 // The dex pc is a magic register defined in the Mterp interpreter,
 // and thus it will be restored/observed in the frame after it.
@@ -49,82 +88,149 @@ namespace unwindstack {
 //   #7 pc 0015fa20 core.vdex   java.util.Arrays.binarySearch+8
 //   #8 pc 006b1ba1 libartd.so  ExecuteMterpImpl+14625
 //   #9 pc 0039a1ef libartd.so  art::interpreter::Execute+719
-void Unwinder::FillInDexFrame() {
-  size_t frame_num = frames_.size();
-  frames_.resize(frame_num + 1);
-  FrameData* frame = &frames_.at(frame_num);
-  frame->num = frame_num;
-
+void Unwinder::AddDexFrame() {
   uint64_t dex_pc = regs_->dex_pc();
-  frame->pc = dex_pc;
-  frame->sp = regs_->sp();
-
-  MapInfo* info = maps_->Find(dex_pc);
-  if (info != nullptr) {
-    frame->map_start = info->start;
-    frame->map_end = info->end;
-    frame->map_elf_start_offset = info->elf_start_offset;
-    frame->map_exact_offset = info->offset;
-    frame->map_load_bias = info->load_bias;
-    frame->map_flags = info->flags;
+  MapInfo* info = FindMap(dex_pc);
+  uint64_t rel_pc = info != nullptr ? dex_pc - info->start : dex_pc;
+  compact_frames_.push_back({dex_pc, rel_pc, regs_->sp(), info, nullptr});
+}
+
+CompactFrameData* Unwinder::AddFrame(MapInfo* map_info, Elf* elf, uint64_t rel_pc,
+                                     uint64_t pc_adjustment) {
+  compact_frames_.push_back({regs_->pc() - pc_adjustment, rel_pc - pc_adjustment, regs_->sp(),
+                             map_info, map_info != nullptr ? elf : nullptr});
+  return &compact_frames_.back();
+}
+
+void Unwinder::FillInFrame(const CompactFrameData& compact_frame, FrameData* frame) {
+  frame->pc = compact_frame.pc;
+  frame->rel_pc = compact_frame.rel_pc;
+  frame->sp = compact_frame.sp;
+
+  MapInfo* map_info = compact_frame.map_info;
+  if (map_info == nullptr) {
+    // Nothing else to update.
+    return;
+  }
+  frame->map_elf_start_offset = map_info->elf_start_offset;
+  frame->map_exact_offset = map_info->offset;
+  frame->map_start = map_info->start;
+  frame->map_end = map_info->end;
+  frame->map_flags = map_info->flags;
+
+  Elf* elf = compact_frame.elf;
+  if (elf == nullptr) {
+    // This is a dex frame.
+    frame->map_load_bias = map_info->load_bias;
     if (resolve_names_) {
-      frame->map_name = info->name;
+      frame->map_name = map_info->name;
     }
-    frame->rel_pc = dex_pc - info->start;
-  } else {
-    frame->rel_pc = dex_pc;
     return;
   }
 
-  if (!resolve_names_) {
-    return;
+  frame->map_load_bias = elf->GetLoadBias();
+  if (resolve_names_) {
+    frame->map_name = map_info->name;
+    if (embedded_soname_ && map_info->elf_start_offset != 0 && !frame->map_name.empty()) {
+      std::string soname = elf->GetSoname();
+      if (!soname.empty()) {
+        frame->map_name += '!' + soname;
+      }
+    }
   }
+}
 
+void Unwinder::FillInFrames(const std::vector<CompactFrameData>& compact_frames,
+                            std::vector<FrameData>* frames, const Symbolizer* symbolizer) {
+  frames->resize(compact_frames.size());
+  for (size_t i = 0; i < compact_frames.size(); i++) {
+    const CompactFrameData& compact_frame = compact_frames[i];
+    FrameData* frame = &(*frames)[i];
+    // The vector might hold the frames of an earlier call.
+    *frame = FrameData();
+    frame->num = i;
+    FillInFrame(compact_frame, frame);
+    if (!resolve_names_ || compact_frame.map_info == nullptr) {
+      continue;
+    }
+    if (budget_ != nullptr && budget_->active() && budget_->OutOfTime()) {
+      if (last_error_.code == ERROR_NONE) {
+        last_error_.code = ERROR_BUDGET_EXCEEDED;
+      }
+      continue;
+    }
+
+    if (symbolizer != nullptr) {
+      const FunctionInfo* function = symbolizer->Find(compact_frame);
+      if (function != nullptr) {
+        frame->function_name = function->name;
+        frame->function_offset = function->offset;
+      }
+      continue;
+    }
+
+    if (compact_frame.elf == nullptr) {
 #if !defined(NO_LIBDEXFILE_SUPPORT)
-  if (dex_files_ == nullptr) {
-    return;
+      if (dex_files_ != nullptr) {
+        dex_files_->GetMethodInformation(maps_, compact_frame.map_info, compact_frame.pc,
+                                         &frame->function_name, &frame->function_offset);
+      }
+#endif
+      continue;
+    }
+    if (!compact_frame.elf->GetFunctionName(Symbolizer::GetFunctionPc(compact_frame),
+                                            &frame->function_name, &frame->function_offset)) {
+      frame->function_name = "";
+      frame->function_offset = 0;
+    }
   }
+}
 
-  dex_files_->GetMethodInformation(maps_, info, dex_pc, &frame->function_name,
-                                   &frame->function_offset);
+void Unwinder::AddFunctions(const std::vector<CompactFrameData>& compact_frames,
+                            Symbolizer* symbolizer) {
+#if !defined(NO_LIBDEXFILE_SUPPORT)
+  if (dex_files_ != nullptr) {
+    symbolizer->SetDexFiles(dex_files_, maps_);
+  }
 #endif
+  for (const auto& compact_frame : compact_frames) {
+    symbolizer->Add(compact_frame);
+  }
 }
 
-FrameData* Unwinder::FillInFrame(MapInfo* map_info, Elf* elf, uint64_t rel_pc,
-                                 uint64_t pc_adjustment) {
-  size_t frame_num = frames_.size();
-  frames_.resize(frame_num + 1);
-  FrameData* frame = &frames_.at(frame_num);
-  frame->num = frame_num;
-  frame->sp = regs_->sp();
-  frame->rel_pc = rel_pc - pc_adjustment;
-  frame->pc = regs_->pc() - pc_adjustment;
-
-  if (map_info == nullptr) {
-    // Nothing else to update.
-    return nullptr;
+void Unwinder::Symbolize(const std::vector<CompactFrameData>& compact_frames,
+                         std::vector<FrameData>* frames, Symbolizer* symbolizer) {
+  Symbolizer local_symbolizer;
+  if (symbolizer == nullptr) {
+    symbolizer = &local_symbolizer;
+  }
+  if (resolve_names_) {
+    AddFunctions(compact_frames, symbolizer);
+    symbolizer->Resolve();
   }
+  FillInFrames(compact_frames, frames, symbolizer);
+}
 
+void Unwinder::Symbolize(const std::vector<std::vector<CompactFrameData>>& stacks,
+                         std::vector<std::vector<FrameData>>* frames, Symbolizer* symbolizer) {
+  Symbolizer local_symbolizer;
+  if (symbolizer == nullptr) {
+    symbolizer = &local_symbolizer;
+  }
   if (resolve_names_) {
-    frame->map_name = map_info->name;
-    if (embedded_soname_ && map_info->elf_start_offset != 0 && !frame->map_name.empty()) {
-      std::string soname = elf->GetSoname();
-      if (!soname.empty()) {
-        frame->map_name += '!' + soname;
-      }
+    for (const auto& compact_frames : stacks) {
+      AddFunctions(compact_frames, symbolizer);
     }
+    symbolizer->Resolve();
+  }
+  frames->resize(stacks.size());
+  for (size_t i = 0; i < stacks.size(); i++) {
+    FillInFrames(stacks[i], &(*frames)[i], symbolizer);
   }
-  frame->map_elf_start_offset = map_info->elf_start_offset;
-  frame->map_exact_offset = map_info->offset;
-  frame->map_start = map_info->start;
-  frame->map_end = map_info->end;
-  frame->map_flags = map_info->flags;
-  frame->map_load_bias = elf->GetLoadBias();
-  return frame;
 }
 
 static bool ShouldStop(const std::vector<std::string>* map_suffixes_to_ignore,
-                       std::string& map_name) {
+                       const std::string& map_name) {
   if (map_suffixes_to_ignore == nullptr) {
     return false;
   }
@@ -137,26 +243,99 @@ static bool ShouldStop(const std::vector<std::string>* map_suffixes_to_ignore,
                    map_name.substr(pos + 1)) != map_suffixes_to_ignore->end();
 }
 
+static bool IsElfFromMemoryNotFile(MapInfo* map_info) {
+  return map_info != nullptr && map_info->memory_backed_elf && !map_info->name.empty() &&
+         map_info->name[0] != '[' && !android::base::StartsWith(map_info->name, "/memfd:");
+}
+
+bool Unwinder::ShouldRemoveSpeculativeFrame() {
+  // Only remove the speculative frame if there are more than two frames
+  // or the pc in the first frame is in a valid map.
+  // This allows for a case where the code jumps into the middle of
+  // nowhere, but there is no other unwind information after that.
+  return compact_frames_.size() > 2 ||
+         (compact_frames_.size() > 0 && FindMap(compact_frames_[0].pc) != nullptr);
+}
+
 void Unwinder::Unwind(const std::vector<std::string>* initial_map_names_to_skip,
                       const std::vector<std::string>* map_suffixes_to_ignore) {
   frames_.clear();
+  compact_frames_.clear();
   last_error_.code = ERROR_NONE;
   last_error_.address = 0;
   elf_from_memory_not_file_ = false;
+  if (!maps_unchanged_) {
+    // The maps might have changed since the last unwind.
+    last_maps_[0] = nullptr;
+    last_maps_[1] = nullptr;
+  }
 
   ArchEnum arch = regs_->Arch();
+  Memory* stack_memory = stack_memory_ != nullptr ? stack_memory_ : process_memory_.get();
+  if (budget_ != nullptr) {
+    // The frame cache checks its entries through the budget too.
+    stack_memory = budget_->Start(stack_memory);
+  }
+  // The frames found depend on the map suffixes to ignore, so do not
+  // use the cache when they are given.
+  FrameCache* frame_cache = map_suffixes_to_ignore == nullptr ? frame_cache_.get() : nullptr;
+  if (frame_cache != nullptr) {
+    stack_memory = frame_cache->StartUnwind(stack_memory);
+  }
 
   bool return_address_attempt = false;
   bool adjust_pc = false;
-  for (; frames_.size() < max_frames_;) {
+  // True when the last frame was unwound normally, so the pc is in a
+  // function that made a call and has set up its frame.
+  bool in_caller_frame = false;
+  // True when the last frame was unwound with the frame pointer on an
+  // architecture where that does not recover the exact sp. Only the frame
+  // pointer chain can be followed from such a frame, since the unwind
+  // information, the signal frame and the return address register all
+  // need the real registers.
+  bool sp_is_lower_bound = false;
+  // The registers and number of frames before the first such frame pointer
+  // step. If the chain cannot be followed to its end, the unwind goes back
+  // to them and continues without the frame pointer.
+  std::unique_ptr<Regs> exact_regs;
+  size_t exact_num_frames = 0;
+  bool exact_elf_from_memory_not_file = false;
+  bool use_frame_pointer = true;
+  bool speculative_end = false;
+  CompactFrameData speculative_frame;
+  bool speculative_frame_removed = false;
+  for (; compact_frames_.size() < max_frames_;) {
     uint64_t cur_pc = regs_->pc();
     uint64_t cur_sp = regs_->sp();
 
-    MapInfo* map_info = maps_->Find(regs_->pc());
+    if (budget_ != nullptr && budget_->Exceeded()) {
+      break;
+    }
+
+    if (frame_cache != nullptr && in_caller_frame && !compact_frames_.empty()) {
+      size_t num_frames = compact_frames_.size();
+      if (frame_cache->Find(regs_, max_frames_, &compact_frames_, &last_error_, &speculative_end)) {
+        for (size_t i = num_frames; i < compact_frames_.size(); i++) {
+          // Dex frames do not have an elf, and were not checked.
+          const CompactFrameData& frame = compact_frames_[i];
+          if (frame.elf != nullptr && IsElfFromMemoryNotFile(frame.map_info)) {
+            elf_from_memory_not_file_ = true;
+          }
+        }
+        if (speculative_end && ShouldRemoveSpeculativeFrame()) {
+          speculative_frame = compact_frames_.back();
+          speculative_frame_removed = true;
+          compact_frames_.pop_back();
+        }
+        break;
+      }
+    }
+
+    MapInfo* map_info = FindMap(regs_->pc());
     uint64_t pc_adjustment = 0;
     uint64_t step_pc;
     uint64_t rel_pc;
-    Elf* elf;
+    Elf* elf = nullptr;
     if (map_info == nullptr) {
       step_pc = regs_->pc();
       rel_pc = step_pc;
@@ -168,8 +347,7 @@ void Unwinder::Unwind(const std::vector<std::string>* initial_map_names_to_skip,
       elf = map_info->GetElf(process_memory_, arch);
       // If this elf is memory backed, and there is a valid file, then set
       // an indicator that we couldn't open the file.
-      if (!elf_from_memory_not_file_ && map_info->memory_backed_elf && !map_info->name.empty() &&
-          map_info->name[0] != '[' && !android::base::StartsWith(map_info->name, "/memfd:")) {
+      if (!elf_from_memory_not_file_ && IsElfFromMemoryNotFile(map_info)) {
         elf_from_memory_not_file_ = true;
       }
       step_pc = regs_->pc();
@@ -198,24 +376,24 @@ void Unwinder::Unwind(const std::vector<std::string>* initial_map_names_to_skip,
       }
     }
 
-    FrameData* frame = nullptr;
+    CompactFrameData* frame = nullptr;
     if (map_info == nullptr || initial_map_names_to_skip == nullptr ||
         std::find(initial_map_names_to_skip->begin(), initial_map_names_to_skip->end(),
                   basename(map_info->name.c_str())) == initial_map_names_to_skip->end()) {
       if (regs_->dex_pc() != 0) {
         // Add a frame to represent the dex file.
-        FillInDexFrame();
+        AddDexFrame();
         // Clear the dex pc so that we don't repeat this frame later.
         regs_->set_dex_pc(0);
 
         // Make sure there is enough room for the real frame.
-        if (frames_.size() == max_frames_) {
+        if (compact_frames_.size() == max_frames_) {
           last_error_.code = ERROR_MAX_FRAMES_EXCEEDED;
           break;
         }
       }
 
-      frame = FillInFrame(map_info, elf, rel_pc, pc_adjustment);
+      frame = AddFrame(map_info, elf, rel_pc, pc_adjustment);
 
       // Once a frame is added, stop skipping frames.
       initial_map_names_to_skip = nullptr;
@@ -223,6 +401,8 @@ void Unwinder::Unwind(const std::vector<std::string>* initial_map_names_to_skip,
     adjust_pc = true;
 
     bool stepped = false;
+    bool stepped_from_frame_pointer = false;
+    bool in_signal_handler = false;
     bool in_device_map = false;
     bool finished = false;
     if (map_info != nullptr) {
@@ -232,51 +412,85 @@ void Unwinder::Unwind(const std::vector<std::string>* initial_map_names_to_skip,
         // some of the speculative frames.
         in_device_map = true;
       } else {
-        MapInfo* sp_info = maps_->Find(regs_->sp());
+        MapInfo* sp_info = FindMap(regs_->sp());
         if (sp_info != nullptr && sp_info->flags & MAPS_FLAGS_DEVICE_MAP) {
           // Do not stop here, fall through in case we are
           // in the speculative unwind path and need to remove
           // some of the speculative frames.
           in_device_map = true;
         } else {
-          if (elf->StepIfSignalHandler(rel_pc, regs_, process_memory_.get())) {
+          if (sp_is_lower_bound) {
+            if (map_info->flags & MAPS_FLAGS_FRAME_POINTER) {
+              stepped = regs_->StepFromFramePointer(stack_memory);
+              // A zero frame pointer marks the end of the chain.
+              finished = !stepped && (*reinterpret_cast<RegsArm64*>(regs_))[ARM64_REG_R29] == 0;
+            }
+            last_error_.code = ERROR_NONE;
+            last_error_.address = 0;
+          } else if (elf->StepIfSignalHandler(rel_pc, regs_, stack_memory)) {
             stepped = true;
+            in_signal_handler = true;
             if (frame != nullptr) {
               // Need to adjust the relative pc because the signal handler
               // pc should not be adjusted.
               frame->rel_pc = rel_pc;
               frame->pc += pc_adjustment;
-              step_pc = rel_pc;
             }
-          } else if (elf->Step(step_pc, regs_, process_memory_.get(), &finished)) {
-            stepped = true;
+            elf->GetLastError(&last_error_);
+          } else {
+            if (in_caller_frame && use_frame_pointer &&
+                (map_info->flags & MAPS_FLAGS_FRAME_POINTER)) {
+              // On arm64, the frame record is not always at the top of the
+              // frame, so the sp is only a lower bound after this step.
+              if (arch == ARCH_ARM64) {
+                exact_regs.reset(regs_->Clone());
+                exact_num_frames = compact_frames_.size() - (frame != nullptr ? 1 : 0);
+                exact_elf_from_memory_not_file = elf_from_memory_not_file_;
+              }
+              stepped = regs_->StepFromFramePointer(stack_memory);
+            }
+            if (stepped) {
+              stepped_from_frame_pointer = arch == ARCH_ARM64;
+              last_error_.code = ERROR_NONE;
+              last_error_.address = 0;
+            } else {
+              // Also used when the frame pointer chain looks invalid.
+              stepped = elf->Step(step_pc, regs_, stack_memory, &finished);
+              elf->GetLastError(&last_error_);
+            }
           }
-          elf->GetLastError(&last_error_);
         }
       }
     }
-
-    if (frame != nullptr) {
-      if (!resolve_names_ ||
-          !elf->GetFunctionName(step_pc, &frame->function_name, &frame->function_offset)) {
-        frame->function_name = "";
-        frame->function_offset = 0;
-      }
-    }
+    // The function interrupted by a signal might not have set up its frame.
+    in_caller_frame = stepped && !in_signal_handler;
 
     if (finished) {
       break;
     }
 
+    if (sp_is_lower_bound && !stepped) {
+      // The chain is broken, or reached code without frame pointers.
+      // Unwind the frames found from the frame pointer again using the
+      // unwind information, which needs the exact sp.
+      compact_frames_.resize(exact_num_frames);
+      elf_from_memory_not_file_ = exact_elf_from_memory_not_file;
+      memcpy(regs_->RawData(), exact_regs->RawData(), regs_->total_regs() * sizeof(uint64_t));
+      regs_->set_dex_pc(exact_regs->dex_pc());
+      sp_is_lower_bound = false;
+      use_frame_pointer = false;
+      in_caller_frame = true;
+      continue;
+    }
+    sp_is_lower_bound = sp_is_lower_bound || stepped_from_frame_pointer;
+
     if (!stepped) {
       if (return_address_attempt) {
-        // Only remove the speculative frame if there are more than two frames
-        // or the pc in the first frame is in a valid map.
-        // This allows for a case where the code jumps into the middle of
-        // nowhere, but there is no other unwind information after that.
-        if (frames_.size() > 2 || (frames_.size() > 0 && maps_->Find(frames_[0].pc) != nullptr)) {
-          // Remove the speculative frame.
-          frames_.pop_back();
+        speculative_end = true;
+        if (ShouldRemoveSpeculativeFrame()) {
+          speculative_frame = compact_frames_.back();
+          speculative_frame_removed = true;
+          compact_frames_.pop_back();
         }
         break;
       } else if (in_device_map) {
@@ -285,14 +499,14 @@ void Unwinder::Unwind(const std::vector<std::string>* initial_map_names_to_skip,
         break;
       } else {
         // Steping didn't work, try this secondary method.
-        if (!regs_->SetPcFromReturnAddress(process_memory_.get())) {
+        if (!regs_->SetPcFromReturnAddress(stack_memory)) {
           break;
         }
         return_address_attempt = true;
       }
     } else {
       return_address_attempt = false;
-      if (max_frames_ == frames_.size()) {
+      if (max_frames_ == compact_frames_.size()) {
         last_error_.code = ERROR_MAX_FRAMES_EXCEEDED;
       }
     }
@@ -303,6 +517,53 @@ void Unwinder::Unwind(const std::vector<std::string>* initial_map_names_to_skip,
       break;
     }
   }
+
+  if (budget_ != nullptr && budget_->exceeded()) {
+    // The step that failed might have failed only because its reads did.
+    last_error_.code = ERROR_BUDGET_EXCEEDED;
+    last_error_.address = 0;
+  }
+
+  if (frame_cache != nullptr) {
+    frame_cache->FinishUnwind(compact_frames_, last_error_, speculative_end,
+                              speculative_frame_removed ? &speculative_frame : nullptr);
+  }
+
+  if (stack_hash_only_) {
+    stack_hash_ = GetStackHash(compact_frames_);
+  } else if (!compact_frames_only_) {
+    FillInFrames(compact_frames_, &frames_, nullptr);
+  }
+
+  if (budget_ != nullptr) {
+    budget_->Finish();
+  }
+}
+
+static inline uint64_t CombineHash(uint64_t hash, uint64_t value) {
+  return hash ^ (value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2));
+}
+
+uint64_t Unwinder::GetStackHash(const std::vector<CompactFrameData>& compact_frames) {
+  uint64_t hash = compact_frames.size();
+  for (const CompactFrameData& frame : compact_frames) {
+    if (frame.map_info == nullptr) {
+      // Without a map, the absolute pc is all there is.
+      hash = CombineHash(hash, frame.pc);
+      hash = CombineHash(hash, 0);
+    } else {
+      hash = CombineHash(hash, frame.rel_pc);
+      hash = CombineHash(hash, frame.map_info->GetBuildIDToken());
+    }
+  }
+
+  // Mix the bits, so that any part of the hash can be used to bucket it.
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
 }
 
 std::string Unwinder::FormatFrame(const FrameData& frame) {
@@ -327,7 +588,7 @@ std::string Unwinder::FormatFrame(const FrameData& frame) {
   }
 
   if (!frame.function_name.empty()) {
-    data += " (" + demangle(frame.function_name.c_str());
+    data += " (" + DemangleCache::Demangle(frame.function_name);
     if (frame.function_offset != 0) {
       data += android::base::StringPrintf("+%" PRId64, frame.function_offset);
     }
@@ -351,6 +612,28 @@ std::string Unwinder::FormatFrame(size_t frame_num) {
   return FormatFrame(frames_[frame_num]);
 }
 
+void Unwinder::SetFrameCache(size_t max_entries) {
+  if (max_entries == 0) {
+    frame_cache_.reset();
+  } else {
+    frame_cache_.reset(new FrameCache(max_entries));
+  }
+}
+
+void Unwinder::ClearFrameCache() {
+  if (frame_cache_ != nullptr) {
+    frame_cache_->Clear();
+  }
+}
+
+void Unwinder::SetBudget(uint64_t timeout_ns, uint64_t max_memory_reads) {
+  if (timeout_ns == 0 && max_memory_reads == 0) {
+    budget_.reset();
+  } else {
+    budget_.reset(new UnwindBudget(timeout_ns, max_memory_reads));
+  }
+}
+
 void Unwinder::SetJitDebug(JitDebug* jit_debug, ArchEnum arch) {
   jit_debug->SetArch(arch);
   jit_debug_ = jit_debug;
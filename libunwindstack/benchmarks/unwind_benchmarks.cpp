@@ -14,15 +14,24 @@
  * limitations under the License.
  */
 
+#include <malloc.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <benchmark/benchmark.h>
 
+#include <android-base/file.h>
 #include <android-base/strings.h>
 
+#include <unwindstack/BatchUnwinder.h>
+#include <unwindstack/CallTree.h>
 #include <unwindstack/Elf.h>
+#include <unwindstack/LocalUnwinder.h>
+#include <unwindstack/MapInfo.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
 #include <unwindstack/Regs.h>
@@ -83,6 +92,175 @@ static void BM_cached_unwind(benchmark::State& state) {
 }
 BENCHMARK(BM_cached_unwind);
 
+// The benchmark itself is built with frame pointers, so the frames in
+// its own maps can be unwound by following them.
+static void BM_frame_pointer_unwind(benchmark::State& state) {
+  auto process_memory = unwindstack::Memory::CreateProcessMemoryCached(getpid());
+  unwindstack::LocalMaps maps;
+  if (!maps.Parse()) {
+    state.SkipWithError("Failed to parse local maps.");
+  }
+  std::string exe = android::base::GetExecutablePath();
+  for (const auto& map_info : maps) {
+    if (map_info->name == exe) {
+      map_info->flags |= unwindstack::MAPS_FLAGS_FRAME_POINTER;
+    }
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Call1(process_memory, &maps));
+  }
+}
+BENCHMARK(BM_frame_pointer_unwind);
+
+// All threads share one LocalUnwinder, so this measures how well
+// concurrent unwinds scale.
+static void BM_local_unwind_threads(benchmark::State& state) {
+  static unwindstack::LocalUnwinder* unwinder = []() {
+    auto unwinder = new unwindstack::LocalUnwinder();
+    if (!unwinder->Init()) {
+      delete unwinder;
+      return static_cast<unwindstack::LocalUnwinder*>(nullptr);
+    }
+    return unwinder;
+  }();
+  if (unwinder == nullptr) {
+    state.SkipWithError("Failed to init local unwinder.");
+    return;
+  }
+
+  std::vector<unwindstack::LocalFrameData> frame_info;
+  for (auto _ : state) {
+    frame_info.clear();
+    benchmark::DoNotOptimize(unwinder->Unwind(&frame_info, 32));
+  }
+}
+BENCHMARK(BM_local_unwind_threads)->ThreadRange(1, 32)->UseRealTime();
+
+// A sample of this thread, taken the way a profiler takes one: the
+// registers and a copy of the stack.
+struct LocalSample {
+  std::unique_ptr<unwindstack::Regs> regs;
+  std::vector<uint8_t> stack;
+};
+
+static constexpr size_t kSampleStackSize = 16 * 1024;
+
+static void __attribute__((noinline)) TakeSample(std::vector<LocalSample>* samples, size_t depth) {
+  if (depth > 1) {
+    TakeSample(samples, depth - 1);
+  }
+  LocalSample sample;
+  sample.regs.reset(unwindstack::Regs::CreateFromLocal());
+  unwindstack::RegsGetLocal(sample.regs.get());
+  sample.stack.resize(kSampleStackSize);
+  unwindstack::MemoryLocal memory;
+  sample.stack.resize(memory.Read(sample.regs->sp(), sample.stack.data(), sample.stack.size()));
+  samples->emplace_back(std::move(sample));
+}
+
+// Measures the throughput of unwinding a batch of samples with the given
+// number of threads, recording full frames (0), compact frames (1) or only
+// the stack hash (2).
+static void BM_batch_unwind(benchmark::State& state) {
+  unwindstack::LocalMaps maps;
+  if (!maps.Parse()) {
+    state.SkipWithError("Failed to parse local maps.");
+    return;
+  }
+
+  std::vector<LocalSample> local_samples;
+  for (size_t i = 0; i < 32; i++) {
+    TakeSample(&local_samples, i % 8 + 1);
+  }
+
+  size_t num_threads = state.range(0);
+  unwindstack::BatchUnwinder unwinder(64, &maps, unwindstack::Memory::CreateProcessMemory(getpid()),
+                                      num_threads);
+  unwinder.SetCompactFrames(state.range(1) == 1);
+  unwinder.SetStackHashOnly(state.range(1) == 2);
+  std::vector<unwindstack::UnwindSample> samples(local_samples.size());
+  std::vector<std::unique_ptr<unwindstack::Regs>> regs(local_samples.size());
+  for (auto _ : state) {
+    // Every unwind modifies the registers, so start from a fresh copy.
+    state.PauseTiming();
+    for (size_t i = 0; i < samples.size(); i++) {
+      regs[i].reset(local_samples[i].regs->Clone());
+      samples[i].regs = regs[i].get();
+      samples[i].stack = local_samples[i].stack.data();
+      samples[i].stack_start = local_samples[i].regs->sp();
+      samples[i].stack_size = local_samples[i].stack.size();
+    }
+    state.ResumeTiming();
+
+    unwinder.UnwindBatch(samples.data(), samples.size());
+  }
+  state.counters["unwinds_per_second_per_core"] =
+      benchmark::Counter(static_cast<double>(state.iterations() * samples.size()) / num_threads,
+                         benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_batch_unwind)
+    ->Args({1, 0})
+    ->Args({1, 1})
+    ->Args({1, 2})
+    ->Args({2, 0})
+    ->Args({2, 1})
+    ->Args({2, 2})
+    ->Args({4, 0})
+    ->Args({4, 1})
+    ->Args({4, 2})
+    ->Args({8, 0})
+    ->Args({8, 1})
+    ->Args({8, 2})
+    ->UseRealTime();
+
+// Measures how fast stacks can be added to a call tree shared by all of
+// the threads.
+struct CallTreeData {
+  unwindstack::LocalMaps maps;
+  std::vector<std::vector<unwindstack::CompactFrameData>> stacks;
+  unwindstack::CallTree tree;
+};
+
+static void BM_call_tree_add(benchmark::State& state) {
+  static CallTreeData* data = []() {
+    CallTreeData* data = new CallTreeData;
+    if (!data->maps.Parse()) {
+      return data;
+    }
+
+    std::vector<LocalSample> local_samples;
+    for (size_t i = 0; i < 32; i++) {
+      TakeSample(&local_samples, i % 8 + 1);
+    }
+    unwindstack::BatchUnwinder unwinder(64, &data->maps,
+                                        unwindstack::Memory::CreateProcessMemory(getpid()));
+    unwinder.SetCompactFrames(true);
+    std::vector<unwindstack::UnwindSample> samples(local_samples.size());
+    for (size_t i = 0; i < samples.size(); i++) {
+      samples[i].regs = local_samples[i].regs.get();
+      samples[i].stack = local_samples[i].stack.data();
+      samples[i].stack_start = local_samples[i].regs->sp();
+      samples[i].stack_size = local_samples[i].stack.size();
+    }
+    unwinder.UnwindBatch(samples.data(), samples.size());
+    for (auto& sample : samples) {
+      data->stacks.emplace_back(std::move(sample.compact_frames));
+    }
+    return data;
+  }();
+  if (data->stacks.empty()) {
+    state.SkipWithError("Failed to unwind the samples.");
+    return;
+  }
+
+  size_t i = 0;
+  for (auto _ : state) {
+    data->tree.Add(data->stacks[i++ % data->stacks.size()]);
+  }
+}
+BENCHMARK(BM_call_tree_add)->ThreadRange(1, 8)->UseRealTime();
+
 static void Initialize(benchmark::State& state, unwindstack::Maps& maps,
                        unwindstack::MapInfo** build_id_map_info) {
   if (!maps.Parse()) {
@@ -142,4 +320,32 @@ static void BM_get_build_id_from_file(benchmark::State& state) {
 }
 BENCHMARK(BM_get_build_id_from_file);
 
+// Measures the memory retained by a Maps object for a captured maps file.
+// If no file is given through UNWIND_BENCHMARK_MAPS_FILE, the maps of this
+// process are used.
+static void BM_maps_memory(benchmark::State& state) {
+  const char* file = getenv("UNWIND_BENCHMARK_MAPS_FILE");
+  std::string content;
+  if (!android::base::ReadFileToString(file != nullptr ? file : "/proc/self/maps", &content)) {
+    state.SkipWithError("Failed to read the maps file.");
+    return;
+  }
+
+  size_t total_maps = 0;
+  size_t total_bytes = 0;
+  for (auto _ : state) {
+    size_t start_bytes = mallinfo().uordblks;
+    unwindstack::BufferMaps maps(content.c_str());
+    if (!maps.Parse()) {
+      state.SkipWithError("Failed to parse the maps file.");
+      return;
+    }
+    total_bytes = mallinfo().uordblks - start_bytes;
+    total_maps = maps.Total();
+  }
+  state.counters["total_maps"] = total_maps;
+  state.counters["bytes_per_map"] = total_maps == 0 ? 0 : total_bytes / total_maps;
+}
+BENCHMARK(BM_maps_memory);
+
 BENCHMARK_MAIN();
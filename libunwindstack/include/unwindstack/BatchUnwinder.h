@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBUNWINDSTACK_BATCH_UNWINDER_H
+#define _LIBUNWINDSTACK_BATCH_UNWINDER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <unwindstack/Error.h>
+#include <unwindstack/Maps.h>
+#include <unwindstack/Memory.h>
+#include <unwindstack/Regs.h>
+#include <unwindstack/Unwinder.h>
+
+namespace unwindstack {
+
+// A sample taken by a profiler: the registers, and a copy of the stack
+// that starts at stack_start.
+struct UnwindSample {
+  // The registers are modified by the unwind.
+  Regs* regs = nullptr;
+  const uint8_t* stack = nullptr;
+  uint64_t stack_start = 0;
+  size_t stack_size = 0;
+
+  // Set by UnwindBatch. Only compact_frames is set if compact frames are
+  // enabled, only stack_hash and num_frames are set if stack hashes are
+  // enabled, otherwise only frames is set. The vectors are reused, so
+  // unwinding the same sample objects in every batch avoids allocating
+  // new frame buffers.
+  std::vector<FrameData> frames;
+  std::vector<CompactFrameData> compact_frames;
+  uint64_t stack_hash = 0;
+  size_t num_frames = 0;
+  ErrorCode error_code = ERROR_NONE;
+};
+
+// Unwinds many samples taken from one process. All of the samples share
+// the maps, and through them the Elf objects and their cached unwind
+// information. Memory not in a sample's stack copy is read from
+// process_memory, which can be nullptr if all elf files are available.
+// The maps must not change while a batch is unwound.
+class BatchUnwinder {
+ public:
+  BatchUnwinder(size_t max_frames, Maps* maps, std::shared_ptr<Memory> process_memory,
+                size_t num_threads = 1);
+  ~BatchUnwinder();
+
+  // The samples are unwound in order of their pc, spread across all of
+  // the threads, rather than in the order given.
+  void UnwindBatch(UnwindSample* samples, size_t num_samples);
+
+  void SetResolveNames(bool resolve);
+
+  // Record only compact frames, to be symbolized later with
+  // Unwinder::Symbolize.
+  void SetCompactFrames(bool compact_frames);
+
+  // Compute only the stack hash of every sample, see
+  // Unwinder::SetStackHashOnly.
+  void SetStackHashOnly(bool stack_hash_only);
+
+  // Every thread keeps its own cache, see Unwinder::SetFrameCache. The
+  // caches must be cleared whenever the maps change.
+  void SetFrameCache(size_t max_entries);
+  void ClearFrameCache();
+
+  // Limit every unwind in a batch, see Unwinder::SetBudget. A sample that
+  // runs out of its budget has the error ERROR_BUDGET_EXCEEDED.
+  void SetBudget(uint64_t timeout_ns, uint64_t max_memory_reads);
+
+  // Unwind a single sample on the calling thread and set its frames, with
+  // names, whatever mode the batches are unwound in. This recovers the
+  // frames behind a stack hash, so the sample must be kept with a copy of
+  // the registers it had before UnwindBatch modified them.
+  void UnwindFrames(UnwindSample* sample);
+
+ private:
+  class Worker;
+
+  void RunWorker(Worker* worker, UnwindSample* samples);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  // The pc and index of every sample in the current batch, sorted by pc.
+  std::vector<std::pair<uint64_t, size_t>> order_;
+  std::atomic_size_t next_sample_ = 0;
+};
+
+}  // namespace unwindstack
+
+#endif  // _LIBUNWINDSTACK_BATCH_UNWINDER_H
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBUNWINDSTACK_CALL_TREE_H
+#define _LIBUNWINDSTACK_CALL_TREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unwindstack/Unwinder.h>
+
+namespace unwindstack {
+
+// Forward declarations.
+struct MapInfo;
+
+// Aggregates many stacks into a tree of (map, relative pc) nodes with a
+// sample count, the way a profiler does. Any number of threads can add
+// stacks at the same time: every thread adds to one of several shards,
+// and the shards are only merged when the tree is read.
+// The tree keeps pointers to the MapInfo objects of the frames, so the
+// maps must outlive it.
+class CallTree {
+ public:
+  // A node of the merged tree. The nodes are ordered so that a parent
+  // always comes before its children, and node 0 is the root, which
+  // has no frame.
+  struct Node {
+    size_t parent = 0;
+    // nullptr if the pc is not in any map, in which case rel_pc is the pc.
+    MapInfo* map_info = nullptr;
+    uint64_t rel_pc = 0;
+    // The number of stacks that ended in this node.
+    uint64_t count = 0;
+  };
+
+  explicit CallTree(size_t num_shards = 8);
+  ~CallTree();
+
+  // Add a stack, with the innermost frame first as the Unwinder records
+  // it. Unwinder::compact_frames() can be passed in directly after any
+  // unwind, whatever mode the unwinder is in.
+  void Add(const std::vector<CompactFrameData>& frames, uint64_t count = 1) {
+    Add(frames.data(), frames.size(), count);
+  }
+  void Add(const CompactFrameData* frames, size_t num_frames, uint64_t count = 1);
+
+  // Returns the merged tree.
+  std::vector<Node> GetNodes();
+
+  uint64_t TotalCount();
+
+  // Returns the merged tree in a compact binary form. All numbers are
+  // ULEB128 encoded:
+  //   "UWCT" version
+  //   num_maps, then for every map:
+  //     name_length name elf_start_offset build_id_length build_id
+  //   num_nodes - 1, then for every node but the root, in order:
+  //     parent map_index rel_pc count
+  // A map_index of zero means no map, otherwise it is one more than the
+  // index in the map table.
+  std::string Serialize();
+
+  // Returns the merged tree in collapsed stack form: a line for every
+  // node with a non-zero count, with the frames from the outermost to
+  // the innermost separated by ';', followed by a space and the count.
+  // Frames are written as the map name and relative pc, since the tree
+  // does not keep names.
+  std::string FormatCollapsed();
+
+  void Clear();
+
+  static constexpr uint32_t kSerializeVersion = 1;
+
+ private:
+  struct Shard;
+
+  Shard* GetShard();
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+}  // namespace unwindstack
+
+#endif  // _LIBUNWINDSTACK_CALL_TREE_H
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _LIBUNWINDSTACK_DEMANGLE_CACHE_H
+#define _LIBUNWINDSTACK_DEMANGLE_CACHE_H
+
+#include <stddef.h>
+
+#include <string>
+
+namespace unwindstack {
+
+// Cache of demangled function names, shared by every thread and every
+// Unwinder in the process. Crash and ANR reports format the same hot
+// frames over and over, and demangling a long templated name costs far
+// more than looking it up.
+class DemangleCache {
+ public:
+  static constexpr size_t kDefaultMaxEntries = 4096;
+
+  // Returns the demangled name. Names that are not mangled are returned
+  // unchanged without being cached.
+  static std::string Demangle(const std::string& name);
+
+  // Demangle name in place. Names that are not mangled are left alone,
+  // without making a copy.
+  static void Demangle(std::string* name);
+
+  // Keep at most max_entries names, evicting the least recently used
+  // names first. Zero disables the cache.
+  static void SetMaxEntries(size_t max_entries);
+
+  static size_t Total();
+
+  static void Clear();
+};
+
+}  // namespace unwindstack
+
+#endif  // _LIBUNWINDSTACK_DEMANGLE_CACHE_H
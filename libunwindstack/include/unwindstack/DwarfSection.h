@@ -106,6 +106,9 @@ class DwarfSection {
 
   bool Step(uint64_t pc, Regs* regs, Memory* process_memory, bool* finished);
 
+  // Estimate of the heap used by the cached cie, fde and location data.
+  virtual uint64_t MemoryUsage();
+
  protected:
   DwarfMemory memory_;
   DwarfErrorData last_error_{DWARF_ERROR_NONE, 0};
@@ -181,6 +184,8 @@ class DwarfSectionImplNoHdr : public DwarfSectionImpl<AddressType> {
 
   void GetFdes(std::vector<const DwarfFde*>* fdes) override;
 
+  uint64_t MemoryUsage() override;
+
  protected:
   bool GetNextCieOrFde(DwarfFde** fde_entry);
 
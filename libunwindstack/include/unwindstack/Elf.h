@@ -24,6 +24,7 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <unwindstack/ElfInterface.h>
 #include <unwindstack/Memory.h>
@@ -35,6 +36,7 @@
 namespace unwindstack {
 
 // Forward declaration.
+struct ElfCache;
 struct MapInfo;
 class Regs;
 
@@ -48,6 +50,30 @@ enum ArchEnum : uint8_t {
   ARCH_MIPS64,
 };
 
+// Identifies the file data used to create an elf object in the global
+// cache. Using the file identity rather than the name means that links
+// to the same file share an elf, and that a file replaced by an update
+// does not reuse the stale elf.
+struct ElfCacheKey {
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t offset;
+
+  bool operator==(const ElfCacheKey& key) const {
+    return dev == key.dev && ino == key.ino && offset == key.offset;
+  }
+};
+
+// Describes one entry in the global elf cache.
+struct ElfCacheEntryInfo {
+  ElfCacheKey key;
+  std::string name;
+  // The estimated memory used by the elf. When several entries share the
+  // same elf, only one of them reports the size, so that the sizes of all
+  // entries add up to the size of the cache.
+  uint64_t size;
+};
+
 class Elf {
  public:
   Elf(Memory* memory) : memory_(memory) {}
@@ -63,8 +89,19 @@ class Elf {
 
   bool GetFunctionName(uint64_t addr, std::string* name, uint64_t* func_offset);
 
+  // Finds the functions of many addresses while holding the lock once, and
+  // reads each symbol table only once. The addresses must be sorted. Any
+  // address that already has a function name is skipped.
+  void GetFunctionNames(const uint64_t* addrs, size_t count, FunctionInfo* functions);
+
   bool GetGlobalVariable(const std::string& name, uint64_t* memory_address);
 
+  // Estimate of the memory used by this object. This includes the heap
+  // used by the cached unwind and symbol data, and the decompressed
+  // .gnu_debugdata, but not the file data mapped into memory since
+  // the kernel can reclaim those pages.
+  uint64_t MemoryUsage();
+
   uint64_t GetRelPc(uint64_t pc, const MapInfo* map_info);
 
   bool StepIfSignalHandler(uint64_t rel_pc, Regs* regs, Memory* process_memory);
@@ -105,14 +142,22 @@ class Elf {
 
   static std::string GetBuildID(Memory* memory);
 
-  static void SetCachingEnabled(bool enable);
+  // When max_size is not zero, the least recently used elf objects are
+  // removed from the cache whenever adding a new elf makes the estimated
+  // memory used by the cache exceed max_size. The most recently used elf
+  // is always kept. An elf removed from the cache remains valid for as
+  // long as a map still refers to it.
+  static void SetCachingEnabled(bool enable, uint64_t max_size = 0);
   static bool CachingEnabled() { return cache_enabled_; }
 
-  static void CacheLock();
-  static void CacheUnlock();
-  static void CacheAdd(MapInfo* info);
-  static bool CacheGet(MapInfo* info);
-  static bool CacheAfterCreateMemory(MapInfo* info);
+  // Returns the estimated memory used by all of the elf objects in the cache.
+  static uint64_t CacheSize();
+  static void CacheGetEntries(std::vector<ElfCacheEntryInfo>* entries);
+
+  static bool CacheGetKey(MapInfo* info, ElfCacheKey* key);
+  static void CacheAdd(const ElfCacheKey& key, MapInfo* info);
+  static bool CacheGet(const ElfCacheKey& key, MapInfo* info);
+  static bool CacheAfterCreateMemory(const ElfCacheKey& key, MapInfo* info);
 
  protected:
   bool valid_ = false;
@@ -125,12 +170,11 @@ class Elf {
   // Protect calls that can modify internal state of the interface object.
   std::mutex lock_;
 
-  std::unique_ptr<Memory> gnu_debugdata_memory_;
+  std::shared_ptr<Memory> gnu_debugdata_memory_;
   std::unique_ptr<ElfInterface> gnu_debugdata_interface_;
 
   static bool cache_enabled_;
-  static std::unordered_map<std::string, std::pair<std::shared_ptr<Elf>, bool>>* cache_;
-  static std::mutex* cache_lock_;
+  static ElfCache* cache_;
 };
 
 }  // namespace unwindstack
@@ -27,14 +27,24 @@
 
 #include <unwindstack/DwarfSection.h>
 #include <unwindstack/Error.h>
+#include <unwindstack/SFrameSection.h>
+#include <unwindstack/SharedString.h>
 
 namespace unwindstack {
 
 // Forward declarations.
 class Memory;
+class MemoryBuffer;
 class Regs;
 class Symbols;
 
+// The function containing an address. The name is empty if no function
+// was found. All of the addresses in one function share its name.
+struct FunctionInfo {
+  SharedString name;
+  uint64_t offset = 0;
+};
+
 struct LoadInfo {
   uint64_t offset;
   uint64_t table_offset;
@@ -60,6 +70,10 @@ class ElfInterface {
 
   virtual bool GetFunctionName(uint64_t addr, std::string* name, uint64_t* offset) = 0;
 
+  // Looks up the function of every address that has not been found yet.
+  // The addresses must be sorted.
+  virtual void GetFunctionNames(const uint64_t* addrs, size_t count, FunctionInfo* functions);
+
   virtual bool GetGlobalVariable(const std::string& name, uint64_t* memory_address) = 0;
 
   virtual std::string GetBuildID() = 0;
@@ -68,7 +82,11 @@ class ElfInterface {
 
   virtual bool IsValidPc(uint64_t pc);
 
-  Memory* CreateGnuDebugdataMemory();
+  // Estimate of the heap used by this object, including the data cached
+  // while unwinding and looking up symbols.
+  virtual uint64_t MemoryUsage();
+
+  MemoryBuffer* CreateGnuDebugdataMemory();
 
   Memory* memory() { return memory_; }
 
@@ -85,6 +103,8 @@ class ElfInterface {
   uint64_t eh_frame_size() { return eh_frame_size_; }
   uint64_t debug_frame_offset() { return debug_frame_offset_; }
   uint64_t debug_frame_size() { return debug_frame_size_; }
+  uint64_t sframe_offset() { return sframe_offset_; }
+  uint64_t sframe_size() { return sframe_size_; }
   uint64_t gnu_debugdata_offset() { return gnu_debugdata_offset_; }
   uint64_t gnu_debugdata_size() { return gnu_debugdata_size_; }
   uint64_t gnu_build_id_offset() { return gnu_build_id_offset_; }
@@ -92,6 +112,7 @@ class ElfInterface {
 
   DwarfSection* eh_frame() { return eh_frame_.get(); }
   DwarfSection* debug_frame() { return debug_frame_.get(); }
+  SFrameSection* sframe() { return sframe_.get(); }
 
   const ErrorData& last_error() { return last_error_; }
   ErrorCode LastErrorCode() { return last_error_.code; }
@@ -122,6 +143,9 @@ class ElfInterface {
   template <typename SymType>
   bool GetFunctionNameWithTemplate(uint64_t addr, std::string* name, uint64_t* func_offset);
 
+  template <typename SymType>
+  void GetFunctionNamesWithTemplate(const uint64_t* addrs, size_t count, FunctionInfo* functions);
+
   template <typename SymType>
   bool GetGlobalVariableWithTemplate(const std::string& name, uint64_t* memory_address);
 
@@ -150,6 +174,9 @@ class ElfInterface {
   uint64_t debug_frame_offset_ = 0;
   uint64_t debug_frame_size_ = 0;
 
+  uint64_t sframe_offset_ = 0;
+  uint64_t sframe_size_ = 0;
+
   uint64_t gnu_debugdata_offset_ = 0;
   uint64_t gnu_debugdata_size_ = 0;
 
@@ -163,6 +190,7 @@ class ElfInterface {
 
   std::unique_ptr<DwarfSection> eh_frame_;
   std::unique_ptr<DwarfSection> debug_frame_;
+  std::unique_ptr<SFrameSection> sframe_;
   // The Elf object owns the gnu_debugdata interface object.
   ElfInterface* gnu_debugdata_interface_ = nullptr;
 
@@ -189,6 +217,10 @@ class ElfInterface32 : public ElfInterface {
     return ElfInterface::GetFunctionNameWithTemplate<Elf32_Sym>(addr, name, func_offset);
   }
 
+  void GetFunctionNames(const uint64_t* addrs, size_t count, FunctionInfo* functions) override {
+    ElfInterface::GetFunctionNamesWithTemplate<Elf32_Sym>(addrs, count, functions);
+  }
+
   bool GetGlobalVariable(const std::string& name, uint64_t* memory_address) override {
     return ElfInterface::GetGlobalVariableWithTemplate<Elf32_Sym>(name, memory_address);
   }
@@ -219,6 +251,10 @@ class ElfInterface64 : public ElfInterface {
     return ElfInterface::GetFunctionNameWithTemplate<Elf64_Sym>(addr, name, func_offset);
   }
 
+  void GetFunctionNames(const uint64_t* addrs, size_t count, FunctionInfo* functions) override {
+    ElfInterface::GetFunctionNamesWithTemplate<Elf64_Sym>(addrs, count, functions);
+  }
+
   bool GetGlobalVariable(const std::string& name, uint64_t* memory_address) override {
     return ElfInterface::GetGlobalVariableWithTemplate<Elf64_Sym>(name, memory_address);
   }
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBUNWINDSTACK_GNU_DEBUGDATA_CACHE_H
+#define _LIBUNWINDSTACK_GNU_DEBUGDATA_CACHE_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace unwindstack {
+
+// Forward declarations.
+class Memory;
+class MemoryBuffer;
+
+// Cache of decompressed .gnu_debugdata sections, keyed by the build id of
+// the elf file containing the compressed data. The decompressed data only
+// depends on the contents of the file, so every Elf object that refers to
+// the same file can share a single copy.
+//
+// The data can also be stored in a directory so that it is shared across
+// processes. Entries in the directory are mapped read-only, so all of the
+// processes using the directory share the same pages.
+class GnuDebugdataCache {
+ public:
+  static constexpr size_t kDefaultMaxSize = 64 * 1024 * 1024;
+  static constexpr uint64_t kDefaultMaxDiskSize = 256 * 1024 * 1024;
+
+  // Enabling the cache allows up to max_size bytes of decompressed data
+  // to be kept. The least recently used entries are evicted once this
+  // limit is exceeded. Disabling the cache frees all of the entries, but
+  // any Elf object using the data keeps its own reference. This can be
+  // called while other threads use the cache.
+  static void SetEnabled(bool enable, size_t max_size = kDefaultMaxSize);
+  static bool Enabled() { return enabled_; }
+
+  // Store decompressed data in dir, keeping at most max_size bytes of
+  // files in the directory. An empty dir disables the disk store.
+  // The cache must be enabled for this to have any effect.
+  static void SetDiskCache(const std::string& dir, uint64_t max_size = kDefaultMaxDiskSize);
+
+  // Returns nullptr if the data for this build id is not in the cache.
+  static std::shared_ptr<Memory> Get(const std::string& build_id);
+
+  // Add the decompressed data to the cache. Returns the memory object that
+  // should be used from now on, which is not the one passed in if another
+  // thread already added data for the same build id.
+  static std::shared_ptr<Memory> Add(const std::string& build_id,
+                                     const std::shared_ptr<MemoryBuffer>& memory);
+
+  // Returns the number of entries and the number of bytes in memory.
+  static size_t Total();
+  static size_t Size();
+
+ private:
+  static std::atomic_bool enabled_;
+};
+
+}  // namespace unwindstack
+
+#endif  // _LIBUNWINDSTACK_GNU_DEBUGDATA_CACHE_H
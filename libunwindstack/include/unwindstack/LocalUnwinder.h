@@ -17,7 +17,6 @@
 #ifndef _LIBUNWINDSTACK_LOCAL_UNWINDER_H
 #define _LIBUNWINDSTACK_LOCAL_UNWINDER_H
 
-#include <pthread.h>
 #include <stdint.h>
 #include <sys/types.h>
 
@@ -28,27 +27,35 @@
 #include <unwindstack/Error.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
+#include <unwindstack/SharedString.h>
 
 namespace unwindstack {
 
 // Forward declarations.
 class Elf;
 struct MapInfo;
+class Regs;
+struct CompactFrameData;
 
 struct LocalFrameData {
   LocalFrameData(MapInfo* map_info, uint64_t pc, uint64_t rel_pc, const std::string& function_name,
-                 uint64_t function_offset)
-      : map_info(map_info),
-        pc(pc),
-        rel_pc(rel_pc),
-        function_name(function_name),
-        function_offset(function_offset) {}
+                 uint64_t function_offset);
 
+  // The map may be freed once the maps are reparsed, which another
+  // thread's Unwind can do as soon as this Unwind returns. Use the map
+  // fields below, which are copied from it, instead.
   MapInfo* map_info;
   uint64_t pc;
   uint64_t rel_pc;
   std::string function_name;
   uint64_t function_offset;
+
+  // Maps with the same name share the string data.
+  SharedString map_name;
+  uint64_t map_start = 0;
+  uint64_t map_end = 0;
+  uint64_t map_offset = 0;
+  uint16_t map_flags = 0;
 };
 
 // This is a specialized class that should only be used for doing local unwinds.
@@ -64,8 +71,30 @@ class LocalUnwinder {
 
   bool Init();
 
+  // Init for use with UnwindFramePointers, which also creates the elf
+  // objects of all of the executable maps.
+  bool InitSignalSafe();
+
   bool Unwind(std::vector<LocalFrameData>* frame_info, size_t max_frames);
 
+  // A frame pointer only sampler of the calling thread. It does not
+  // allocate memory or wait for a lock, so that it can be called from a
+  // signal handler. Up to max_frames frames are written to frames, and
+  // the number written is returned. regs must come from
+  // Regs::CreateFromLocal, made outside of the signal handler, and be
+  // used by only one thread at a time.
+  //
+  // Only the frame records that the frame pointers point to and signal
+  // frames are used to step. The unwind information is never read, since
+  // its caches allocate. The unwind stops at the first function built
+  // without a frame pointer, and the caller of a function interrupted
+  // before it set up its frame is missing. The unwind also stops at a pc
+  // in a map not found yet, since reparsing the maps allocates, and at a
+  // pc in a map with no elf object yet. No function names are looked up.
+  // The map_info and elf of each frame may be freed once an Unwind call
+  // reparses the maps, so look up any names before that can happen.
+  size_t UnwindFramePointers(Regs* regs, CompactFrameData* frames, size_t max_frames);
+
   bool ShouldSkipLibrary(const std::string& map_name);
 
   MapInfo* GetMapInfo(uint64_t pc);
@@ -74,7 +103,6 @@ class LocalUnwinder {
   uint64_t LastErrorAddress() { return last_error_.address; }
 
  private:
-  pthread_rwlock_t maps_rwlock_;
   std::unique_ptr<LocalUpdatableMaps> maps_ = nullptr;
   std::shared_ptr<Memory> process_memory_;
   std::vector<std::string> skip_libraries_;
@@ -26,38 +26,35 @@
 
 #include <unwindstack/Elf.h>
 #include <unwindstack/Memory.h>
+#include <unwindstack/SharedString.h>
 
 namespace unwindstack {
 
 struct MapInfo {
   MapInfo(MapInfo* map_info, uint64_t start, uint64_t end, uint64_t offset, uint64_t flags,
-          const char* name)
+          SharedString name)
       : start(start),
         end(end),
         offset(offset),
         flags(flags),
-        name(name),
+        name(std::move(name)),
         prev_map(map_info),
         load_bias(static_cast<uint64_t>(-1)),
         build_id(0) {}
+  MapInfo(MapInfo* map_info, uint64_t start, uint64_t end, uint64_t offset, uint64_t flags,
+          const char* name)
+      : MapInfo(map_info, start, end, offset, flags, SharedString(name)) {}
   MapInfo(MapInfo* map_info, uint64_t start, uint64_t end, uint64_t offset, uint64_t flags,
           const std::string& name)
-      : start(start),
-        end(end),
-        offset(offset),
-        flags(flags),
-        name(name),
-        prev_map(map_info),
-        load_bias(static_cast<uint64_t>(-1)),
-        build_id(0) {}
+      : MapInfo(map_info, start, end, offset, flags, SharedString(name)) {}
   ~MapInfo();
 
   uint64_t start = 0;
   uint64_t end = 0;
   uint64_t offset = 0;
   uint16_t flags = 0;
-  std::string name;
-  std::shared_ptr<Elf> elf;
+  // Set to true if the elf file data is coming from memory.
+  bool memory_backed_elf = false;
   // This value is only non-zero if the offset is non-zero but there is
   // no elf signature found at that offset.
   uint64_t elf_offset = 0;
@@ -65,8 +62,17 @@ struct MapInfo {
   // of the elf. This is not equal to offset when the linker splits
   // shared libraries into a read-only and read-execute map.
   uint64_t elf_start_offset = 0;
+  // Maps with the same name share the string data. This converts to a
+  // const std::string&, but cannot be modified in place.
+  SharedString name;
+  std::shared_ptr<Elf> elf;
 
-  MapInfo* prev_map = nullptr;
+  // The map before this one. An updatable Maps object relinks the maps it
+  // keeps while other threads read them, so this is stored with release
+  // order, and readers load it once with acquire order and use that value.
+  // A map that is no longer found is only freed once no reader can be
+  // using it, so the map loaded is valid for as long as this one is.
+  std::atomic<MapInfo*> prev_map = nullptr;
 
   std::atomic_uint64_t load_bias;
 
@@ -75,12 +81,14 @@ struct MapInfo {
   // make it easier to move to a fine grained lock in the future.
   std::atomic_uintptr_t build_id;
 
-  // Set to true if the elf file data is coming from memory.
-  bool memory_backed_elf = false;
-
   // This function guarantees it will never return nullptr.
   Elf* GetElf(const std::shared_ptr<Memory>& process_memory, ArchEnum expected_arch);
 
+  // Returns the elf object if GetElf has created it, or nullptr if it has
+  // not, or if another thread is still creating it. This only loads
+  // atomic values, so it can be called from a signal handler.
+  Elf* GetElfIfCreated();
+
   uint64_t GetLoadBias(const std::shared_ptr<Memory>& process_memory);
 
   Memory* CreateMemory(const std::shared_ptr<Memory>& process_memory);
@@ -93,15 +101,39 @@ struct MapInfo {
   // Returns the printable version of the build id (hex dump of raw data).
   std::string GetPrintableBuildID();
 
+  // Returns a non-zero 64 bit hash of the build id, cached after the first
+  // call. Maps without a build id hash the name and elf start offset instead.
+  uint64_t GetBuildIDToken();
+
  private:
   MapInfo(const MapInfo&) = delete;
   void operator=(const MapInfo&) = delete;
 
   Memory* GetFileMemory();
+  // Make the elf object visible to GetElfIfCreated. Called with the
+  // mutex held, and returns the elf object.
+  Elf* PublishElf();
   bool InitFileMemoryFromPreviousReadOnlyMap(MemoryFileAtOffset* memory);
 
-  // Protect the creation of the elf object.
-  std::mutex mutex_;
+  // The fields that are only needed once the elf object or the build id
+  // are requested. Most maps never need them, so they are allocated on
+  // first use.
+  struct ElfFields {
+    // Protect the creation of the elf object.
+    std::mutex mutex_;
+
+    // The elf object, stored once it is created, for readers that cannot
+    // take the mutex.
+    std::atomic<Elf*> elf_ = nullptr;
+
+    std::atomic_uint64_t build_id_token_ = 0;
+  };
+
+  ElfFields& GetElfFields();
+
+  std::mutex& mutex() { return GetElfFields().mutex_; }
+
+  std::atomic<ElfFields*> elf_fields_ = nullptr;
 };
 
 }  // namespace unwindstack
@@ -20,8 +20,12 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <unwindstack/MapInfo.h>
@@ -35,6 +39,14 @@ static constexpr int MAPS_FLAGS_DEVICE_MAP = 0x8000;
 // created by ART for use with the gdb jit debug interface.
 // This should only ever appear in offline maps data.
 static constexpr int MAPS_FLAGS_JIT_SYMFILE_MAP = 0x4000;
+// Special flag, set by the user of the maps, to indicate that all of the
+// code in this map keeps a frame pointer chain. The Unwinder follows the
+// chain through these maps instead of using the unwind information.
+static constexpr int MAPS_FLAGS_FRAME_POINTER = 0x2000;
+// The flags set by the user of the maps. They are not part of the maps
+// data, so they are ignored when checking if a map changed, and are kept
+// when a map is replaced by a new map of the same file at the same start.
+static constexpr int MAPS_FLAGS_USER_FLAGS = MAPS_FLAGS_FRAME_POINTER;
 
 class Maps {
  public:
@@ -60,6 +72,15 @@ class Maps {
 
   void Sort();
 
+  // Update the maps from an mmap or munmap event, such as a
+  // PERF_RECORD_MMAP2 record, without rereading the maps file. Any part
+  // of an existing map that overlaps the new range is removed. The maps
+  // that survive keep their MapInfo objects and any Elf data already
+  // created. These must not be called while another thread uses the maps.
+  void ApplyMmap(uint64_t start, uint64_t end, uint64_t pgoff, uint64_t prot,
+                 const std::string& name);
+  void ApplyMunmap(uint64_t start, uint64_t end);
+
   typedef std::vector<std::unique_ptr<MapInfo>>::iterator iterator;
   iterator begin() { return maps_.begin(); }
   iterator end() { return maps_.end(); }
@@ -76,7 +97,33 @@ class Maps {
   }
 
  protected:
+  // Rebuild the ranges used by Find. This must be called whenever the
+  // contents or order of maps_ changes, since Find only searches the
+  // ranges, and aborts if they do not match maps_.
+  virtual void UpdateRanges();
+
+  // Set the prev_map values on the info objects. This is safe while other
+  // threads read the prev_map values, see MapInfo::prev_map.
+  void LinkMaps();
+
+  // Remove the range from all maps, splitting any map that only partially
+  // overlaps it. Returns the index where a map at start would be inserted.
+  size_t RemoveRange(uint64_t start, uint64_t end);
+
+  // Called with every map that is removed by an update. By default, the
+  // map is freed immediately.
+  virtual void RetireMap(std::unique_ptr<MapInfo>) {}
+
+  // Called at the start of every update.
+  virtual void ReleaseRetiredMaps() {}
+
+  // Any change to this must be followed by UpdateRanges.
   std::vector<std::unique_ptr<MapInfo>> maps_;
+
+  // The start and end of every map, in the same order as maps_. These are
+  // kept separately so that a search does not touch every MapInfo object.
+  std::vector<uint64_t> map_starts_;
+  std::vector<uint64_t> map_ends_;
 };
 
 class RemoteMaps : public Maps {
@@ -96,17 +143,85 @@ class LocalMaps : public RemoteMaps {
   virtual ~LocalMaps() = default;
 };
 
-class LocalUpdatableMaps : public Maps {
+// Maps that can be reread, for example between the sampling rounds of a
+// profiler. Every MapInfo object whose map did not change is kept, along
+// with its Elf object, build id and load bias.
+class RemoteUpdatableMaps : public RemoteMaps {
  public:
-  LocalUpdatableMaps() : Maps() {}
-  virtual ~LocalUpdatableMaps() = default;
+  RemoteUpdatableMaps(pid_t pid) : RemoteMaps(pid) {}
+  virtual ~RemoteUpdatableMaps() = default;
+
+  virtual bool Reparse();
+
+ protected:
+  void RetireMap(std::unique_ptr<MapInfo> map_info) override {
+    retired_maps_.emplace_back(std::move(map_info));
+  }
 
-  bool Reparse();
+  // The maps retired by the previous update are freed, so a MapInfo
+  // pointer remains valid until the second update after it stopped being
+  // found.
+  void ReleaseRetiredMaps() override { retired_maps_.clear(); }
+
+  std::vector<std::unique_ptr<MapInfo>> retired_maps_;
+};
+
+class LocalUpdatableMaps : public RemoteUpdatableMaps {
+ public:
+  LocalUpdatableMaps() : RemoteUpdatableMaps(getpid()) {}
+  virtual ~LocalUpdatableMaps() = default;
 
   const std::string GetMapsFile() const override;
 
- private:
-  std::vector<std::unique_ptr<MapInfo>> saved_maps_;
+  // Reparse can be called while other threads use FindShared.
+  bool Reparse() override;
+
+  // Any thread that uses MapInfo objects while another thread might call
+  // Reparse must surround that use with these calls. A retired map is only
+  // freed once every reader that could have found it has called EndRead.
+  uint64_t BeginRead();
+  void EndRead(uint64_t epoch);
+
+  // Find the map containing pc in the latest snapshot of the maps. This
+  // does not take any lock, so many threads can search at once while
+  // another thread reparses. It must be called between BeginRead and
+  // EndRead. Find must not be used while another thread reparses, since
+  // the ranges it searches are rewritten in place; every snapshot has
+  // ranges of its own that are never modified once published.
+  MapInfo* FindShared(uint64_t pc);
+
+  // Reparse the maps and search them again. Only one thread reparses at a
+  // time, and if another thread already added the map containing pc, the
+  // maps are not reparsed again.
+  MapInfo* ReparseAndFind(uint64_t pc);
+
+ protected:
+  // An immutable copy of the ranges and maps searched by FindShared. A
+  // new snapshot is published whenever the maps change, and the old one
+  // is retired along with the maps removed by that change.
+  struct Snapshot {
+    std::vector<uint64_t> starts;
+    std::vector<uint64_t> ends;
+    std::vector<MapInfo*> maps;
+  };
+
+  void UpdateRanges() override;
+  void ReleaseRetiredMaps() override;
+
+  // Serializes every Reparse.
+  std::mutex reparse_mutex_;
+
+  std::atomic<const Snapshot*> snapshot_ = nullptr;
+  std::unique_ptr<Snapshot> current_snapshot_;
+  std::vector<std::unique_ptr<Snapshot>> retired_snapshots_;
+  std::deque<std::pair<uint64_t, std::unique_ptr<Snapshot>>> pending_snapshots_;
+
+  std::atomic_uint64_t epoch_ = 0;
+  // The number of active readers, indexed by the parity of their epoch.
+  std::atomic_size_t readers_[2] = {};
+  // Retired maps waiting to be freed, along with the epoch they were
+  // retired in, in increasing epoch order.
+  std::deque<std::pair<uint64_t, std::unique_ptr<MapInfo>>> pending_maps_;
 };
 
 class BufferMaps : public Maps {
@@ -193,6 +193,24 @@ class MemoryOfflineBuffer : public Memory {
   uint64_t end_;
 };
 
+// Reads from a copy of one range of the memory, such as the stack copied
+// when a sample was taken, and from the underlying memory everywhere else.
+class MemorySnapshot : public Memory {
+ public:
+  MemorySnapshot(const std::shared_ptr<Memory>& memory) : memory_(memory) {}
+  virtual ~MemorySnapshot() = default;
+
+  void Reset(const uint8_t* data, uint64_t start, uint64_t end);
+
+  size_t Read(uint64_t addr, void* dst, size_t size) override;
+
+ private:
+  std::shared_ptr<Memory> memory_;
+  const uint8_t* data_ = nullptr;
+  uint64_t start_ = 0;
+  uint64_t end_ = 0;
+};
+
 class MemoryOfflineParts : public Memory {
  public:
   MemoryOfflineParts() = default;
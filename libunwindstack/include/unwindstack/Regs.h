@@ -70,6 +70,13 @@ class Regs {
 
   virtual bool SetPcFromReturnAddress(Memory* process_memory) = 0;
 
+  // Step to the caller using the frame record the frame pointer points
+  // to, rather than the unwind information. Only valid if the function
+  // has set up its frame, and was built to keep the frame pointer.
+  // Returns false if the architecture has no standard frame record, or
+  // the frame record does not look valid.
+  virtual bool StepFromFramePointer(Memory* process_memory) = 0;
+
   virtual void IterateRegisters(std::function<void(const char*, uint64_t)>) = 0;
 
   uint16_t total_regs() { return total_regs_; }
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBUNWINDSTACK_SFRAME_SECTION_H
+#define _LIBUNWINDSTACK_SFRAME_SECTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <unordered_map>
+
+#include <unwindstack/Error.h>
+
+namespace unwindstack {
+
+// Forward declarations.
+class Memory;
+class Regs;
+
+// The .sframe section is a simpler alternative to the eh_frame. Every
+// function has one FDE, and the FDEs are sorted by pc so the FDE of a pc
+// can be found with a binary search. Every FDE has a list of FREs, and
+// an FRE only gives the offsets of the CFA, the return address and the
+// frame pointer. No expressions or register rules need to be evaluated.
+//
+// Versions 1 and 2 of the format are supported, for the amd64 and little
+// endian aarch64 abis, which are the only ones the format defines.
+class SFrameSection {
+ public:
+  struct Fde {
+    uint64_t pc_start = 0;
+    uint64_t pc_end = 0;
+    // The offset of the first FRE in the memory.
+    uint64_t fres_offset = 0;
+    uint32_t num_fres = 0;
+    uint8_t info = 0;
+    // The size of the repeated block of code for a pc mask FDE.
+    uint8_t rep_size = 0;
+  };
+
+  struct Fre {
+    // The pcs that the FRE applies to. For a pc mask FDE, this is the
+    // range in the repeated block that contains the pc it was found for.
+    uint64_t pc_start = 0;
+    uint64_t pc_end = 0;
+    uint8_t info = 0;
+    uint8_t num_offsets = 0;
+    int32_t offsets[3] = {};
+  };
+
+  SFrameSection(Memory* memory) : memory_(memory) {}
+  virtual ~SFrameSection() = default;
+
+  bool Init(uint64_t offset, uint64_t size, uint64_t load_bias);
+
+  bool Step(uint64_t pc, Regs* regs, Memory* process_memory, bool* finished);
+
+  bool GetFdeFromPc(uint64_t pc, Fde* fde);
+
+  bool GetFreFromPc(const Fde& fde, uint64_t pc, Fre* fre);
+
+  uint64_t MemoryUsage();
+
+  uint8_t version() { return version_; }
+  uint8_t abi_arch() { return abi_arch_; }
+  uint32_t num_fdes() { return num_fdes_; }
+
+  const ErrorData& last_error() { return last_error_; }
+  ErrorCode LastErrorCode() { return last_error_.code; }
+  uint64_t LastErrorAddress() { return last_error_.address; }
+
+ protected:
+  const Fde* GetFdeFromIndex(size_t index);
+
+  Memory* memory_;
+  uint64_t load_bias_ = 0;
+
+  uint8_t version_ = 0;
+  uint8_t flags_ = 0;
+  uint8_t abi_arch_ = 0;
+  // The offsets of the frame pointer and the return address from the
+  // CFA when they are the same in every frame, or zero if they are not.
+  int8_t fixed_fp_offset_ = 0;
+  int8_t fixed_ra_offset_ = 0;
+
+  uint64_t section_offset_ = 0;
+  uint32_t num_fdes_ = 0;
+  size_t fde_size_ = 0;
+  uint64_t fdes_offset_ = 0;
+  uint64_t fres_offset_ = 0;
+  uint64_t fres_end_ = 0;
+
+  ErrorData last_error_{ERROR_NONE, 0};
+
+  std::unordered_map<size_t, Fde> fdes_;
+  std::map<uint64_t, Fre> fres_;  // Indexed by pc_end.
+};
+
+}  // namespace unwindstack
+
+#endif  // _LIBUNWINDSTACK_SFRAME_SECTION_H
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBUNWINDSTACK_SHARED_STRING_H
+#define _LIBUNWINDSTACK_SHARED_STRING_H
+
+#include <stddef.h>
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace unwindstack {
+
+// An immutable string that can be cheaply copied. All copies share the
+// same data, which is how many maps with the same name share one copy
+// of that name.
+class SharedString {
+ public:
+  SharedString() = default;
+  SharedString(std::string&& s) : data_(std::make_shared<const std::string>(std::move(s))) {}
+  SharedString(const std::string& s) : SharedString(std::string(s)) {}
+  SharedString(const char* s) : SharedString(std::string(s)) {}
+
+  const std::string& str() const {
+    static const std::string* empty = new std::string();
+    return data_ == nullptr ? *empty : *data_;
+  }
+
+  // Unlike str(), this never allocates, even for an empty name.
+  std::string_view view() const {
+    return data_ == nullptr ? std::string_view() : std::string_view(*data_);
+  }
+
+  operator const std::string&() const { return str(); }
+  operator std::string_view() const { return view(); }
+
+  bool empty() const { return data_ == nullptr || data_->empty(); }
+  size_t size() const { return str().size(); }
+  size_t length() const { return str().length(); }
+  const char* c_str() const { return str().c_str(); }
+  char operator[](size_t index) const { return str()[index]; }
+
+  bool operator==(const SharedString& other) const {
+    return data_ == other.data_ || str() == other.str();
+  }
+  bool operator==(const std::string& other) const { return str() == other; }
+  bool operator==(const char* other) const { return str() == other; }
+  bool operator!=(const SharedString& other) const { return !(*this == other); }
+  bool operator!=(const std::string& other) const { return str() != other; }
+  bool operator!=(const char* other) const { return str() != other; }
+
+ private:
+  std::shared_ptr<const std::string> data_;
+};
+
+static inline bool operator==(const std::string& a, const SharedString& b) {
+  return b == a;
+}
+
+static inline bool operator==(const char* a, const SharedString& b) {
+  return b == a;
+}
+
+static inline bool operator!=(const std::string& a, const SharedString& b) {
+  return b != a;
+}
+
+static inline bool operator!=(const char* a, const SharedString& b) {
+  return b != a;
+}
+
+static inline std::string operator+(const std::string& a, const SharedString& b) {
+  return a + b.str();
+}
+
+static inline std::string operator+(const char* a, const SharedString& b) {
+  return a + b.str();
+}
+
+static inline std::ostream& operator<<(std::ostream& os, const SharedString& s) {
+  return os << s.str();
+}
+
+}  // namespace unwindstack
+
+#endif  // _LIBUNWINDSTACK_SHARED_STRING_H
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _LIBUNWINDSTACK_SYMBOLIZER_H
+#define _LIBUNWINDSTACK_SYMBOLIZER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <unwindstack/ElfInterface.h>
+#include <unwindstack/Unwinder.h>
+
+namespace unwindstack {
+
+// Forward declarations.
+class DexFiles;
+class Elf;
+class Maps;
+class MapInfo;
+
+// Finds the functions of many addresses at once, such as all of the frames
+// of many unwinds. The addresses are grouped by Elf object and sorted, so
+// that each Elf lock is taken once and each symbol table is walked once in
+// address order. Every address is only looked up once, and the results are
+// kept until Clear is called, so they also serve as a memo for later
+// batches.
+class Symbolizer {
+ public:
+  Symbolizer() = default;
+  ~Symbolizer() = default;
+
+  // Queues the function of the frame to be looked up, including functions
+  // in jit elf objects and, if dex files are set, dex methods.
+  void Add(const CompactFrameData& frame);
+
+  // Queues the function at addr to be looked up, where addr is the value
+  // that Elf::GetFunctionName would be passed.
+  void Add(Elf* elf, uint64_t addr);
+
+  // Looks up all of the queued functions. If more than one thread is set,
+  // different Elf objects are handled on different threads.
+  void Resolve();
+
+  // Returns nullptr if the function was never added. If the function is
+  // not known, or has not been resolved yet, the name is empty.
+  const FunctionInfo* Find(const CompactFrameData& frame) const;
+  const FunctionInfo* Find(Elf* elf, uint64_t addr) const;
+
+  void SetNumThreads(size_t num_threads) { num_threads_ = num_threads; }
+
+#if !defined(NO_LIBDEXFILE_SUPPORT)
+  void SetDexFiles(DexFiles* dex_files, Maps* maps) {
+    dex_files_ = dex_files;
+    maps_ = maps;
+  }
+#endif
+
+  // Drops every resolved function. This must be called before any of the
+  // Elf objects or maps used so far are freed.
+  void Clear();
+
+  size_t NumFunctions() const;
+
+  // Returns the address used to find the function of a frame. Elf data in
+  // gdb jit debug maps, and elf objects from the jit debug information,
+  // use the absolute pc. Everyone else uses the relative pc.
+  static uint64_t GetFunctionPc(const CompactFrameData& frame);
+
+ private:
+  struct ElfFunctions {
+    // The addresses added since the last Resolve.
+    std::vector<uint64_t> pending;
+    std::unordered_map<uint64_t, FunctionInfo> functions;
+  };
+
+  static void ResolveElf(Elf* elf, ElfFunctions* elf_functions);
+  void ResolveDex();
+  void RunWorker();
+
+  size_t num_threads_ = 1;
+  std::unordered_map<Elf*, ElfFunctions> elfs_;
+  // The entries of elfs_ in the order they were first added, so that the
+  // order of the lookups does not depend on the hash of the pointers.
+  std::vector<std::pair<Elf*, ElfFunctions*>> elf_order_;
+  // Consecutive addresses tend to be in the same Elf object.
+  Elf* last_elf_ = nullptr;
+  ElfFunctions* last_elf_functions_ = nullptr;
+  // The Elf objects with pending functions, shared by all threads.
+  std::vector<std::pair<Elf*, ElfFunctions*>> work_;
+  std::atomic_size_t next_work_ = 0;
+
+  // Dex methods, by dex pc.
+  std::vector<std::pair<uint64_t, MapInfo*>> pending_dex_;
+  std::unordered_map<uint64_t, FunctionInfo> dex_functions_;
+#if !defined(NO_LIBDEXFILE_SUPPORT)
+  DexFiles* dex_files_ = nullptr;
+  Maps* maps_ = nullptr;
+#endif
+};
+
+}  // namespace unwindstack
+
+#endif  // _LIBUNWINDSTACK_SYMBOLIZER_H
@@ -35,6 +35,9 @@ namespace unwindstack {
 
 // Forward declarations.
 class Elf;
+class FrameCache;
+class Symbolizer;
+class UnwindBudget;
 enum ArchEnum : uint8_t;
 
 struct FrameData {
@@ -61,18 +64,27 @@ struct FrameData {
   int map_flags = 0;
 };
 
+// A frame without any names, which is all that Unwind records when
+// SetCompactFrames(true) is set. Unwinder::Symbolize turns these into
+// FrameData objects later.
+struct CompactFrameData {
+  uint64_t pc;
+  uint64_t rel_pc;
+  uint64_t sp;
+
+  // nullptr if the pc is not in any map.
+  MapInfo* map_info;
+  // nullptr if the pc is not in any map, or for a dex frame.
+  Elf* elf;
+};
+
 class Unwinder {
  public:
-  Unwinder(size_t max_frames, Maps* maps, Regs* regs, std::shared_ptr<Memory> process_memory)
-      : max_frames_(max_frames), maps_(maps), regs_(regs), process_memory_(process_memory) {
-    frames_.reserve(max_frames);
-  }
-  Unwinder(size_t max_frames, Maps* maps, std::shared_ptr<Memory> process_memory)
-      : max_frames_(max_frames), maps_(maps), process_memory_(process_memory) {
-    frames_.reserve(max_frames);
-  }
-
-  virtual ~Unwinder() = default;
+  // The constructors and the destructor are out of line, since the
+  // FrameCache and UnwindBudget owned by the unwinder are not complete here.
+  Unwinder(size_t max_frames, Maps* maps, Regs* regs, std::shared_ptr<Memory> process_memory);
+  Unwinder(size_t max_frames, Maps* maps, std::shared_ptr<Memory> process_memory);
+  virtual ~Unwinder();
 
   void Unwind(const std::vector<std::string>* initial_map_names_to_skip = nullptr,
               const std::vector<std::string>* map_suffixes_to_ignore = nullptr);
@@ -87,6 +99,69 @@ class Unwinder {
     return frames;
   }
 
+  // Exchange the frames with the contents of frames. Unlike ConsumeFrames,
+  // the next unwind reuses the buffer passed in, so a caller that always
+  // swaps in the same vector does not allocate a new one for every unwind.
+  void SwapFrames(std::vector<FrameData>* frames) { frames_.swap(*frames); }
+
+  // When set, Unwind only records compact frames, and frames() is empty.
+  // No names are looked up and nothing is allocated for each frame.
+  void SetCompactFrames(bool compact_frames) { compact_frames_only_ = compact_frames; }
+
+  const std::vector<CompactFrameData>& compact_frames() { return compact_frames_; }
+
+  std::vector<CompactFrameData> ConsumeCompactFrames() {
+    std::vector<CompactFrameData> frames = std::move(compact_frames_);
+    compact_frames_.clear();
+    return frames;
+  }
+
+  // When set, Unwind only computes a hash of the frames it finds, which is
+  // returned by StackHash(). Only compact frames are recorded, so nothing
+  // is allocated for each frame and no names are looked up.
+  void SetStackHashOnly(bool stack_hash_only) { stack_hash_only_ = stack_hash_only; }
+
+  // The hash of the last unwind made with SetStackHashOnly(true). It
+  // depends only on the relative pc and the build id of every frame, so
+  // the same call chain through the same elf files gives the same hash,
+  // even in different processes.
+  uint64_t StackHash() { return stack_hash_; }
+
+  // The number of frames found by the last unwind, in any mode.
+  size_t StackDepth() { return compact_frames_.size(); }
+
+  static uint64_t GetStackHash(const std::vector<CompactFrameData>& compact_frames);
+
+  // Create the frames that Unwind would have created from compact frames,
+  // using the current settings of this object. Every function is looked
+  // up only once per pc, no matter how many frames or stacks contain it.
+  // The maps the compact frames came from must not have changed since.
+  // If a symbolizer is passed in, the functions it already knows are not
+  // looked up again, and the new ones are added to it.
+  void Symbolize(const std::vector<CompactFrameData>& compact_frames,
+                 std::vector<FrameData>* frames, Symbolizer* symbolizer = nullptr);
+  void Symbolize(const std::vector<std::vector<CompactFrameData>>& stacks,
+                 std::vector<std::vector<FrameData>>* frames, Symbolizer* symbolizer = nullptr);
+
+  // Cache how unwinds end, so that an unwind that gets to a frame with
+  // the same registers as before, and the same data in the stack words
+  // the rest of that unwind read, adds the frames found the last time
+  // instead of stepping through them again. At most max_entries ends of
+  // unwinds are kept, and zero disables the cache. The cache keeps
+  // pointers into the maps, so it must be cleared whenever they change.
+  void SetFrameCache(size_t max_entries);
+  void ClearFrameCache();
+
+  // Limit the time every unwind takes, and the number of reads it makes
+  // from the stack. Zero means no limit. An unwind that runs out of its
+  // budget stops with ERROR_BUDGET_EXCEEDED and keeps the frames found so
+  // far. Names are only looked up while there is time left, the frames
+  // after that have no function names, but reading them does not count
+  // against the memory reads. An elf that is being read when the
+  // time runs out is still read completely, so an unwind can run over its
+  // time by as long as reading one elf takes.
+  void SetBudget(uint64_t timeout_ns, uint64_t max_memory_reads);
+
   std::string FormatFrame(size_t frame_num);
   std::string FormatFrame(const FrameData& frame);
 
@@ -117,15 +192,25 @@ class Unwinder {
   uint64_t LastErrorAddress() { return last_error_.address; }
 
  protected:
-  Unwinder(size_t max_frames) : max_frames_(max_frames) { frames_.reserve(max_frames); }
+  Unwinder(size_t max_frames);
 
-  void FillInDexFrame();
-  FrameData* FillInFrame(MapInfo* map_info, Elf* elf, uint64_t rel_pc, uint64_t pc_adjustment);
+  void AddDexFrame();
+  MapInfo* FindMap(uint64_t pc);
+  bool ShouldRemoveSpeculativeFrame();
+  CompactFrameData* AddFrame(MapInfo* map_info, Elf* elf, uint64_t rel_pc, uint64_t pc_adjustment);
+  void AddFunctions(const std::vector<CompactFrameData>& compact_frames, Symbolizer* symbolizer);
+  void FillInFrame(const CompactFrameData& compact_frame, FrameData* frame);
+  void FillInFrames(const std::vector<CompactFrameData>& compact_frames,
+                    std::vector<FrameData>* frames, const Symbolizer* symbolizer);
 
   size_t max_frames_;
   Maps* maps_;
   Regs* regs_;
   std::vector<FrameData> frames_;
+  std::vector<CompactFrameData> compact_frames_;
+  bool compact_frames_only_ = false;
+  bool stack_hash_only_ = false;
+  uint64_t stack_hash_ = 0;
   std::shared_ptr<Memory> process_memory_;
   JitDebug* jit_debug_ = nullptr;
 #if !defined(NO_LIBDEXFILE_SUPPORT)
@@ -138,6 +223,18 @@ class Unwinder {
   // file. This is only true if there is an actual file backing up the elf.
   bool elf_from_memory_not_file_ = false;
   ErrorData last_error_;
+  // The maps most recently found during an unwind. Consecutive frames,
+  // and the pc and sp of a frame, tend to land in the same few maps.
+  MapInfo* last_maps_[2] = {};
+  size_t next_last_map_ = 0;
+  // Set when the maps cannot change between unwinds, so that the maps
+  // found by one unwind are searched first by the next one.
+  bool maps_unchanged_ = false;
+  // The memory used to read the stack. If not set, process_memory_ is used.
+  Memory* stack_memory_ = nullptr;
+  std::unique_ptr<FrameCache> frame_cache_;
+  // nullptr when unwinds have no budget.
+  std::unique_ptr<UnwindBudget> budget_;
 };
 
 class UnwinderFromPid : public Unwinder {
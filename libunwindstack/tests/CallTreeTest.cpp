@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <unwindstack/CallTree.h>
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Unwinder.h>
+
+namespace unwindstack {
+
+class CallTreeTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    libc_.reset(new MapInfo(nullptr, 0x1000, 0x2000, 0, PROT_READ | PROT_EXEC, "/system/libc.so"));
+    libfoo_.reset(new MapInfo(nullptr, 0x3000, 0x4000, 0, PROT_READ | PROT_EXEC, "/system/libfoo.so"));
+  }
+
+  CompactFrameData Frame(MapInfo* map_info, uint64_t rel_pc) {
+    CompactFrameData frame = {};
+    frame.map_info = map_info;
+    frame.rel_pc = rel_pc;
+    frame.pc = map_info == nullptr ? rel_pc : map_info->start + rel_pc;
+    return frame;
+  }
+
+  std::unique_ptr<MapInfo> libc_;
+  std::unique_ptr<MapInfo> libfoo_;
+};
+
+TEST_F(CallTreeTest, add_stacks) {
+  CallTree tree;
+  tree.Add({Frame(libc_.get(), 0x10), Frame(libfoo_.get(), 0x20)});
+  tree.Add({Frame(libc_.get(), 0x10), Frame(libfoo_.get(), 0x20)});
+  tree.Add({Frame(libc_.get(), 0x30), Frame(libfoo_.get(), 0x20)}, 5);
+  tree.Add({Frame(nullptr, 0x50000)});
+
+  EXPECT_EQ(8U, tree.TotalCount());
+  std::vector<CallTree::Node> nodes = tree.GetNodes();
+  ASSERT_EQ(5U, nodes.size());
+
+  EXPECT_EQ(0U, nodes[0].count);
+
+  EXPECT_EQ(0U, nodes[1].parent);
+  EXPECT_EQ(libfoo_.get(), nodes[1].map_info);
+  EXPECT_EQ(0x20U, nodes[1].rel_pc);
+  EXPECT_EQ(0U, nodes[1].count);
+
+  EXPECT_EQ(1U, nodes[2].parent);
+  EXPECT_EQ(libc_.get(), nodes[2].map_info);
+  EXPECT_EQ(0x10U, nodes[2].rel_pc);
+  EXPECT_EQ(2U, nodes[2].count);
+
+  EXPECT_EQ(1U, nodes[3].parent);
+  EXPECT_EQ(libc_.get(), nodes[3].map_info);
+  EXPECT_EQ(0x30U, nodes[3].rel_pc);
+  EXPECT_EQ(5U, nodes[3].count);
+
+  EXPECT_EQ(0U, nodes[4].parent);
+  EXPECT_TRUE(nodes[4].map_info == nullptr);
+  EXPECT_EQ(0x50000U, nodes[4].rel_pc);
+  EXPECT_EQ(1U, nodes[4].count);
+
+  tree.Clear();
+  EXPECT_EQ(0U, tree.TotalCount());
+  EXPECT_EQ(1U, tree.GetNodes().size());
+}
+
+TEST_F(CallTreeTest, many_nodes) {
+  // Enough nodes to grow the hash table a few times.
+  CallTree tree(1);
+  for (size_t i = 0; i < 2000; i++) {
+    tree.Add({Frame(libc_.get(), i), Frame(libfoo_.get(), i % 10)});
+  }
+  for (size_t i = 0; i < 2000; i++) {
+    tree.Add({Frame(libc_.get(), i), Frame(libfoo_.get(), i % 10)});
+  }
+  std::vector<CallTree::Node> nodes = tree.GetNodes();
+  ASSERT_EQ(2011U, nodes.size());
+  for (size_t index = 1; index < nodes.size(); index++) {
+    ASSERT_LT(nodes[index].parent, index);
+    if (nodes[index].parent == 0) {
+      ASSERT_EQ(0U, nodes[index].count);
+    } else {
+      ASSERT_EQ(2U, nodes[index].count);
+    }
+  }
+}
+
+TEST_F(CallTreeTest, threads_merged) {
+  static constexpr size_t kNumThreads = 8;
+  CallTree tree(4);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([this, &tree]() {
+      for (size_t j = 0; j < 1000; j++) {
+        tree.Add({Frame(libc_.get(), j % 100), Frame(libfoo_.get(), j % 5)});
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(kNumThreads * 1000, tree.TotalCount());
+  // Every thread added the same stacks, so the merged tree has no
+  // duplicate nodes.
+  std::vector<CallTree::Node> nodes = tree.GetNodes();
+  ASSERT_EQ(106U, nodes.size());
+  for (size_t index = 1; index < nodes.size(); index++) {
+    if (nodes[index].parent != 0) {
+      EXPECT_EQ(kNumThreads * 10, nodes[index].count);
+    }
+  }
+}
+
+TEST_F(CallTreeTest, serialize) {
+  CallTree tree;
+  tree.Add({Frame(libc_.get(), 0x10), Frame(libfoo_.get(), 0x200)}, 3);
+  tree.Add({Frame(nullptr, 0x5)});
+
+  std::string expected("UWCT\x01\x02", 6);
+  expected += std::string("\x11/system/libfoo.so\x00\x00", 20);
+  expected += std::string("\x0f/system/libc.so\x00\x00", 18);
+  expected += std::string("\x03", 1);
+  expected += std::string("\x00\x01\x80\x04\x00", 5);
+  expected += std::string("\x01\x02\x10\x03", 4);
+  expected += std::string("\x00\x00\x05\x01", 4);
+  EXPECT_EQ(expected, tree.Serialize());
+}
+
+TEST_F(CallTreeTest, format_collapsed) {
+  MapInfo anonymous(nullptr, 0x5000, 0x6000, 0, PROT_READ | PROT_EXEC, "");
+  CallTree tree;
+  tree.Add({Frame(libc_.get(), 0x10), Frame(libfoo_.get(), 0x200)}, 3);
+  tree.Add({Frame(&anonymous, 0x20), Frame(libc_.get(), 0x10), Frame(libfoo_.get(), 0x200)});
+  tree.Add({Frame(nullptr, 0x5)});
+
+  EXPECT_EQ(
+      "/system/libfoo.so+0x200;/system/libc.so+0x10 3\n"
+      "/system/libfoo.so+0x200;/system/libc.so+0x10;<anonymous:5000>+0x20 1\n"
+      "0x5 1\n",
+      tree.FormatCollapsed());
+}
+
+}  // namespace unwindstack
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/stringprintf.h>
+#include <gtest/gtest.h>
+
+#include <unwindstack/DemangleCache.h>
+
+namespace unwindstack {
+
+class DemangleCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override { DemangleCache::Clear(); }
+
+  void TearDown() override {
+    DemangleCache::SetMaxEntries(DemangleCache::kDefaultMaxEntries);
+    DemangleCache::Clear();
+  }
+};
+
+TEST_F(DemangleCacheTest, demangle) {
+  EXPECT_EQ("ProcessCall()", DemangleCache::Demangle("_Z11ProcessCallv"));
+  EXPECT_EQ(1U, DemangleCache::Total());
+
+  // Getting the same name again uses the cached name.
+  EXPECT_EQ("ProcessCall()", DemangleCache::Demangle("_Z11ProcessCallv"));
+  EXPECT_EQ(1U, DemangleCache::Total());
+}
+
+TEST_F(DemangleCacheTest, not_mangled) {
+  EXPECT_EQ("", DemangleCache::Demangle(""));
+  EXPECT_EQ("main", DemangleCache::Demangle("main"));
+  EXPECT_EQ("Z11ProcessCallv", DemangleCache::Demangle("Z11ProcessCallv"));
+  EXPECT_EQ(0U, DemangleCache::Total());
+}
+
+TEST_F(DemangleCacheTest, disabled) {
+  DemangleCache::Demangle("_Z11ProcessCallv");
+  EXPECT_EQ(1U, DemangleCache::Total());
+
+  DemangleCache::SetMaxEntries(0);
+  EXPECT_EQ(0U, DemangleCache::Total());
+  EXPECT_EQ("ProcessCall()", DemangleCache::Demangle("_Z11ProcessCallv"));
+  EXPECT_EQ(0U, DemangleCache::Total());
+}
+
+TEST_F(DemangleCacheTest, evict) {
+  DemangleCache::SetMaxEntries(64);
+  for (size_t i = 0; i < 1000; i++) {
+    std::string function(android::base::StringPrintf("Function%zu", i));
+    EXPECT_EQ(function + "()", DemangleCache::Demangle(android::base::StringPrintf(
+                                   "_Z%zu%sv", function.size(), function.c_str())));
+  }
+  EXPECT_LE(DemangleCache::Total(), 64U);
+  EXPECT_NE(0U, DemangleCache::Total());
+
+  DemangleCache::SetMaxEntries(1);
+  EXPECT_LE(DemangleCache::Total(), 8U);
+}
+
+TEST_F(DemangleCacheTest, threads) {
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 8; i++) {
+    threads.emplace_back([]() {
+      for (size_t j = 0; j < 1000; j++) {
+        ASSERT_EQ("ProcessCall()", DemangleCache::Demangle("_Z11ProcessCallv"));
+        ASSERT_EQ("Process(int)", DemangleCache::Demangle("_Z7Processi"));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(2U, DemangleCache::Total());
+}
+
+}  // namespace unwindstack
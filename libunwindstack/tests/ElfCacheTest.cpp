@@ -17,6 +17,12 @@
 #include <elf.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <android-base/file.h>
 
 #include <gtest/gtest.h>
@@ -260,4 +266,226 @@ TEST_F(ElfCacheTest, caching_valid_elf_offset_non_zero_never_read_at_zero) {
   VerifyWithinSameMapNeverReadAtZero(true);
 }
 
+TEST_F(ElfCacheTest, caching_same_file_different_names) {
+  TemporaryDir td;
+  std::string file(std::string(td.path) + "/elf");
+  std::string link(std::string(td.path) + "/link");
+  {
+    TemporaryFile tf;
+    ASSERT_TRUE(tf.fd != -1);
+    WriteElfFile(0, &tf, EM_ARM);
+    close(tf.fd);
+    ASSERT_EQ(0, rename(tf.path, file.c_str()));
+  }
+  ASSERT_EQ(0, symlink(file.c_str(), link.c_str()));
+
+  MapInfo info1(nullptr, 0x1000, 0x20000, 0, 0x5, file);
+  MapInfo info2(nullptr, 0x1000, 0x20000, 0, 0x5, link);
+
+  Elf* elf1 = info1.GetElf(memory_, ARCH_ARM);
+  ASSERT_TRUE(elf1->valid());
+  Elf* elf2 = info2.GetElf(memory_, ARCH_ARM);
+  ASSERT_TRUE(elf2->valid());
+  EXPECT_EQ(elf1, elf2);
+}
+
+TEST_F(ElfCacheTest, caching_replaced_file) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+  WriteElfFile(0, &tf, EM_ARM);
+  close(tf.fd);
+
+  MapInfo info1(nullptr, 0x1000, 0x20000, 0, 0x5, tf.path);
+  Elf* elf1 = info1.GetElf(memory_, ARCH_ARM);
+  ASSERT_TRUE(elf1->valid());
+
+  // Replace the file with a new one, the way an update would.
+  TemporaryFile tf_new;
+  ASSERT_TRUE(tf_new.fd != -1);
+  WriteElfFile(0, &tf_new, EM_ARM);
+  close(tf_new.fd);
+  ASSERT_EQ(0, rename(tf_new.path, tf.path));
+
+  MapInfo info2(nullptr, 0x1000, 0x20000, 0, 0x5, tf.path);
+  Elf* elf2 = info2.GetElf(memory_, ARCH_ARM);
+  ASSERT_TRUE(elf2->valid());
+  EXPECT_NE(elf1, elf2);
+}
+
+TEST_F(ElfCacheTest, caching_no_file) {
+  MapInfo info1(nullptr, 0x1000, 0x20000, 0, 0x5, "/does/not/exist");
+  MapInfo info2(nullptr, 0x1000, 0x20000, 0, 0x5, "/does/not/exist");
+
+  // Elf objects that cannot be associated with a file are never cached.
+  Elf* elf1 = info1.GetElf(memory_, ARCH_ARM);
+  Elf* elf2 = info2.GetElf(memory_, ARCH_ARM);
+  EXPECT_NE(elf1, elf2);
+}
+
+TEST_F(ElfCacheTest, caching_multiple_threads) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+  WriteElfFile(0, &tf, EM_ARM);
+  lseek(tf.fd, 0x500, SEEK_SET);
+  uint8_t value = 0;
+  write(tf.fd, &value, 1);
+  close(tf.fd);
+
+  static constexpr size_t kNumThreads = 16;
+  std::vector<std::unique_ptr<MapInfo>> infos;
+  for (size_t i = 0; i < kNumThreads; i++) {
+    // Alternate between maps at offset zero and maps at a non-zero offset
+    // that reference the whole file.
+    uint64_t offset = (i % 2) ? 0x300 : 0;
+    infos.emplace_back(new MapInfo(nullptr, 0x1000, 0x20000, offset, 0x5, tf.path));
+  }
+
+  std::atomic_bool wait;
+  wait = true;
+  std::vector<Elf*> elfs(kNumThreads);
+  std::vector<std::thread*> threads;
+  for (size_t i = 0; i < kNumThreads; i++) {
+    std::thread* thread = new std::thread([i, &wait, &infos, &elfs]() {
+      while (wait)
+        ;
+      elfs[i] = infos[i]->GetElf(memory_, ARCH_ARM);
+    });
+    threads.push_back(thread);
+  }
+  wait = false;
+  for (auto thread : threads) {
+    thread->join();
+    delete thread;
+  }
+
+  for (size_t i = 0; i < kNumThreads; i++) {
+    ASSERT_TRUE(elfs[i]->valid()) << "Failed on thread " << i;
+    EXPECT_EQ(elfs[0], elfs[i]) << "Failed on thread " << i;
+    EXPECT_EQ(infos[i]->offset, infos[i]->elf_offset) << "Failed on thread " << i;
+  }
+}
+
+TEST_F(ElfCacheTest, caching_entries) {
+  TemporaryFile tf1;
+  ASSERT_TRUE(tf1.fd != -1);
+  WriteElfFile(0, &tf1, EM_ARM);
+  TemporaryFile tf2;
+  ASSERT_TRUE(tf2.fd != -1);
+  WriteElfFile(0, &tf2, EM_ARM);
+
+  MapInfo info1(nullptr, 0x1000, 0x20000, 0, 0x5, tf1.path);
+  MapInfo info2(nullptr, 0x1000, 0x20000, 0, 0x5, tf2.path);
+  Elf* elf1 = info1.GetElf(memory_, ARCH_ARM);
+  Elf* elf2 = info2.GetElf(memory_, ARCH_ARM);
+
+  std::vector<ElfCacheEntryInfo> entries;
+  Elf::CacheGetEntries(&entries);
+  ASSERT_EQ(2U, entries.size());
+  std::sort(entries.begin(), entries.end(),
+            [](const ElfCacheEntryInfo& a, const ElfCacheEntryInfo& b) { return a.name < b.name; });
+  std::vector<std::string> names{tf1.path, tf2.path};
+  std::sort(names.begin(), names.end());
+  EXPECT_EQ(names[0], entries[0].name);
+  EXPECT_EQ(names[1], entries[1].name);
+  EXPECT_EQ(0U, entries[0].key.offset);
+  EXPECT_EQ(0U, entries[1].key.offset);
+  EXPECT_NE(0U, entries[0].size);
+  EXPECT_NE(0U, entries[1].size);
+  EXPECT_EQ(elf1->MemoryUsage() + elf2->MemoryUsage(), Elf::CacheSize());
+  EXPECT_EQ(entries[0].size + entries[1].size, Elf::CacheSize());
+}
+
+TEST_F(ElfCacheTest, caching_entries_shared_elf) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+  WriteElfFile(0, &tf, EM_ARM);
+  lseek(tf.fd, 0x500, SEEK_SET);
+  uint8_t value = 0;
+  write(tf.fd, &value, 1);
+  close(tf.fd);
+
+  // A map at a non-zero offset that references the whole file creates
+  // two entries for the same elf.
+  MapInfo info(nullptr, 0x1000, 0x20000, 0x300, 0x5, tf.path);
+  Elf* elf = info.GetElf(memory_, ARCH_ARM);
+  ASSERT_TRUE(elf->valid());
+
+  std::vector<ElfCacheEntryInfo> entries;
+  Elf::CacheGetEntries(&entries);
+  ASSERT_EQ(2U, entries.size());
+  EXPECT_EQ(elf->MemoryUsage(), entries[0].size + entries[1].size);
+  EXPECT_TRUE(entries[0].size == 0 || entries[1].size == 0);
+  EXPECT_EQ(elf->MemoryUsage(), Elf::CacheSize());
+}
+
+TEST_F(ElfCacheTest, caching_evict_least_recently_used) {
+  std::vector<std::unique_ptr<TemporaryFile>> files;
+  for (size_t i = 0; i < 3; i++) {
+    files.emplace_back(new TemporaryFile);
+    ASSERT_TRUE(files.back()->fd != -1);
+    WriteElfFile(0, files.back().get(), EM_ARM);
+  }
+
+  std::unique_ptr<MapInfo> info1(new MapInfo(nullptr, 0x1000, 0x20000, 0, 0x5, files[0]->path));
+  Elf* elf1 = info1->GetElf(memory_, ARCH_ARM);
+  ASSERT_TRUE(elf1->valid());
+  uint64_t elf_size = elf1->MemoryUsage();
+  // Allow two elf objects in the cache.
+  Elf::SetCachingEnabled(true, 2 * elf_size + elf_size / 2);
+
+  MapInfo info2(nullptr, 0x1000, 0x20000, 0, 0x5, files[1]->path);
+  Elf* elf2 = info2.GetElf(memory_, ARCH_ARM);
+  ASSERT_EQ(2 * elf_size, Elf::CacheSize());
+
+  // Make the first elf the most recently used.
+  MapInfo info1_again(nullptr, 0x1000, 0x20000, 0, 0x5, files[0]->path);
+  ASSERT_EQ(elf1, info1_again.GetElf(memory_, ARCH_ARM));
+
+  MapInfo info3(nullptr, 0x1000, 0x20000, 0, 0x5, files[2]->path);
+  Elf* elf3 = info3.GetElf(memory_, ARCH_ARM);
+  ASSERT_EQ(2 * elf_size, Elf::CacheSize());
+
+  std::vector<ElfCacheEntryInfo> entries;
+  Elf::CacheGetEntries(&entries);
+  ASSERT_EQ(2U, entries.size());
+  for (const auto& entry : entries) {
+    EXPECT_NE(files[1]->path, entry.name);
+  }
+
+  // The evicted elf is still usable by the map that holds it.
+  ASSERT_TRUE(elf2->valid());
+  ASSERT_EQ(elf2, info2.GetElf(memory_, ARCH_ARM));
+
+  // The cached elf objects are still shared.
+  MapInfo info3_again(nullptr, 0x1000, 0x20000, 0, 0x5, files[2]->path);
+  ASSERT_EQ(elf3, info3_again.GetElf(memory_, ARCH_ARM));
+  info1.reset();
+  MapInfo info1_last(nullptr, 0x1000, 0x20000, 0, 0x5, files[0]->path);
+  ASSERT_EQ(elf1, info1_last.GetElf(memory_, ARCH_ARM));
+}
+
+TEST_F(ElfCacheTest, caching_shrink_max_size) {
+  TemporaryFile tf1;
+  ASSERT_TRUE(tf1.fd != -1);
+  WriteElfFile(0, &tf1, EM_ARM);
+  TemporaryFile tf2;
+  ASSERT_TRUE(tf2.fd != -1);
+  WriteElfFile(0, &tf2, EM_ARM);
+
+  MapInfo info1(nullptr, 0x1000, 0x20000, 0, 0x5, tf1.path);
+  Elf* elf1 = info1.GetElf(memory_, ARCH_ARM);
+  MapInfo info2(nullptr, 0x1000, 0x20000, 0, 0x5, tf2.path);
+  Elf* elf2 = info2.GetElf(memory_, ARCH_ARM);
+  ASSERT_EQ(elf1->MemoryUsage() + elf2->MemoryUsage(), Elf::CacheSize());
+
+  // Even when a single elf is larger than the maximum, the most recently
+  // used elf is kept.
+  Elf::SetCachingEnabled(true, 1);
+  ASSERT_EQ(elf2->MemoryUsage(), Elf::CacheSize());
+  std::vector<ElfCacheEntryInfo> entries;
+  Elf::CacheGetEntries(&entries);
+  ASSERT_EQ(1U, entries.size());
+  EXPECT_EQ(tf2.path, entries[0].name);
+}
+
 }  // namespace unwindstack
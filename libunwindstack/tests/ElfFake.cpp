@@ -25,7 +25,6 @@
 #include <unwindstack/Regs.h>
 
 #include "ElfFake.h"
-#include "RegsFake.h"
 
 namespace unwindstack {
 
@@ -52,7 +51,7 @@ bool ElfInterfaceFake::GetGlobalVariable(const std::string& global, uint64_t* of
   return true;
 }
 
-bool ElfInterfaceFake::Step(uint64_t, Regs* regs, Memory*, bool* finished) {
+bool ElfInterfaceFake::Step(uint64_t, Regs* regs, Memory* process_memory, bool* finished) {
   if (steps_.empty()) {
     return false;
   }
@@ -64,9 +63,12 @@ bool ElfInterfaceFake::Step(uint64_t, Regs* regs, Memory*, bool* finished) {
     return false;
   }
 
-  RegsFake* fake_regs = reinterpret_cast<RegsFake*>(regs);
-  fake_regs->set_pc(entry.pc);
-  fake_regs->set_sp(entry.sp);
+  if (entry.pc_addr != 0 && !process_memory->Read64(entry.pc_addr, &entry.pc)) {
+    return false;
+  }
+
+  regs->set_pc(entry.pc);
+  regs->set_sp(entry.sp);
   *finished = entry.finished;
   return true;
 }
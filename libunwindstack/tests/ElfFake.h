@@ -34,9 +34,13 @@ namespace unwindstack {
 
 struct StepData {
   StepData(uint64_t pc, uint64_t sp, bool finished) : pc(pc), sp(sp), finished(finished) {}
+  StepData(uint64_t pc, uint64_t sp, bool finished, uint64_t pc_addr)
+      : pc(pc), sp(sp), finished(finished), pc_addr(pc_addr) {}
   uint64_t pc;
   uint64_t sp;
   bool finished;
+  // If not zero, the pc is read from this address instead.
+  uint64_t pc_addr = 0;
 };
 
 struct FunctionData {
@@ -85,6 +89,8 @@ class ElfInterfaceFake : public ElfInterface {
 
   void FakeSetSoname(const char* soname) { fake_soname_ = soname; }
 
+  void FakeSetGnuDebugdataOffset(uint64_t offset) { gnu_debugdata_offset_ = offset; }
+
   static void FakePushFunctionData(const FunctionData data) { functions_.push_back(data); }
   static void FakePushStepData(const StepData data) { steps_.push_back(data); }
 
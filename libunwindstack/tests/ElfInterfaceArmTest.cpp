@@ -405,18 +405,104 @@ TEST_F(ElfInterfaceArmTest, StepExidx_pc_zero) {
   ASSERT_TRUE(finished);
   ASSERT_EQ(0U, regs.pc());
 
-  // Now set the pc from the lr register (pop r14).
+  // Now set the pc from the lr register (pop r14). The opcodes of an entry
+  // are cached after the first step, so use a new interface.
   memory_.SetData32(0x1004, 0x808400b0);
+  ElfInterfaceArmFake interface_lr(&memory_);
+  interface_lr.FakeSetStartOffset(0x1000);
+  interface_lr.FakeSetTotalEntries(1);
 
   regs[ARM_REG_SP] = 0x10000;
   regs[ARM_REG_LR] = 0x20000;
   regs.set_sp(regs[ARM_REG_SP]);
   regs.set_pc(0x1234);
 
-  ASSERT_TRUE(interface.StepExidx(0x7000, &regs, &process_memory_, &finished));
-  EXPECT_EQ(ERROR_NONE, interface.LastErrorCode());
+  ASSERT_TRUE(interface_lr.StepExidx(0x7000, &regs, &process_memory_, &finished));
+  EXPECT_EQ(ERROR_NONE, interface_lr.LastErrorCode());
   ASSERT_TRUE(finished);
   ASSERT_EQ(0U, regs.pc());
 }
 
+TEST_F(ElfInterfaceArmTest, FindEntry_decodes_chunk) {
+  ElfInterfaceArmFake interface(&memory_);
+  interface.FakeSetStartOffset(0x1000);
+  interface.FakeSetTotalEntries(1000);
+  for (size_t i = 0; i < 1000; i++) {
+    memory_.SetData32(0x1000 + i * 8, 0xf000 + i * 8);
+    memory_.SetData32(0x1004 + i * 8, 0);
+  }
+
+  uint64_t entry_offset;
+  ASSERT_TRUE(interface.FindEntry(0x10100, &entry_offset));
+  ASSERT_EQ(0x1080U, entry_offset);
+
+  // The whole chunk that contains the probed entries should be cached.
+  for (size_t i = 0; i < 512; i++) {
+    memory_.SetData32(0x1000 + i * 8, 0);
+  }
+  ASSERT_TRUE(interface.FindEntry(0x10008, &entry_offset));
+  ASSERT_EQ(0x1000U, entry_offset);
+  ASSERT_TRUE(interface.FindEntry(0x11ff8, &entry_offset));
+  ASSERT_EQ(0x1ff8U, entry_offset);
+
+  // Entries in the second chunk are still read from memory.
+  ASSERT_TRUE(interface.FindEntry(0x12000, &entry_offset));
+  ASSERT_EQ(0x2000U, entry_offset);
+  ASSERT_TRUE(interface.FindEntry(0x13e70, &entry_offset));
+  ASSERT_EQ(0x2f38U, entry_offset);
+}
+
+TEST_F(ElfInterfaceArmTest, FindEntry_large_table_decodes_only_searched_chunks) {
+  ElfInterfaceArmFake interface(&memory_);
+  interface.FakeSetStartOffset(0x1000);
+  // A size like this can come from a malformed program header, and the
+  // table is not actually present.
+  interface.FakeSetTotalEntries(1 << 22);
+  uint64_t usage = interface.MemoryUsage();
+
+  uint64_t entry_offset;
+  ASSERT_FALSE(interface.FindEntry(0x10000, &entry_offset));
+
+  // Only the chunk that was searched is allocated, not the whole table.
+  EXPECT_GT(usage + 0x20000, interface.MemoryUsage());
+}
+
+TEST_F(ElfInterfaceArmTest, StepExidx_caches_entry_ops) {
+  ElfInterfaceArmFake interface(&memory_);
+
+  interface.FakeSetStartOffset(0x1000);
+  interface.FakeSetTotalEntries(1);
+  memory_.SetData32(0x1000, 0x6000);
+  // Set the pc using a pop r15 command.
+  memory_.SetData32(0x1004, 0x808800b0);
+
+  process_memory_.SetData32(0x10000, 0x10);
+
+  RegsArm regs;
+  regs[ARM_REG_SP] = 0x10000;
+  regs[ARM_REG_LR] = 0x20000;
+  regs.set_sp(regs[ARM_REG_SP]);
+  regs.set_pc(0x1234);
+
+  bool finished;
+  ASSERT_TRUE(interface.StepExidx(0x7000, &regs, &process_memory_, &finished));
+  ASSERT_FALSE(finished);
+  ASSERT_EQ(0x10U, regs.pc());
+
+  // Remove the entry data, the cached opcodes are used instead.
+  memory_.Clear();
+  memory_.SetData32(0x1000, 0x6000);
+
+  regs[ARM_REG_SP] = 0x10000;
+  regs[ARM_REG_LR] = 0x20000;
+  regs.set_sp(regs[ARM_REG_SP]);
+  regs.set_pc(0x1234);
+
+  ASSERT_TRUE(interface.StepExidx(0x7000, &regs, &process_memory_, &finished));
+  EXPECT_EQ(ERROR_NONE, interface.LastErrorCode());
+  ASSERT_FALSE(finished);
+  ASSERT_EQ(0x10U, regs.pc());
+  ASSERT_EQ(0x10004U, regs.sp());
+}
+
 }  // namespace unwindstack
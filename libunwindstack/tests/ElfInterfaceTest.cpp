@@ -15,8 +15,10 @@
  */
 
 #include <elf.h>
+#include <string.h>
 
 #include <memory>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -38,6 +40,22 @@
 
 namespace unwindstack {
 
+class MemoryFakeCountReads : public MemoryFake {
+ public:
+  MemoryFakeCountReads() = default;
+  virtual ~MemoryFakeCountReads() = default;
+
+  size_t Read(uint64_t addr, void* buffer, size_t size) override {
+    reads_++;
+    return MemoryFake::Read(addr, buffer, size);
+  }
+
+  size_t reads() { return reads_; }
+
+ private:
+  size_t reads_ = 0;
+};
+
 class ElfInterfaceTest : public ::testing::Test {
  protected:
   void SetUp() override {
@@ -112,6 +130,9 @@ class ElfInterfaceTest : public ::testing::Test {
   template <typename Ehdr, typename Shdr, typename ElfInterfaceType>
   void InitSectionHeadersOffsets();
 
+  template <typename Ehdr, typename Phdr, typename Shdr, typename ElfInterfaceType>
+  void InitHeadersBulkRead();
+
   template <typename Sym>
   void InitSym(uint64_t offset, uint32_t value, uint32_t size, uint32_t name_offset,
                uint64_t sym_offset, const char* name);
@@ -908,7 +929,7 @@ void ElfInterfaceTest::InitSectionHeadersOffsets() {
 
   Ehdr ehdr = {};
   ehdr.e_shoff = offset;
-  ehdr.e_shnum = 7;
+  ehdr.e_shnum = 8;
   ehdr.e_shentsize = sizeof(Shdr);
   ehdr.e_shstrndx = 2;
   memory_.SetMemory(0, &ehdr, sizeof(ehdr));
@@ -976,11 +997,22 @@ void ElfInterfaceTest::InitSectionHeadersOffsets() {
   memory_.SetMemory(offset, &shdr, sizeof(shdr));
   offset += ehdr.e_shentsize;
 
+  memset(&shdr, 0, sizeof(shdr));
+  shdr.sh_type = SHT_PROGBITS;
+  shdr.sh_link = 2;
+  shdr.sh_name = 0x600;
+  shdr.sh_addr = 0xc000;
+  shdr.sh_offset = 0xc000;
+  shdr.sh_size = 0x300;
+  memory_.SetMemory(offset, &shdr, sizeof(shdr));
+  offset += ehdr.e_shentsize;
+
   memory_.SetMemory(0xf100, ".debug_frame", sizeof(".debug_frame"));
   memory_.SetMemory(0xf200, ".gnu_debugdata", sizeof(".gnu_debugdata"));
   memory_.SetMemory(0xf300, ".eh_frame", sizeof(".eh_frame"));
   memory_.SetMemory(0xf400, ".eh_frame_hdr", sizeof(".eh_frame_hdr"));
   memory_.SetMemory(0xf500, ".note.gnu.build-id", sizeof(".note.gnu.build-id"));
+  memory_.SetMemory(0xf600, ".sframe", sizeof(".sframe"));
 
   uint64_t load_bias = 0;
   ASSERT_TRUE(elf->Init(&load_bias));
@@ -995,6 +1027,8 @@ void ElfInterfaceTest::InitSectionHeadersOffsets() {
   EXPECT_EQ(0xf00U, elf->eh_frame_hdr_size());
   EXPECT_EQ(0xb000U, elf->gnu_build_id_offset());
   EXPECT_EQ(0xf00U, elf->gnu_build_id_size());
+  EXPECT_EQ(0xc000U, elf->sframe_offset());
+  EXPECT_EQ(0x300U, elf->sframe_size());
 }
 
 TEST_F(ElfInterfaceTest, init_section_headers_offsets32) {
@@ -1005,6 +1039,112 @@ TEST_F(ElfInterfaceTest, init_section_headers_offsets64) {
   InitSectionHeadersOffsets<Elf64_Ehdr, Elf64_Shdr, ElfInterface64>();
 }
 
+template <typename Ehdr, typename Phdr, typename Shdr, typename ElfInterfaceType>
+void ElfInterfaceTest::InitHeadersBulkRead() {
+  MemoryFakeCountReads memory;
+  std::unique_ptr<ElfInterfaceType> elf(new ElfInterfaceType(&memory));
+
+  Ehdr ehdr = {};
+  ehdr.e_phoff = 0x100;
+  ehdr.e_phnum = 3;
+  ehdr.e_phentsize = sizeof(Phdr);
+  ehdr.e_shoff = 0x2000;
+  ehdr.e_shnum = 5;
+  ehdr.e_shentsize = sizeof(Shdr);
+  ehdr.e_shstrndx = 1;
+  memory.SetMemory(0, &ehdr, sizeof(ehdr));
+
+  uint64_t offset = 0x100;
+  Phdr phdr = {};
+  phdr.p_type = PT_LOAD;
+  phdr.p_vaddr = 0x2000;
+  phdr.p_memsz = 0x10000;
+  phdr.p_flags = PF_R | PF_X;
+  memory.SetMemory(offset, &phdr, sizeof(phdr));
+  offset += sizeof(phdr);
+
+  memset(&phdr, 0, sizeof(phdr));
+  phdr.p_type = PT_GNU_EH_FRAME;
+  phdr.p_offset = 0x7000;
+  phdr.p_memsz = 0x100;
+  memory.SetMemory(offset, &phdr, sizeof(phdr));
+  offset += sizeof(phdr);
+
+  memset(&phdr, 0, sizeof(phdr));
+  phdr.p_type = PT_DYNAMIC;
+  phdr.p_offset = 0x8000;
+  phdr.p_vaddr = 0x9000;
+  phdr.p_memsz = 0x200;
+  memory.SetMemory(offset, &phdr, sizeof(phdr));
+
+  // The first header is always NULL.
+  offset = 0x2000;
+  Shdr shdr = {};
+  memory.SetMemory(offset, &shdr, sizeof(shdr));
+  offset += sizeof(shdr);
+
+  // The string data for section header names.
+  shdr.sh_type = SHT_STRTAB;
+  shdr.sh_name = 1;
+  shdr.sh_offset = 0x3000;
+  shdr.sh_size = 0x40;
+  memory.SetMemory(offset, &shdr, sizeof(shdr));
+  offset += sizeof(shdr);
+
+  memset(&shdr, 0, sizeof(shdr));
+  shdr.sh_type = SHT_PROGBITS;
+  shdr.sh_name = 11;
+  shdr.sh_offset = 0x4000;
+  shdr.sh_size = 0x300;
+  memory.SetMemory(offset, &shdr, sizeof(shdr));
+  offset += sizeof(shdr);
+
+  memset(&shdr, 0, sizeof(shdr));
+  shdr.sh_type = SHT_PROGBITS;
+  shdr.sh_name = 24;
+  shdr.sh_offset = 0x5000;
+  shdr.sh_size = 0x400;
+  memory.SetMemory(offset, &shdr, sizeof(shdr));
+  offset += sizeof(shdr);
+
+  memset(&shdr, 0, sizeof(shdr));
+  shdr.sh_type = SHT_NOTE;
+  shdr.sh_name = 34;
+  shdr.sh_offset = 0x6000;
+  shdr.sh_size = 0x20;
+  memory.SetMemory(offset, &shdr, sizeof(shdr));
+
+  std::vector<uint8_t> names(0x40);
+  const char kNames[] = "\0.shstrtab\0.debug_frame\0.eh_frame\0.note.gnu.build-id";
+  memcpy(names.data(), kNames, sizeof(kNames));
+  memory.SetMemory(0x3000, names);
+
+  uint64_t load_bias = 0;
+  ASSERT_TRUE(elf->Init(&load_bias));
+  EXPECT_EQ(0x2000U, load_bias);
+  ASSERT_EQ(1U, elf->pt_loads().size());
+  EXPECT_EQ(0x7000U, elf->eh_frame_hdr_offset());
+  EXPECT_EQ(0x8000U, elf->dynamic_offset());
+  EXPECT_EQ(0x300U, elf->debug_frame_size());
+  EXPECT_EQ(0x4000U, elf->debug_frame_offset());
+  EXPECT_EQ(0x5000U, elf->eh_frame_offset());
+  EXPECT_EQ(0x400U, elf->eh_frame_size());
+  EXPECT_EQ(0x6000U, elf->gnu_build_id_offset());
+  EXPECT_EQ(0x20U, elf->gnu_build_id_size());
+
+  // One read each for the elf header, the program headers, the section
+  // headers and the section names.
+  EXPECT_EQ(4U, memory.reads());
+}
+
+TEST_F(ElfInterfaceTest, init_headers_bulk_read32) {
+  InitHeadersBulkRead<Elf32_Ehdr, Elf32_Phdr, Elf32_Shdr, ElfInterface32>();
+}
+
+TEST_F(ElfInterfaceTest, init_headers_bulk_read64) {
+  InitHeadersBulkRead<Elf64_Ehdr, Elf64_Phdr, Elf64_Shdr, ElfInterface64>();
+}
+
 TEST_F(ElfInterfaceTest, is_valid_pc_from_pt_load) {
   std::unique_ptr<ElfInterface> elf(new ElfInterface32(&memory_));
 
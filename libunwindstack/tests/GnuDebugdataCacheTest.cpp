@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <elf.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <android-base/file.h>
+
+#include <gtest/gtest.h>
+
+#include <unwindstack/GnuDebugdataCache.h>
+#include <unwindstack/Memory.h>
+
+#include "ElfFake.h"
+#include "ElfTestUtils.h"
+#include "MemoryFake.h"
+
+namespace unwindstack {
+
+// Defined before the tests that enable the cache, so that it runs before
+// the cache state exists when the tests in this file are run on their own.
+TEST(GnuDebugdataCacheNotEnabledTest, get_and_add) {
+  ASSERT_TRUE(GnuDebugdataCache::Get("build_id") == nullptr);
+
+  std::shared_ptr<MemoryBuffer> buffer(new MemoryBuffer);
+  buffer->Resize(0x100);
+  ASSERT_EQ(buffer.get(), GnuDebugdataCache::Add("build_id", buffer).get());
+  ASSERT_EQ(0U, GnuDebugdataCache::Total());
+  ASSERT_TRUE(GnuDebugdataCache::Get("build_id") == nullptr);
+}
+
+class GnuDebugdataCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override { GnuDebugdataCache::SetEnabled(true); }
+
+  void TearDown() override { GnuDebugdataCache::SetEnabled(false); }
+
+  static std::shared_ptr<MemoryBuffer> CreateElfBuffer(size_t size, uint8_t fill) {
+    std::shared_ptr<MemoryBuffer> memory(new MemoryBuffer);
+    memory->Resize(size);
+    memset(memory->GetPtr(0), fill, size);
+    memcpy(memory->GetPtr(0), ELFMAG, SELFMAG);
+    return memory;
+  }
+};
+
+TEST_F(GnuDebugdataCacheTest, disabled) {
+  GnuDebugdataCache::SetEnabled(false);
+  ASSERT_FALSE(GnuDebugdataCache::Enabled());
+  ASSERT_EQ(0U, GnuDebugdataCache::Total());
+  ASSERT_EQ(0U, GnuDebugdataCache::Size());
+}
+
+TEST_F(GnuDebugdataCacheTest, add_and_get) {
+  ASSERT_TRUE(GnuDebugdataCache::Get("build_id") == nullptr);
+
+  std::shared_ptr<MemoryBuffer> buffer(CreateElfBuffer(0x100, 0x12));
+  std::shared_ptr<Memory> memory(GnuDebugdataCache::Add("build_id", buffer));
+  ASSERT_EQ(buffer.get(), memory.get());
+  ASSERT_EQ(1U, GnuDebugdataCache::Total());
+  ASSERT_EQ(0x100U, GnuDebugdataCache::Size());
+
+  ASSERT_EQ(buffer.get(), GnuDebugdataCache::Get("build_id").get());
+  ASSERT_TRUE(GnuDebugdataCache::Get("other_id") == nullptr);
+}
+
+TEST_F(GnuDebugdataCacheTest, add_existing) {
+  std::shared_ptr<MemoryBuffer> buffer(CreateElfBuffer(0x100, 0x12));
+  ASSERT_EQ(buffer.get(), GnuDebugdataCache::Add("build_id", buffer).get());
+
+  // The first data added is always the one used.
+  std::shared_ptr<MemoryBuffer> new_buffer(CreateElfBuffer(0x100, 0x34));
+  ASSERT_EQ(buffer.get(), GnuDebugdataCache::Add("build_id", new_buffer).get());
+  ASSERT_EQ(1U, GnuDebugdataCache::Total());
+  ASSERT_EQ(0x100U, GnuDebugdataCache::Size());
+}
+
+TEST_F(GnuDebugdataCacheTest, evict_least_recently_used) {
+  GnuDebugdataCache::SetEnabled(true, 0x300);
+
+  std::shared_ptr<MemoryBuffer> buffer1(CreateElfBuffer(0x100, 0x1));
+  std::shared_ptr<MemoryBuffer> buffer2(CreateElfBuffer(0x100, 0x2));
+  std::shared_ptr<MemoryBuffer> buffer3(CreateElfBuffer(0x100, 0x3));
+  GnuDebugdataCache::Add("id1", buffer1);
+  GnuDebugdataCache::Add("id2", buffer2);
+  GnuDebugdataCache::Add("id3", buffer3);
+  ASSERT_EQ(3U, GnuDebugdataCache::Total());
+  ASSERT_EQ(0x300U, GnuDebugdataCache::Size());
+
+  // Make id1 the most recently used.
+  ASSERT_EQ(buffer1.get(), GnuDebugdataCache::Get("id1").get());
+
+  std::shared_ptr<MemoryBuffer> buffer4(CreateElfBuffer(0x180, 0x4));
+  GnuDebugdataCache::Add("id4", buffer4);
+  ASSERT_EQ(2U, GnuDebugdataCache::Total());
+  ASSERT_EQ(0x280U, GnuDebugdataCache::Size());
+  ASSERT_EQ(buffer1.get(), GnuDebugdataCache::Get("id1").get());
+  ASSERT_TRUE(GnuDebugdataCache::Get("id2") == nullptr);
+  ASSERT_TRUE(GnuDebugdataCache::Get("id3") == nullptr);
+  ASSERT_EQ(buffer4.get(), GnuDebugdataCache::Get("id4").get());
+
+  // Evicted data is still valid for the users that hold a reference.
+  uint8_t value;
+  ASSERT_TRUE(buffer2->ReadFully(0x80, &value, 1));
+  ASSERT_EQ(0x2U, value);
+}
+
+TEST_F(GnuDebugdataCacheTest, shrink_max_size) {
+  GnuDebugdataCache::Add("id1", CreateElfBuffer(0x100, 0x1));
+  GnuDebugdataCache::Add("id2", CreateElfBuffer(0x100, 0x2));
+  ASSERT_EQ(0x200U, GnuDebugdataCache::Size());
+
+  GnuDebugdataCache::SetEnabled(true, 0x100);
+  ASSERT_EQ(1U, GnuDebugdataCache::Total());
+  ASSERT_EQ(0x100U, GnuDebugdataCache::Size());
+  ASSERT_TRUE(GnuDebugdataCache::Get("id1") == nullptr);
+  ASSERT_TRUE(GnuDebugdataCache::Get("id2") != nullptr);
+}
+
+TEST_F(GnuDebugdataCacheTest, too_large) {
+  GnuDebugdataCache::SetEnabled(true, 0x100);
+  GnuDebugdataCache::Add("id1", CreateElfBuffer(0x100, 0x1));
+
+  std::shared_ptr<MemoryBuffer> buffer(CreateElfBuffer(0x101, 0x2));
+  ASSERT_EQ(buffer.get(), GnuDebugdataCache::Add("id2", buffer).get());
+  ASSERT_EQ(1U, GnuDebugdataCache::Total());
+  ASSERT_TRUE(GnuDebugdataCache::Get("id1") != nullptr);
+  ASSERT_TRUE(GnuDebugdataCache::Get("id2") == nullptr);
+}
+
+TEST_F(GnuDebugdataCacheTest, disk_cache) {
+  TemporaryDir td;
+  GnuDebugdataCache::SetDiskCache(td.path);
+
+  GnuDebugdataCache::Add(std::string("\x01\xab\xff", 3), CreateElfBuffer(0x100, 0x5a));
+  std::string path(std::string(td.path) + "/01abff.gnu_debugdata");
+  struct stat buf;
+  ASSERT_EQ(0, stat(path.c_str(), &buf));
+  ASSERT_EQ(0x100, buf.st_size);
+
+  // Simulate a different process by clearing the in memory data.
+  GnuDebugdataCache::SetEnabled(false);
+  GnuDebugdataCache::SetEnabled(true);
+  ASSERT_TRUE(GnuDebugdataCache::Get(std::string("\x01\xab\xff", 3)) == nullptr);
+  GnuDebugdataCache::SetDiskCache(td.path);
+
+  std::shared_ptr<Memory> memory(GnuDebugdataCache::Get(std::string("\x01\xab\xff", 3)));
+  ASSERT_TRUE(memory != nullptr);
+  ASSERT_EQ(1U, GnuDebugdataCache::Total());
+  uint8_t data[0x100];
+  ASSERT_TRUE(memory->ReadFully(0, data, sizeof(data)));
+  ASSERT_EQ(0, memcmp(ELFMAG, data, SELFMAG));
+  for (size_t i = SELFMAG; i < sizeof(data); i++) {
+    ASSERT_EQ(0x5aU, data[i]) << "Failed at byte " << i;
+  }
+  ASSERT_FALSE(memory->ReadFully(0, data, sizeof(data) + 1));
+
+  // The second get comes from memory.
+  ASSERT_EQ(memory.get(), GnuDebugdataCache::Get(std::string("\x01\xab\xff", 3)).get());
+}
+
+TEST_F(GnuDebugdataCacheTest, disk_cache_invalid_file) {
+  TemporaryDir td;
+  GnuDebugdataCache::SetDiskCache(td.path);
+
+  ASSERT_TRUE(android::base::WriteStringToFile("Not an elf",
+                                               std::string(td.path) + "/1234.gnu_debugdata"));
+  ASSERT_TRUE(GnuDebugdataCache::Get("\x12\x34") == nullptr);
+  ASSERT_EQ(0U, GnuDebugdataCache::Total());
+}
+
+TEST_F(GnuDebugdataCacheTest, disk_cache_trim) {
+  TemporaryDir td;
+  GnuDebugdataCache::SetDiskCache(td.path, 0x180);
+
+  std::string path1(std::string(td.path) + "/11.gnu_debugdata");
+  std::string path2(std::string(td.path) + "/22.gnu_debugdata");
+  GnuDebugdataCache::Add("\x11", CreateElfBuffer(0x100, 0x1));
+  // Make sure the first file is older.
+  struct timespec times[2] = {{1, 0}, {1, 0}};
+  ASSERT_EQ(0, utimensat(AT_FDCWD, path1.c_str(), times, 0));
+  GnuDebugdataCache::Add("\x22", CreateElfBuffer(0x100, 0x2));
+
+  ASSERT_NE(0, access(path1.c_str(), F_OK));
+  ASSERT_EQ(0, access(path2.c_str(), F_OK));
+
+  // Data too large for the directory is never written.
+  GnuDebugdataCache::Add("\x33", CreateElfBuffer(0x200, 0x3));
+  ASSERT_NE(0, access((std::string(td.path) + "/33.gnu_debugdata").c_str(), F_OK));
+  ASSERT_EQ(0, access(path2.c_str(), F_OK));
+}
+
+TEST_F(GnuDebugdataCacheTest, elf_uses_cached_data) {
+  // The cached data is a valid elf, which is used without decompressing
+  // anything from the elf file.
+  std::shared_ptr<MemoryBuffer> buffer(new MemoryBuffer);
+  buffer->Resize(sizeof(Elf64_Ehdr));
+  Elf64_Ehdr ehdr;
+  TestInitEhdr<Elf64_Ehdr>(&ehdr, ELFCLASS64, EM_AARCH64);
+  memcpy(buffer->GetPtr(0), &ehdr, sizeof(ehdr));
+  ASSERT_EQ(buffer.get(), GnuDebugdataCache::Add("build_id", buffer).get());
+
+  MemoryFake memory;
+  ElfFake elf(new MemoryFake);
+  ElfInterfaceFake* interface = new ElfInterfaceFake(&memory);
+  interface->FakeSetBuildID("build_id");
+  interface->FakeSetGnuDebugdataOffset(0x1000);
+  elf.FakeSetInterface(interface);
+  elf.InitGnuDebugdata();
+  ASSERT_TRUE(elf.gnu_debugdata_interface() != nullptr);
+  EXPECT_EQ(buffer.get(), elf.gnu_debugdata_interface()->memory());
+
+  // Without cached data, the empty section cannot be decompressed.
+  ElfFake other_elf(new MemoryFake);
+  interface = new ElfInterfaceFake(&memory);
+  interface->FakeSetBuildID("other_id");
+  interface->FakeSetGnuDebugdataOffset(0x1000);
+  other_elf.FakeSetInterface(interface);
+  other_elf.InitGnuDebugdata();
+  EXPECT_TRUE(other_elf.gnu_debugdata_interface() == nullptr);
+  EXPECT_EQ(1U, GnuDebugdataCache::Total());
+}
+
+TEST_F(GnuDebugdataCacheTest, disable_while_in_use) {
+  std::atomic_bool done = false;
+  std::thread thread([&done]() {
+    std::shared_ptr<MemoryBuffer> buffer(CreateElfBuffer(0x100, 0x12));
+    while (!done) {
+      GnuDebugdataCache::Add("build_id", buffer);
+      GnuDebugdataCache::Get("build_id");
+    }
+  });
+  for (size_t i = 0; i < 1000; i++) {
+    GnuDebugdataCache::SetEnabled(false);
+    GnuDebugdataCache::SetEnabled(true);
+  }
+  done = true;
+  thread.join();
+
+  // Data added while the cache is disabled is not kept.
+  GnuDebugdataCache::SetEnabled(false);
+  std::shared_ptr<MemoryBuffer> buffer(CreateElfBuffer(0x100, 0x12));
+  ASSERT_EQ(buffer.get(), GnuDebugdataCache::Add("build_id", buffer).get());
+  EXPECT_EQ(0U, GnuDebugdataCache::Total());
+  EXPECT_TRUE(GnuDebugdataCache::Get("build_id") == nullptr);
+}
+
+}  // namespace unwindstack
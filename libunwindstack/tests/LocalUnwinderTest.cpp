@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include <signal.h>
 #include <stdint.h>
+#include <sys/mman.h>
 
 #include <memory>
 #include <string>
@@ -27,7 +28,11 @@
 
 #include <android-base/stringprintf.h>
 
+#include <unwindstack/Elf.h>
 #include <unwindstack/LocalUnwinder.h>
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Regs.h>
+#include <unwindstack/Unwinder.h>
 
 namespace unwindstack {
 
@@ -58,14 +63,14 @@ static std::string ErrorMsg(const std::vector<const char*>& function_names,
     unwind += android::base::StringPrintf("#%02zu pc 0x%" PRIx64 " rel_pc 0x%" PRIx64, i++,
                                           frame.pc, frame.rel_pc);
     if (frame.map_info != nullptr) {
-      if (!frame.map_info->name.empty()) {
-        unwind += " " + frame.map_info->name;
+      if (!frame.map_name.empty()) {
+        unwind += " " + frame.map_name;
       } else {
-        unwind += android::base::StringPrintf(" 0x%" PRIx64 "-0x%" PRIx64, frame.map_info->start,
-                                              frame.map_info->end);
+        unwind += android::base::StringPrintf(" 0x%" PRIx64 "-0x%" PRIx64, frame.map_start,
+                                              frame.map_end);
       }
-      if (frame.map_info->offset != 0) {
-        unwind += android::base::StringPrintf(" offset 0x%" PRIx64, frame.map_info->offset);
+      if (frame.map_offset != 0) {
+        unwind += android::base::StringPrintf(" offset 0x%" PRIx64, frame.map_offset);
       }
     }
     if (!frame.function_name.empty()) {
@@ -142,6 +147,25 @@ class LocalUnwinderTest : public ::testing::Test {
   std::unique_ptr<LocalUnwinder> unwinder_;
 };
 
+TEST(LocalFrameDataTest, copies_map_fields) {
+  std::unique_ptr<MapInfo> map_info(
+      new MapInfo(nullptr, 0x1000, 0x2000, 0x300, PROT_READ | PROT_EXEC, "/system/lib/fake.so"));
+  LocalFrameData frame(map_info.get(), 0x1100, 0x400, "Function", 0x10);
+
+  // The fields stay usable once the map itself is freed.
+  map_info.reset();
+  EXPECT_EQ("/system/lib/fake.so", frame.map_name);
+  EXPECT_EQ(0x1000U, frame.map_start);
+  EXPECT_EQ(0x2000U, frame.map_end);
+  EXPECT_EQ(0x300U, frame.map_offset);
+  EXPECT_EQ(PROT_READ | PROT_EXEC, frame.map_flags);
+
+  LocalFrameData no_map(nullptr, 0x1100, 0x1100, "", 0);
+  EXPECT_EQ("", no_map.map_name);
+  EXPECT_EQ(0U, no_map.map_start);
+  EXPECT_EQ(0U, no_map.map_flags);
+}
+
 TEST_F(LocalUnwinderTest, local) {
   LocalOuterFunction(unwinder_.get(), false);
 }
@@ -204,4 +228,91 @@ TEST_F(LocalUnwinderTest, unwind_after_dlopen) {
   ASSERT_TRUE(expected_function_names.empty()) << ErrorMsg(expected_function_names, frame_info);
 }
 
+static Regs* g_regs;
+static CompactFrameData g_frames[256];
+static size_t g_num_frames;
+
+extern "C" void SignalSafeInnerFunction() {
+  g_num_frames = g_unwinder->UnwindFramePointers(g_regs, g_frames, 256);
+}
+
+extern "C" void SignalSafeMiddleFunction() {
+  SignalSafeInnerFunction();
+}
+
+extern "C" void SignalSafeOuterFunction() {
+  SignalSafeMiddleFunction();
+}
+
+static void SignalSafeCallerHandler(int, siginfo_t*, void*) {
+  SignalSafeOuterFunction();
+}
+
+static void VerifySignalSafeUnwind(std::vector<const char*> expected_function_names) {
+  // Look up the names after the unwind, the way a profiler would.
+  std::vector<LocalFrameData> frame_info;
+  for (size_t i = 0; i < g_num_frames; i++) {
+    const CompactFrameData& frame = g_frames[i];
+    std::string function_name;
+    uint64_t function_offset = 0;
+    frame.elf->GetFunctionName(frame.rel_pc, &function_name, &function_offset);
+    frame_info.emplace_back(frame.map_info, frame.pc, frame.rel_pc, function_name,
+                            function_offset);
+  }
+
+  for (auto& frame : frame_info) {
+    if (frame.function_name == expected_function_names.back()) {
+      expected_function_names.pop_back();
+      if (expected_function_names.empty()) {
+        break;
+      }
+    }
+  }
+
+  ASSERT_TRUE(expected_function_names.empty()) << ErrorMsg(expected_function_names, frame_info);
+}
+
+// The signal safe unwind only follows the frame pointers, which this code
+// keeps since it is compiled with optimizations turned off.
+TEST(LocalUnwinderSignalSafeTest, unwind) {
+  LocalUnwinder unwinder;
+  ASSERT_TRUE(unwinder.InitSignalSafe());
+  std::unique_ptr<Regs> regs(Regs::CreateFromLocal());
+  g_unwinder = &unwinder;
+  g_regs = regs.get();
+
+  g_num_frames = 0;
+  SignalSafeOuterFunction();
+  ASSERT_NO_FATAL_FAILURE(VerifySignalSafeUnwind(
+      {"SignalSafeOuterFunction", "SignalSafeMiddleFunction", "SignalSafeInnerFunction"}));
+
+  // The frames never go past the buffer.
+  g_num_frames = unwinder.UnwindFramePointers(regs.get(), g_frames, 1);
+  EXPECT_EQ(1U, g_num_frames);
+}
+
+TEST(LocalUnwinderSignalSafeTest, unwind_from_signal_handler) {
+  LocalUnwinder unwinder;
+  ASSERT_TRUE(unwinder.InitSignalSafe());
+  std::unique_ptr<Regs> regs(Regs::CreateFromLocal());
+  g_unwinder = &unwinder;
+  g_regs = regs.get();
+
+  struct sigaction act, oldact;
+  memset(&act, 0, sizeof(act));
+  act.sa_sigaction = SignalSafeCallerHandler;
+  act.sa_flags = SA_RESTART | SA_SIGINFO;
+  ASSERT_EQ(0, sigaction(SIGUSR1, &act, &oldact));
+
+  g_num_frames = 0;
+  raise(SIGUSR1);
+
+  ASSERT_EQ(0, sigaction(SIGUSR1, &oldact, nullptr));
+
+  // The code that raised the signal might not keep the frame pointers, so
+  // only the frames in the signal handler are certain to be found.
+  ASSERT_NO_FATAL_FAILURE(VerifySignalSafeUnwind(
+      {"SignalSafeOuterFunction", "SignalSafeMiddleFunction", "SignalSafeInnerFunction"}));
+}
+
 }  // namespace unwindstack
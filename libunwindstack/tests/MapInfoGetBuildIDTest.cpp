@@ -89,6 +89,31 @@ TEST_F(MapInfoGetBuildIDTest, from_elf_no_sign_extension) {
   EXPECT_EQ("faab1202", map_info_->GetPrintableBuildID());
 }
 
+TEST_F(MapInfoGetBuildIDTest, build_id_token) {
+  map_info_->elf.reset(elf_container_.release());
+  elf_interface_->FakeSetBuildID("FAKE_BUILD_ID");
+
+  // Maps with the same build id get the same token, whatever their name.
+  MapInfo other(nullptr, 0x30000, 0x40000, 0, PROT_READ, "/fake/other.so");
+  ElfFake* other_elf = new ElfFake(new MemoryFake);
+  ElfInterfaceFake* other_interface = new ElfInterfaceFake(nullptr);
+  other_elf->FakeSetInterface(other_interface);
+  other.elf.reset(other_elf);
+  other_interface->FakeSetBuildID("FAKE_BUILD_ID");
+
+  uint64_t token = map_info_->GetBuildIDToken();
+  EXPECT_NE(0U, token);
+  EXPECT_EQ(token, map_info_->GetBuildIDToken());
+  EXPECT_EQ(token, other.GetBuildIDToken());
+
+  // Without a build id, the name is used.
+  MapInfo no_build_id(nullptr, 0x1000, 0x2000, 0, PROT_READ, "/fake/no_build_id.so");
+  EXPECT_NE(0U, no_build_id.GetBuildIDToken());
+  EXPECT_NE(token, no_build_id.GetBuildIDToken());
+  MapInfo no_build_id_copy(nullptr, 0x5000, 0x6000, 0, PROT_READ, "/fake/no_build_id.so");
+  EXPECT_EQ(no_build_id.GetBuildIDToken(), no_build_id_copy.GetBuildIDToken());
+}
+
 void MapInfoGetBuildIDTest::MultipleThreadTest(std::string expected_build_id) {
   static constexpr size_t kNumConcurrentThreads = 100;
 
@@ -110,6 +110,20 @@ TEST_F(MapInfoGetElfTest, valid64) {
   EXPECT_EQ(ELFCLASS64, elf->class_type());
 }
 
+TEST_F(MapInfoGetElfTest, get_elf_if_created) {
+  MapInfo info(nullptr, 0x8000, 0x9000, 0, PROT_READ, "");
+
+  Elf64_Ehdr ehdr;
+  TestInitEhdr<Elf64_Ehdr>(&ehdr, ELFCLASS64, EM_AARCH64);
+  memory_->SetMemory(0x8000, &ehdr, sizeof(ehdr));
+
+  EXPECT_TRUE(info.GetElfIfCreated() == nullptr);
+
+  Elf* elf = info.GetElf(process_memory_, ARCH_ARM64);
+  ASSERT_TRUE(elf != nullptr);
+  EXPECT_EQ(elf, info.GetElfIfCreated());
+}
+
 TEST_F(MapInfoGetElfTest, invalid_arch_mismatch) {
   MapInfo info(nullptr, 0x3000, 0x4000, 0, PROT_READ, "");
 
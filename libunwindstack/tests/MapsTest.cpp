@@ -17,6 +17,11 @@
 #include <inttypes.h>
 #include <sys/mman.h>
 
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
 #include <gtest/gtest.h>
@@ -557,6 +562,63 @@ TEST(MapsTest, large_file) {
   }
 }
 
+// Verify a line larger than a single read, and a last line without a
+// newline, are parsed properly.
+TEST(MapsTest, file_long_line_no_newline) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+
+  std::string long_name = "/" + std::string(200000, 'a');
+  std::string file_data = "1000-2000 r-xp 1000 00:0 0 " + long_name + "\n";
+  file_data += "3000-4000 rw-p 0 00:0 0 /fake.so";
+  ASSERT_TRUE(android::base::WriteStringToFile(file_data, tf.path, 0660, getuid(), getgid()));
+
+  FileMaps maps(tf.path);
+
+  ASSERT_TRUE(maps.Parse());
+  ASSERT_EQ(2U, maps.Total());
+
+  MapInfo* info = maps.Get(0);
+  EXPECT_EQ(0x1000U, info->start);
+  EXPECT_EQ(0x2000U, info->end);
+  EXPECT_EQ(0x1000U, info->offset);
+  EXPECT_EQ(long_name, info->name);
+
+  info = maps.Get(1);
+  EXPECT_EQ(0x3000U, info->start);
+  EXPECT_EQ(0x4000U, info->end);
+  EXPECT_EQ(PROT_READ | PROT_WRITE, info->flags);
+  EXPECT_EQ("/fake.so", info->name);
+}
+
+TEST(MapsTest, parse_shares_names) {
+  BufferMaps maps(
+      "1000-2000 r--p 00000000 00:00 0 /system/lib/fake1.so\n"
+      "2000-3000 r-xp 00001000 00:00 0 /system/lib/fake1.so\n"
+      "3000-4000 rw-p 00000000 00:00 0 [anon:fake]\n"
+      "4000-5000 rw-p 00002000 00:00 0 /system/lib/fake1.so\n"
+      "5000-6000 rw-p 00000000 00:00 0 [anon:fake]\n");
+  ASSERT_TRUE(maps.Parse());
+  ASSERT_EQ(5U, maps.Total());
+
+  EXPECT_EQ("/system/lib/fake1.so", maps.Get(0)->name);
+  EXPECT_EQ("[anon:fake]", maps.Get(2)->name);
+  EXPECT_EQ(maps.Get(0)->name.c_str(), maps.Get(1)->name.c_str());
+  EXPECT_EQ(maps.Get(0)->name.c_str(), maps.Get(3)->name.c_str());
+  EXPECT_EQ(maps.Get(2)->name.c_str(), maps.Get(4)->name.c_str());
+  EXPECT_NE(maps.Get(0)->name.c_str(), maps.Get(2)->name.c_str());
+}
+
+TEST(MapsTest, map_info_name_constructors) {
+  std::string name("/system/lib/fake.so");
+  MapInfo info1(nullptr, 0x1000, 0x2000, 0, PROT_READ, name);
+  MapInfo info2(nullptr, 0x2000, 0x3000, 0, PROT_READ, "/system/lib/fake.so");
+  MapInfo info3(nullptr, 0x3000, 0x4000, 0, PROT_READ, info1.name);
+  EXPECT_EQ(name, info1.name);
+  EXPECT_EQ(name, info2.name);
+  EXPECT_EQ(info1.name.c_str(), info3.name.c_str());
+}
+
 TEST(MapsTest, find) {
   BufferMaps maps(
       "1000-2000 r--p 00000010 00:00 0 /system/lib/fake1.so\n"
@@ -615,4 +677,575 @@ TEST(MapsTest, find) {
   EXPECT_EQ("/system/lib/fake5.so", info->name);
 }
 
+TEST(MapsTest, find_after_sort) {
+  Maps maps;
+  maps.Add(0x5000, 0x6000, 0, PROT_READ, "map3", 0);
+  maps.Add(0x1000, 0x2000, 0, PROT_READ, "map1", 0);
+  maps.Add(0x3000, 0x4000, 0, PROT_READ, "map2", 0);
+  maps.Sort();
+
+  EXPECT_TRUE(maps.Find(0x500) == nullptr);
+  EXPECT_TRUE(maps.Find(0x2000) == nullptr);
+  EXPECT_TRUE(maps.Find(0x6000) == nullptr);
+
+  MapInfo* info = maps.Find(0x1500);
+  ASSERT_TRUE(info != nullptr);
+  EXPECT_EQ("map1", info->name);
+
+  info = maps.Find(0x3000);
+  ASSERT_TRUE(info != nullptr);
+  EXPECT_EQ("map2", info->name);
+
+  info = maps.Find(0x5fff);
+  ASSERT_TRUE(info != nullptr);
+  EXPECT_EQ("map3", info->name);
+}
+
+TEST(MapsTest, find_many_maps) {
+  Maps maps;
+  for (size_t i = 0; i < 5001; i++) {
+    maps.Add(0x10000 + i * 0x2000, 0x11000 + i * 0x2000, 0, PROT_READ, std::to_string(i), 0);
+  }
+
+  EXPECT_TRUE(maps.Find(0xffff) == nullptr);
+  for (size_t i = 0; i < 5001; i++) {
+    uint64_t start = 0x10000 + i * 0x2000;
+    MapInfo* info = maps.Find(start);
+    ASSERT_TRUE(info != nullptr) << "Failed at map " + std::to_string(i);
+    EXPECT_EQ(start, info->start) << "Failed at map " + std::to_string(i);
+    info = maps.Find(start + 0xfff);
+    ASSERT_TRUE(info != nullptr) << "Failed at map " + std::to_string(i);
+    EXPECT_EQ(start, info->start) << "Failed at map " + std::to_string(i);
+    EXPECT_TRUE(maps.Find(start + 0x1000) == nullptr) << "Failed at map " + std::to_string(i);
+  }
+}
+
+class RemoteUpdatableMapsFake : public RemoteUpdatableMaps {
+ public:
+  RemoteUpdatableMapsFake(const std::string& file) : RemoteUpdatableMaps(getpid()), file_(file) {}
+  virtual ~RemoteUpdatableMapsFake() = default;
+
+  const std::string GetMapsFile() const override { return file_; }
+
+  size_t TotalRetired() { return retired_maps_.size(); }
+
+ private:
+  const std::string file_;
+};
+
+TEST(MapsTest, remote_updatable_reparse) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r-xp 00000000 00:00 0 /fake1.so\n"
+                                       "3000-4000 r-xp 00000000 00:00 0 /fake2.so\n"
+                                       "5000-6000 r-xp 00000000 00:00 0 /fake3.so\n",
+                                       tf.path, 0660, getuid(), getgid()));
+
+  RemoteUpdatableMapsFake maps(tf.path);
+  ASSERT_TRUE(maps.Parse());
+  ASSERT_EQ(3U, maps.Total());
+  MapInfo* map1 = maps.Get(0);
+  MapInfo* map3 = maps.Get(2);
+  map1->load_bias = 0x100;
+
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r-xp 00000000 00:00 0 /fake1.so\n"
+                                       "2000-3000 r-xp 00000000 00:00 0 /fake4.so\n"
+                                       "5000-6000 r-xp 00000000 00:00 0 /fake3.so\n",
+                                       tf.path, 0660, getuid(), getgid()));
+  ASSERT_TRUE(maps.Reparse());
+  ASSERT_EQ(3U, maps.Total());
+  EXPECT_EQ(1U, maps.TotalRetired());
+
+  // The unchanged maps are the same objects, with the same state.
+  EXPECT_EQ(map1, maps.Get(0));
+  EXPECT_EQ(0x100U, maps.Get(0)->load_bias.load());
+  EXPECT_EQ(map3, maps.Get(2));
+
+  MapInfo* info = maps.Get(1);
+  ASSERT_TRUE(info != nullptr);
+  EXPECT_EQ(0x2000U, info->start);
+  EXPECT_EQ(0x3000U, info->end);
+  EXPECT_EQ("/fake4.so", info->name);
+  EXPECT_EQ(map1, info->prev_map);
+  EXPECT_EQ(info, map3->prev_map);
+
+  EXPECT_TRUE(maps.Find(0x3500) == nullptr);
+  EXPECT_EQ(info, maps.Find(0x2500));
+  EXPECT_EQ(map3, maps.Find(0x5500));
+
+  // The maps retired by the previous reparse are freed by the next one.
+  ASSERT_TRUE(maps.Reparse());
+  ASSERT_EQ(3U, maps.Total());
+  EXPECT_EQ(0U, maps.TotalRetired());
+  EXPECT_EQ(map1, maps.Get(0));
+  EXPECT_EQ(info, maps.Get(1));
+  EXPECT_EQ(map3, maps.Get(2));
+}
+
+TEST(MapsTest, remote_updatable_reparse_shares_names) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r--p 00000000 00:00 0 /fake1.so\n",
+                                       tf.path, 0660, getuid(), getgid()));
+
+  RemoteUpdatableMapsFake maps(tf.path);
+  ASSERT_TRUE(maps.Parse());
+  ASSERT_EQ(1U, maps.Total());
+
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r--p 00000000 00:00 0 /fake1.so\n"
+                                       "2000-3000 r-xp 00001000 00:00 0 /fake1.so\n",
+                                       tf.path, 0660, getuid(), getgid()));
+  ASSERT_TRUE(maps.Reparse());
+  ASSERT_EQ(2U, maps.Total());
+
+  // The new map uses the name of the map kept from the previous parse.
+  EXPECT_EQ("/fake1.so", maps.Get(1)->name);
+  EXPECT_EQ(maps.Get(0)->name.c_str(), maps.Get(1)->name.c_str());
+}
+
+TEST(MapsTest, remote_updatable_reparse_replaces_changed_maps) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r-xp 00000000 00:00 0 /fake1.so\n"
+                                       "3000-4000 r-xp 00000000 00:00 0 /fake2.so\n",
+                                       tf.path, 0660, getuid(), getgid()));
+
+  RemoteUpdatableMapsFake maps(tf.path);
+  ASSERT_TRUE(maps.Parse());
+  ASSERT_EQ(2U, maps.Total());
+  MapInfo* map2 = maps.Get(1);
+
+  // Every new map starts after all of the old maps, and a map with a
+  // different offset is not the same map.
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("3000-4000 r-xp 00001000 00:00 0 /fake2.so\n"
+                                       "5000-6000 r-xp 00000000 00:00 0 /fake3.so\n"
+                                       "7000-8000 r-xp 00000000 00:00 0 /fake4.so\n",
+                                       tf.path, 0660, getuid(), getgid()));
+  ASSERT_TRUE(maps.Reparse());
+  ASSERT_EQ(3U, maps.Total());
+  EXPECT_EQ(2U, maps.TotalRetired());
+
+  MapInfo* info = maps.Get(0);
+  ASSERT_TRUE(info != nullptr);
+  EXPECT_NE(map2, info);
+  EXPECT_EQ(0x3000U, info->start);
+  EXPECT_EQ(0x1000U, info->offset);
+  EXPECT_TRUE(info->prev_map == nullptr);
+  EXPECT_EQ("/fake3.so", maps.Get(1)->name);
+  EXPECT_EQ("/fake4.so", maps.Get(2)->name);
+  EXPECT_TRUE(maps.Find(0x1000) == nullptr);
+}
+
+TEST(MapsTest, remote_updatable_reparse_keeps_user_flags) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r-xp 00000000 00:00 0 /fake1.so\n"
+                                       "3000-4000 r-xp 00000000 00:00 0 /fake2.so\n"
+                                       "5000-6000 r-xp 00000000 00:00 0 /fake3.so\n",
+                                       tf.path, 0660, getuid(), getgid()));
+
+  RemoteUpdatableMapsFake maps(tf.path);
+  ASSERT_TRUE(maps.Parse());
+  ASSERT_EQ(3U, maps.Total());
+  for (size_t i = 0; i < maps.Total(); i++) {
+    maps.Get(i)->flags |= MAPS_FLAGS_FRAME_POINTER;
+  }
+  MapInfo* map1 = maps.Get(0);
+
+  // The first map is unchanged, the second map grows, and the third map
+  // is replaced by a different file.
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r-xp 00000000 00:00 0 /fake1.so\n"
+                                       "3000-4800 r-xp 00000000 00:00 0 /fake2.so\n"
+                                       "5000-6000 r-xp 00000000 00:00 0 /fake4.so\n",
+                                       tf.path, 0660, getuid(), getgid()));
+  ASSERT_TRUE(maps.Reparse());
+  ASSERT_EQ(3U, maps.Total());
+  EXPECT_EQ(2U, maps.TotalRetired());
+
+  EXPECT_EQ(map1, maps.Get(0));
+  EXPECT_EQ(PROT_READ | PROT_EXEC | MAPS_FLAGS_FRAME_POINTER, maps.Get(0)->flags);
+  EXPECT_EQ(0x4800U, maps.Get(1)->end);
+  EXPECT_EQ(PROT_READ | PROT_EXEC | MAPS_FLAGS_FRAME_POINTER, maps.Get(1)->flags);
+  EXPECT_EQ("/fake4.so", maps.Get(2)->name);
+  EXPECT_EQ(PROT_READ | PROT_EXEC, maps.Get(2)->flags);
+}
+
+class LocalUpdatableMapsFake : public LocalUpdatableMaps {
+ public:
+  LocalUpdatableMapsFake(const std::string& file) : file_(file) {}
+  virtual ~LocalUpdatableMapsFake() = default;
+
+  const std::string GetMapsFile() const override { return file_; }
+
+  size_t TotalPending() { return pending_maps_.size() + retired_maps_.size(); }
+
+  size_t TotalPendingSnapshots() {
+    return pending_snapshots_.size() + retired_snapshots_.size();
+  }
+
+ private:
+  const std::string file_;
+};
+
+TEST(MapsTest, local_updatable_reparse_waits_for_readers) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r-xp 00000000 00:00 0 /fake1.so\n"
+                                       "3000-4000 r-xp 00000000 00:00 0 /fake2.so\n",
+                                       tf.path, 0660, getuid(), getgid()));
+
+  LocalUpdatableMapsFake maps(tf.path);
+  ASSERT_TRUE(maps.Parse());
+  uint64_t epoch = maps.BeginRead();
+  MapInfo* info = maps.Find(0x3000);
+  ASSERT_TRUE(info != nullptr);
+
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r-xp 00000000 00:00 0 /fake1.so\n",
+                                       tf.path, 0660, getuid(), getgid()));
+  ASSERT_TRUE(maps.Reparse());
+  ASSERT_EQ(1U, maps.Total());
+  EXPECT_TRUE(maps.Find(0x3000) == nullptr);
+
+  // The retired map is kept while the reader that might hold it is active.
+  for (size_t i = 0; i < 4; i++) {
+    ASSERT_TRUE(maps.Reparse());
+    ASSERT_EQ(1U, maps.TotalPending());
+    EXPECT_EQ("/fake2.so", info->name);
+  }
+
+  maps.EndRead(epoch);
+  ASSERT_TRUE(maps.Reparse());
+  ASSERT_TRUE(maps.Reparse());
+  EXPECT_EQ(0U, maps.TotalPending());
+  ASSERT_EQ(1U, maps.Total());
+}
+
+TEST(MapsTest, local_updatable_find_shared) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r-xp 00000000 00:00 0 /fake1.so\n",
+                                       tf.path, 0660, getuid(), getgid()));
+
+  LocalUpdatableMapsFake maps(tf.path);
+  uint64_t epoch = maps.BeginRead();
+  EXPECT_TRUE(maps.FindShared(0x1000) == nullptr);
+  ASSERT_TRUE(maps.Parse());
+  MapInfo* map1 = maps.FindShared(0x1000);
+  ASSERT_TRUE(map1 != nullptr);
+  EXPECT_EQ("/fake1.so", map1->name);
+  EXPECT_TRUE(maps.FindShared(0x3000) == nullptr);
+
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("1000-2000 r-xp 00000000 00:00 0 /fake1.so\n"
+                                       "3000-4000 r-xp 00000000 00:00 0 /fake2.so\n",
+                                       tf.path, 0660, getuid(), getgid()));
+  // The snapshot does not change until the maps are reparsed.
+  EXPECT_TRUE(maps.FindShared(0x3000) == nullptr);
+  MapInfo* map2 = maps.ReparseAndFind(0x3000);
+  ASSERT_TRUE(map2 != nullptr);
+  EXPECT_EQ("/fake2.so", map2->name);
+  EXPECT_EQ(map2, maps.FindShared(0x3000));
+  EXPECT_EQ(map1, maps.FindShared(0x1000));
+
+  // A map that is already present does not cause a reparse.
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("3000-4000 r-xp 00000000 00:00 0 /fake2.so\n",
+                                       tf.path, 0660, getuid(), getgid()));
+  EXPECT_EQ(map1, maps.ReparseAndFind(0x1000));
+  EXPECT_EQ(2U, maps.Total());
+
+  // A missing map still causes a reparse.
+  EXPECT_TRUE(maps.ReparseAndFind(0x5000) == nullptr);
+  EXPECT_EQ(1U, maps.Total());
+  EXPECT_TRUE(maps.FindShared(0x1000) == nullptr);
+  EXPECT_EQ(map2, maps.FindShared(0x3000));
+
+  // The old snapshots are kept while the reader is active.
+  ASSERT_TRUE(maps.Reparse());
+  EXPECT_NE(0U, maps.TotalPendingSnapshots());
+  maps.EndRead(epoch);
+  ASSERT_TRUE(maps.Reparse());
+  ASSERT_TRUE(maps.Reparse());
+  EXPECT_EQ(0U, maps.TotalPendingSnapshots());
+  EXPECT_EQ(0U, maps.TotalPending());
+}
+
+TEST(MapsTest, local_updatable_find_shared_while_reparsing) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+
+  std::string maps1 =
+      "1000-2000 r-xp 00000000 00:00 0 /fake1.so\n"
+      "3000-4000 r-xp 00000000 00:00 0 /fake2.so\n";
+  std::string maps2 =
+      "1000-2000 r-xp 00000000 00:00 0 /fake1.so\n"
+      "3000-4000 r-xp 00001000 00:00 0 /fake2.so\n";
+  ASSERT_TRUE(android::base::WriteStringToFile(maps1, tf.path, 0660, getuid(), getgid()));
+
+  LocalUpdatableMapsFake maps(tf.path);
+  ASSERT_TRUE(maps.Parse());
+
+  std::atomic_bool done = false;
+  std::atomic_size_t found = 0;
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 4; i++) {
+    threads.emplace_back([&maps, &done, &found]() {
+      while (!done) {
+        uint64_t epoch = maps.BeginRead();
+        MapInfo* info = maps.FindShared(0x3000);
+        if (info != nullptr && info->name == "/fake2.so") {
+          found++;
+        }
+        maps.EndRead(epoch);
+      }
+    });
+  }
+
+  for (size_t i = 0; i < 200; i++) {
+    ASSERT_TRUE(android::base::WriteStringToFile((i % 2) ? maps1 : maps2, tf.path, 0660,
+                                                 getuid(), getgid()));
+    ASSERT_TRUE(maps.Reparse());
+  }
+  done = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_NE(0U, found.load());
+}
+
+TEST(MapsTest, local_updatable_prev_map_while_reparsing) {
+  TemporaryFile tf;
+  ASSERT_TRUE(tf.fd != -1);
+
+  // The last map is kept by every reparse, but the map before it changes.
+  std::string maps1 =
+      "1000-2000 r-xp 00000000 00:00 0 /fake1.so\n"
+      "2000-3000 r--p 00000000 00:00 0 /fake2.so\n"
+      "3000-4000 r-xp 00001000 00:00 0 /fake3.so\n";
+  std::string maps2 =
+      "1000-2000 r-xp 00000000 00:00 0 /fake1.so\n"
+      "2000-3000 r--p 00001000 00:00 0 /fake2.so\n"
+      "3000-4000 r-xp 00001000 00:00 0 /fake3.so\n";
+  ASSERT_TRUE(android::base::WriteStringToFile(maps1, tf.path, 0660, getuid(), getgid()));
+
+  LocalUpdatableMapsFake maps(tf.path);
+  ASSERT_TRUE(maps.Parse());
+  MapInfo* last_map = maps.Get(2);
+
+  std::atomic_bool done = false;
+  std::atomic_size_t found = 0;
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 4; i++) {
+    threads.emplace_back([&maps, &done, &found]() {
+      while (!done) {
+        uint64_t epoch = maps.BeginRead();
+        MapInfo* info = maps.FindShared(0x3000);
+        if (info != nullptr) {
+          MapInfo* prev_info = info->prev_map.load(std::memory_order_acquire);
+          if (prev_info != nullptr && prev_info->name == "/fake2.so") {
+            found++;
+          }
+        }
+        maps.EndRead(epoch);
+      }
+    });
+  }
+
+  for (size_t i = 0; i < 200; i++) {
+    ASSERT_TRUE(android::base::WriteStringToFile((i % 2) ? maps1 : maps2, tf.path, 0660,
+                                                 getuid(), getgid()));
+    ASSERT_TRUE(maps.Reparse());
+  }
+  done = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_NE(0U, found.load());
+  EXPECT_EQ(last_map, maps.Get(2));
+  EXPECT_EQ(maps.Get(1), last_map->prev_map.load());
+}
+
+TEST(MapsTest, apply_mmap) {
+  Maps maps;
+  maps.ApplyMmap(0x5000, 0x6000, 0, PROT_READ, "/fake2.so");
+  maps.ApplyMmap(0x1000, 0x2000, 0, PROT_READ | PROT_EXEC, "/fake1.so");
+  maps.ApplyMmap(0x8000, 0x9000, 0, PROT_READ, "/dev/fake_device");
+  ASSERT_EQ(3U, maps.Total());
+
+  MapInfo* info = maps.Get(0);
+  EXPECT_EQ(0x1000U, info->start);
+  EXPECT_EQ(0x2000U, info->end);
+  EXPECT_EQ(PROT_READ | PROT_EXEC, info->flags);
+  EXPECT_EQ("/fake1.so", info->name);
+  EXPECT_TRUE(info->prev_map == nullptr);
+  MapInfo* map1 = info;
+
+  info = maps.Get(1);
+  EXPECT_EQ(0x5000U, info->start);
+  EXPECT_EQ("/fake2.so", info->name);
+  EXPECT_EQ(map1, info->prev_map);
+
+  info = maps.Get(2);
+  EXPECT_EQ(PROT_READ | MAPS_FLAGS_DEVICE_MAP, info->flags);
+  EXPECT_EQ("/dev/fake_device", info->name);
+
+  EXPECT_EQ(map1, maps.Find(0x1800));
+  EXPECT_TRUE(maps.Find(0x3000) == nullptr);
+
+  // Mapping the same map again keeps the existing object.
+  maps.ApplyMmap(0x1000, 0x2000, 0, PROT_READ | PROT_EXEC, "/fake1.so");
+  ASSERT_EQ(3U, maps.Total());
+  EXPECT_EQ(map1, maps.Get(0));
+}
+
+TEST(MapsTest, apply_mmap_keeps_user_flags) {
+  Maps maps;
+  maps.ApplyMmap(0x1000, 0x2000, 0, PROT_READ | PROT_EXEC, "/fake1.so");
+  maps.ApplyMmap(0x3000, 0x4000, 0, PROT_READ | PROT_EXEC, "/fake2.so");
+  maps.Get(0)->flags |= MAPS_FLAGS_FRAME_POINTER;
+  maps.Get(1)->flags |= MAPS_FLAGS_FRAME_POINTER;
+  MapInfo* map1 = maps.Get(0);
+
+  // Mapping the same map again keeps the existing object and its flags.
+  maps.ApplyMmap(0x1000, 0x2000, 0, PROT_READ | PROT_EXEC, "/fake1.so");
+  ASSERT_EQ(2U, maps.Total());
+  EXPECT_EQ(map1, maps.Get(0));
+  EXPECT_EQ(PROT_READ | PROT_EXEC | MAPS_FLAGS_FRAME_POINTER, map1->flags);
+
+  // A larger map of the same file keeps the flags.
+  maps.ApplyMmap(0x3000, 0x5000, 0, PROT_READ | PROT_EXEC, "/fake2.so");
+  ASSERT_EQ(2U, maps.Total());
+  EXPECT_EQ(0x5000U, maps.Get(1)->end);
+  EXPECT_EQ(PROT_READ | PROT_EXEC | MAPS_FLAGS_FRAME_POINTER, maps.Get(1)->flags);
+
+  // A map of a different file does not.
+  maps.ApplyMmap(0x1000, 0x2000, 0, PROT_READ | PROT_EXEC, "/fake3.so");
+  ASSERT_EQ(2U, maps.Total());
+  EXPECT_EQ("/fake3.so", maps.Get(0)->name);
+  EXPECT_EQ(PROT_READ | PROT_EXEC, maps.Get(0)->flags);
+}
+
+TEST(MapsTest, apply_mmap_replaces_overlapping_maps) {
+  Maps maps;
+  maps.ApplyMmap(0x1000, 0x4000, 0, PROT_READ, "/fake1.so");
+  maps.ApplyMmap(0x5000, 0x6000, 0, PROT_READ, "/fake2.so");
+  maps.ApplyMmap(0x7000, 0x9000, 0, PROT_READ, "/fake3.so");
+  MapInfo* map1 = maps.Get(0);
+
+  // Replace the middle of the first map through the start of the third.
+  maps.ApplyMmap(0x2000, 0x8000, 0x1000, PROT_READ | PROT_WRITE, "/fake4.so");
+  ASSERT_EQ(3U, maps.Total());
+
+  MapInfo* info = maps.Get(0);
+  EXPECT_EQ(map1, info);
+  EXPECT_EQ(0x1000U, info->start);
+  EXPECT_EQ(0x2000U, info->end);
+
+  info = maps.Get(1);
+  EXPECT_EQ(0x2000U, info->start);
+  EXPECT_EQ(0x8000U, info->end);
+  EXPECT_EQ(0x1000U, info->offset);
+  EXPECT_EQ("/fake4.so", info->name);
+  EXPECT_EQ(map1, info->prev_map);
+
+  info = maps.Get(2);
+  EXPECT_EQ(0x8000U, info->start);
+  EXPECT_EQ(0x9000U, info->end);
+  EXPECT_EQ(0x1000U, info->offset);
+  EXPECT_EQ("/fake3.so", info->name);
+  EXPECT_EQ(maps.Get(1), info->prev_map);
+
+  EXPECT_EQ(maps.Get(1), maps.Find(0x5000));
+}
+
+TEST(MapsTest, apply_mmap_merges_maps) {
+  Maps maps;
+  maps.ApplyMmap(0x1000, 0x2000, 0, PROT_READ, "");
+  maps.ApplyMmap(0x3000, 0x4000, 0, PROT_READ, "");
+  maps.ApplyMmap(0x2000, 0x3000, 0, PROT_READ, "");
+  ASSERT_EQ(1U, maps.Total());
+  EXPECT_EQ(0x1000U, maps.Get(0)->start);
+  EXPECT_EQ(0x4000U, maps.Get(0)->end);
+
+  // File maps are only merged if the offsets are contiguous.
+  maps.ApplyMmap(0x5000, 0x6000, 0, PROT_READ, "/fake.so");
+  maps.ApplyMmap(0x6000, 0x7000, 0x1000, PROT_READ, "/fake.so");
+  maps.ApplyMmap(0x7000, 0x8000, 0x5000, PROT_READ, "/fake.so");
+  maps.ApplyMmap(0x8000, 0x9000, 0x6000, PROT_READ | PROT_EXEC, "/fake.so");
+  ASSERT_EQ(4U, maps.Total());
+  EXPECT_EQ(0x5000U, maps.Get(1)->start);
+  EXPECT_EQ(0x7000U, maps.Get(1)->end);
+  EXPECT_EQ(0x7000U, maps.Get(2)->start);
+  EXPECT_EQ(0x8000U, maps.Get(3)->start);
+}
+
+TEST(MapsTest, apply_munmap) {
+  Maps maps;
+  maps.ApplyMmap(0x1000, 0x4000, 0, PROT_READ, "/fake1.so");
+  maps.ApplyMmap(0x5000, 0x6000, 0, PROT_READ, "/fake2.so");
+  maps.ApplyMmap(0x7000, 0x9000, 0, PROT_READ, "/fake3.so");
+  MapInfo* map1 = maps.Get(0);
+  MapInfo* map3 = maps.Get(2);
+
+  // Split the first map.
+  maps.ApplyMunmap(0x2000, 0x3000);
+  ASSERT_EQ(4U, maps.Total());
+  EXPECT_EQ(map1, maps.Get(0));
+  EXPECT_EQ(0x2000U, map1->end);
+  MapInfo* info = maps.Get(1);
+  EXPECT_EQ(0x3000U, info->start);
+  EXPECT_EQ(0x4000U, info->end);
+  EXPECT_EQ(0x2000U, info->offset);
+  EXPECT_EQ("/fake1.so", info->name);
+  EXPECT_EQ(map1, info->prev_map);
+  EXPECT_TRUE(maps.Find(0x2500) == nullptr);
+
+  // Remove the second map and the start of the third.
+  maps.ApplyMunmap(0x4000, 0x8000);
+  ASSERT_EQ(3U, maps.Total());
+  info = maps.Get(2);
+  EXPECT_NE(map3, info);
+  EXPECT_EQ(0x8000U, info->start);
+  EXPECT_EQ(0x9000U, info->end);
+  EXPECT_EQ(0x1000U, info->offset);
+  EXPECT_EQ(maps.Get(1), info->prev_map);
+  EXPECT_TRUE(maps.Find(0x5000) == nullptr);
+
+  // Unmapping a range with no maps does nothing.
+  maps.ApplyMunmap(0xa000, 0xb000);
+  ASSERT_EQ(3U, maps.Total());
+}
+
+TEST(MapsTest, remote_updatable_apply_munmap_retires_maps) {
+  RemoteUpdatableMapsFake maps("");
+  maps.ApplyMmap(0x1000, 0x2000, 0, PROT_READ, "/fake1.so");
+  maps.ApplyMmap(0x3000, 0x4000, 0, PROT_READ, "/fake2.so");
+  MapInfo* map2 = maps.Get(1);
+
+  maps.ApplyMunmap(0x3000, 0x4000);
+  ASSERT_EQ(1U, maps.Total());
+  EXPECT_EQ(1U, maps.TotalRetired());
+  EXPECT_EQ("/fake2.so", map2->name);
+
+  maps.ApplyMunmap(0x5000, 0x6000);
+  EXPECT_EQ(0U, maps.TotalRetired());
+}
+
 }  // namespace unwindstack
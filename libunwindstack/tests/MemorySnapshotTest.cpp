@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <unwindstack/Memory.h>
+
+#include "MemoryFake.h"
+
+namespace unwindstack {
+
+TEST(MemorySnapshotTest, read_snapshot) {
+  std::vector<uint8_t> stack{1, 2, 3, 4, 5, 6, 7, 8};
+  MemorySnapshot memory(nullptr);
+  memory.Reset(stack.data(), 0x1000, 0x1000 + stack.size());
+
+  uint32_t value;
+  ASSERT_TRUE(memory.Read32(0x1000, &value));
+  EXPECT_EQ(0x04030201U, value);
+  ASSERT_TRUE(memory.Read32(0x1004, &value));
+  EXPECT_EQ(0x08070605U, value);
+
+  std::vector<uint8_t> buffer(16);
+  ASSERT_EQ(2U, memory.Read(0x1006, buffer.data(), buffer.size()));
+  EXPECT_EQ(7U, buffer[0]);
+  EXPECT_EQ(8U, buffer[1]);
+
+  ASSERT_FALSE(memory.Read32(0xfff, &value));
+  ASSERT_FALSE(memory.Read32(0x1008, &value));
+}
+
+TEST(MemorySnapshotTest, read_underlying_memory) {
+  std::shared_ptr<MemoryFake> process_memory(new MemoryFake);
+  process_memory->SetData32(0x1000, 0x11111111);
+  process_memory->SetData32(0x5000, 0x55555555);
+
+  std::vector<uint8_t> stack{1, 2, 3, 4};
+  MemorySnapshot memory(process_memory);
+  memory.Reset(stack.data(), 0x1000, 0x1000 + stack.size());
+
+  // The snapshot takes priority over the underlying memory.
+  uint32_t value;
+  ASSERT_TRUE(memory.Read32(0x1000, &value));
+  EXPECT_EQ(0x04030201U, value);
+  ASSERT_TRUE(memory.Read32(0x5000, &value));
+  EXPECT_EQ(0x55555555U, value);
+
+  memory.Reset(nullptr, 0, 0);
+  ASSERT_TRUE(memory.Read32(0x1000, &value));
+  EXPECT_EQ(0x11111111U, value);
+}
+
+}  // namespace unwindstack
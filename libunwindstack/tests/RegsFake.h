@@ -47,6 +47,8 @@ class RegsFake : public Regs {
     return true;
   }
 
+  bool StepFromFramePointer(Memory*) override { return false; }
+
   void IterateRegisters(std::function<void(const char*, uint64_t)>) override {}
 
   bool Is32Bit() {
@@ -88,6 +90,7 @@ class RegsImplFake : public RegsImpl<TypeParam> {
 
   uint64_t GetPcAdjustment(uint64_t, Elf*) override { return 0; }
   bool SetPcFromReturnAddress(Memory*) override { return false; }
+  bool StepFromFramePointer(Memory*) override { return false; }
   bool StepIfSignalHandler(uint64_t, Elf*, Memory*) override { return false; }
 
   Regs* Clone() override { return nullptr; }
@@ -20,6 +20,10 @@
 
 #include <unwindstack/Elf.h>
 #include <unwindstack/ElfInterface.h>
+#include <unwindstack/MachineArm.h>
+#include <unwindstack/MachineArm64.h>
+#include <unwindstack/MachineX86.h>
+#include <unwindstack/MachineX86_64.h>
 #include <unwindstack/MapInfo.h>
 #include <unwindstack/RegsArm.h>
 #include <unwindstack/RegsArm64.h>
@@ -321,4 +325,101 @@ TEST_F(RegsTest, clone) {
   }
 }
 
+TEST_F(RegsTest, x86_64_step_from_frame_pointer) {
+  RegsX86_64 regs;
+  regs[X86_64_REG_RSP] = 0x10000;
+  regs[X86_64_REG_RBP] = 0x10100;
+  regs[X86_64_REG_RIP] = 0x1000;
+  memory_->SetData64(0x10100, 0x10200);
+  memory_->SetData64(0x10108, 0x2000);
+  memory_->SetData64(0x10200, 0);
+  memory_->SetData64(0x10208, 0x3000);
+
+  ASSERT_TRUE(regs.StepFromFramePointer(memory_));
+  EXPECT_EQ(0x2000U, regs.pc());
+  EXPECT_EQ(0x10110U, regs.sp());
+  EXPECT_EQ(0x10200U, regs[X86_64_REG_RBP]);
+
+  // The last frame has no caller frame pointer.
+  ASSERT_TRUE(regs.StepFromFramePointer(memory_));
+  EXPECT_EQ(0x3000U, regs.pc());
+  EXPECT_EQ(0x10210U, regs.sp());
+  EXPECT_EQ(0U, regs[X86_64_REG_RBP]);
+
+  // A frame pointer below the sp.
+  EXPECT_FALSE(regs.StepFromFramePointer(memory_));
+  EXPECT_EQ(0x3000U, regs.pc());
+
+  // A caller frame pointer that is further down the stack.
+  regs[X86_64_REG_RSP] = 0x10000;
+  regs[X86_64_REG_RBP] = 0x10200;
+  memory_->SetData64(0x10200, 0x10100);
+  EXPECT_FALSE(regs.StepFromFramePointer(memory_));
+
+  // A frame pointer that is not aligned.
+  regs[X86_64_REG_RBP] = 0x10101;
+  EXPECT_FALSE(regs.StepFromFramePointer(memory_));
+
+  // A frame record that cannot be read.
+  regs[X86_64_REG_RBP] = 0x20000;
+  EXPECT_FALSE(regs.StepFromFramePointer(memory_));
+  EXPECT_EQ(0x3000U, regs.pc());
+  EXPECT_EQ(0x10000U, regs.sp());
+}
+
+TEST_F(RegsTest, x86_step_from_frame_pointer) {
+  RegsX86 regs;
+  regs[X86_REG_ESP] = 0x10000;
+  regs[X86_REG_EBP] = 0x10100;
+  regs[X86_REG_EIP] = 0x1000;
+  memory_->SetData32(0x10100, 0x10200);
+  memory_->SetData32(0x10104, 0x2000);
+  memory_->SetData32(0x10200, 0);
+  memory_->SetData32(0x10204, 0);
+
+  ASSERT_TRUE(regs.StepFromFramePointer(memory_));
+  EXPECT_EQ(0x2000U, regs.pc());
+  EXPECT_EQ(0x10108U, regs.sp());
+  EXPECT_EQ(0x10200U, regs[X86_REG_EBP]);
+
+  // A frame record without a return address.
+  EXPECT_FALSE(regs.StepFromFramePointer(memory_));
+  EXPECT_EQ(0x2000U, regs.pc());
+}
+
+TEST_F(RegsTest, arm64_step_from_frame_pointer) {
+  RegsArm64 regs;
+  regs[ARM64_REG_SP] = 0x10000;
+  regs[ARM64_REG_R29] = 0x10100;
+  regs[ARM64_REG_PC] = 0x1000;
+  regs[ARM64_REG_LR] = 0x2000;
+  memory_->SetData64(0x10100, 0x10200);
+  memory_->SetData64(0x10108, 0x2000);
+
+  ASSERT_TRUE(regs.StepFromFramePointer(memory_));
+  EXPECT_EQ(0x2000U, regs.pc());
+  EXPECT_EQ(0x10110U, regs.sp());
+  EXPECT_EQ(0x10200U, regs[ARM64_REG_R29]);
+
+  // A frame record that cannot be read.
+  EXPECT_FALSE(regs.StepFromFramePointer(memory_));
+  EXPECT_EQ(0x2000U, regs.pc());
+}
+
+TEST_F(RegsTest, step_from_frame_pointer_unsupported) {
+  RegsArm arm;
+  arm[ARM_REG_SP] = 0x10000;
+  arm[ARM_REG_R7] = 0x10100;
+  arm[ARM_REG_R11] = 0x10100;
+  memory_->SetData32(0x10100, 0x10200);
+  memory_->SetData32(0x10104, 0x2000);
+  EXPECT_FALSE(arm.StepFromFramePointer(memory_));
+
+  RegsMips mips;
+  EXPECT_FALSE(mips.StepFromFramePointer(memory_));
+
+  RegsMips64 mips64;
+  EXPECT_FALSE(mips64.StepFromFramePointer(memory_));
+}
+
 }  // namespace unwindstack
@@ -0,0 +1,373 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <unwindstack/Error.h>
+#include <unwindstack/MachineArm64.h>
+#include <unwindstack/MachineX86_64.h>
+#include <unwindstack/RegsArm64.h>
+#include <unwindstack/RegsX86_64.h>
+#include <unwindstack/SFrameSection.h>
+
+#include "MemoryFake.h"
+
+namespace unwindstack {
+
+class SFrameSectionTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    memory_.Clear();
+    process_memory_.Clear();
+    section_.reset(new SFrameSection(&memory_));
+    data_.clear();
+  }
+
+  template <typename Type>
+  void Append(Type value) {
+    uint8_t bytes[sizeof(value)];
+    memcpy(bytes, &value, sizeof(value));
+    data_.insert(data_.end(), bytes, bytes + sizeof(value));
+  }
+
+  void AppendHeader(uint8_t version, uint8_t flags, uint8_t abi, int8_t fixed_ra_offset,
+                    uint32_t num_fdes, uint32_t fres_size, uint32_t fres_offset) {
+    Append<uint16_t>(0xdee2);
+    Append<uint8_t>(version);
+    Append<uint8_t>(flags);
+    Append<uint8_t>(abi);
+    Append<int8_t>(0);
+    Append<int8_t>(fixed_ra_offset);
+    Append<uint8_t>(0);
+    Append<uint32_t>(num_fdes);
+    Append<uint32_t>(0);
+    Append<uint32_t>(fres_size);
+    Append<uint32_t>(0);
+    Append<uint32_t>(fres_offset);
+  }
+
+  void AppendFde(int32_t start, uint32_t size, uint32_t fre_offset, uint32_t num_fres,
+                 uint8_t info, uint8_t rep_size) {
+    Append<int32_t>(start);
+    Append<uint32_t>(size);
+    Append<uint32_t>(fre_offset);
+    Append<uint32_t>(num_fres);
+    Append<uint8_t>(info);
+    Append<uint8_t>(rep_size);
+    Append<uint16_t>(0);
+  }
+
+  void AppendBytes(std::vector<uint8_t> bytes) {
+    data_.insert(data_.end(), bytes.begin(), bytes.end());
+  }
+
+  bool InitSection() {
+    memory_.SetMemory(kSectionOffset, data_);
+    return section_->Init(kSectionOffset, data_.size(), 0);
+  }
+
+  // An amd64 section with a normal function at 0x1000 and a plt at
+  // 0x2000.
+  void InitX86_64() {
+    AppendHeader(2, 0x1, 3, -8, 2, 17, 40);
+    AppendFde(0x1000 - kSectionOffset, 0x100, 0, 3, 0, 0);
+    AppendFde(0x2000 - kSectionOffset, 0x20, 11, 2, 0x10, 16);
+    // cfa = sp + 8
+    AppendBytes({0x00, 0x03, 0x08});
+    // cfa = sp + 16, fp = [cfa - 16]
+    AppendBytes({0x01, 0x05, 0x10, 0xf0});
+    // cfa = fp + 16, fp = [cfa - 16]
+    AppendBytes({0x04, 0x04, 0x10, 0xf0});
+    // The plt entries.
+    AppendBytes({0x00, 0x03, 0x08});
+    AppendBytes({0x06, 0x03, 0x10});
+    ASSERT_TRUE(InitSection());
+  }
+
+  // Signed, since the fde start addresses are relative to the section.
+  static constexpr int32_t kSectionOffset = 0x5000;
+
+  MemoryFake memory_;
+  MemoryFake process_memory_;
+  std::unique_ptr<SFrameSection> section_;
+  std::vector<uint8_t> data_;
+};
+
+TEST_F(SFrameSectionTest, init_errors) {
+  AppendHeader(2, 0x1, 3, -8, 1, 3, 20);
+  AppendFde(0, 0x10, 0, 1, 0, 0);
+  AppendBytes({0x00, 0x03, 0x08});
+
+  // Bad magic.
+  data_[0] = 0;
+  EXPECT_FALSE(InitSection());
+  EXPECT_EQ(ERROR_UNWIND_INFO, section_->LastErrorCode());
+  data_[0] = 0xe2;
+
+  // Unknown version.
+  data_[2] = 3;
+  EXPECT_FALSE(InitSection());
+  EXPECT_EQ(ERROR_UNSUPPORTED, section_->LastErrorCode());
+  data_[2] = 2;
+
+  // The FDEs must be sorted.
+  data_[3] = 0;
+  EXPECT_FALSE(InitSection());
+  EXPECT_EQ(ERROR_UNSUPPORTED, section_->LastErrorCode());
+  data_[3] = 1;
+
+  // Big endian aarch64.
+  data_[4] = 1;
+  EXPECT_FALSE(InitSection());
+  EXPECT_EQ(ERROR_UNSUPPORTED, section_->LastErrorCode());
+  data_[4] = 3;
+
+  // The FREs go past the end of the section.
+  data_[16] = 4;
+  EXPECT_FALSE(InitSection());
+  EXPECT_EQ(ERROR_UNWIND_INFO, section_->LastErrorCode());
+  data_[16] = 3;
+
+  ASSERT_TRUE(InitSection());
+  EXPECT_EQ(2U, section_->version());
+  EXPECT_EQ(3U, section_->abi_arch());
+  EXPECT_EQ(1U, section_->num_fdes());
+}
+
+TEST_F(SFrameSectionTest, get_fde_from_pc) {
+  InitX86_64();
+
+  SFrameSection::Fde fde;
+  ASSERT_TRUE(section_->GetFdeFromPc(0x1000, &fde));
+  EXPECT_EQ(0x1000U, fde.pc_start);
+  EXPECT_EQ(0x1100U, fde.pc_end);
+  EXPECT_EQ(3U, fde.num_fres);
+  ASSERT_TRUE(section_->GetFdeFromPc(0x10ff, &fde));
+  EXPECT_EQ(0x1000U, fde.pc_start);
+  ASSERT_TRUE(section_->GetFdeFromPc(0x2010, &fde));
+  EXPECT_EQ(0x2000U, fde.pc_start);
+  EXPECT_EQ(0x2020U, fde.pc_end);
+
+  EXPECT_FALSE(section_->GetFdeFromPc(0xfff, &fde));
+  EXPECT_EQ(ERROR_UNWIND_INFO, section_->LastErrorCode());
+  EXPECT_FALSE(section_->GetFdeFromPc(0x1100, &fde));
+  EXPECT_FALSE(section_->GetFdeFromPc(0x2020, &fde));
+}
+
+TEST_F(SFrameSectionTest, get_fre_from_pc) {
+  InitX86_64();
+
+  SFrameSection::Fde fde;
+  SFrameSection::Fre fre;
+  ASSERT_TRUE(section_->GetFdeFromPc(0x1003, &fde));
+  ASSERT_TRUE(section_->GetFreFromPc(fde, 0x1003, &fre));
+  EXPECT_EQ(0x1001U, fre.pc_start);
+  EXPECT_EQ(0x1004U, fre.pc_end);
+  EXPECT_EQ(2U, fre.num_offsets);
+  EXPECT_EQ(16, fre.offsets[0]);
+  EXPECT_EQ(-16, fre.offsets[1]);
+
+  ASSERT_TRUE(section_->GetFreFromPc(fde, 0x1080, &fre));
+  EXPECT_EQ(0x1004U, fre.pc_start);
+  EXPECT_EQ(0x1100U, fre.pc_end);
+
+  // The range is in the repeated block that contains the pc.
+  ASSERT_TRUE(section_->GetFdeFromPc(0x2013, &fde));
+  ASSERT_TRUE(section_->GetFreFromPc(fde, 0x2013, &fre));
+  EXPECT_EQ(0x2010U, fre.pc_start);
+  EXPECT_EQ(0x2016U, fre.pc_end);
+  ASSERT_TRUE(section_->GetFreFromPc(fde, 0x2017, &fre));
+  EXPECT_EQ(0x2016U, fre.pc_start);
+  EXPECT_EQ(0x2020U, fre.pc_end);
+}
+
+TEST_F(SFrameSectionTest, step_x86_64) {
+  InitX86_64();
+
+  RegsX86_64 regs;
+  bool finished;
+
+  // The cfa is based on the sp, the frame pointer is not saved.
+  regs.set_pc(0x1000);
+  regs.set_sp(0x8000);
+  regs[X86_64_REG_RBP] = 0x1234;
+  process_memory_.SetData64(0x8000, 0x3000);
+  ASSERT_TRUE(section_->Step(0x1000, &regs, &process_memory_, &finished));
+  EXPECT_FALSE(finished);
+  EXPECT_EQ(0x3000U, regs.pc());
+  EXPECT_EQ(0x8008U, regs.sp());
+  EXPECT_EQ(0x1234U, regs[X86_64_REG_RBP]);
+
+  // The frame pointer is saved.
+  regs.set_sp(0x8000);
+  process_memory_.SetData64(0x8000, 0x9000);
+  process_memory_.SetData64(0x8008, 0x3100);
+  ASSERT_TRUE(section_->Step(0x1003, &regs, &process_memory_, &finished));
+  EXPECT_FALSE(finished);
+  EXPECT_EQ(0x3100U, regs.pc());
+  EXPECT_EQ(0x8010U, regs.sp());
+  EXPECT_EQ(0x9000U, regs[X86_64_REG_RBP]);
+
+  // The cfa is based on the frame pointer.
+  regs.set_sp(0x7000);
+  regs[X86_64_REG_RBP] = 0x8100;
+  process_memory_.SetData64(0x8100, 0x9100);
+  process_memory_.SetData64(0x8108, 0x3200);
+  ASSERT_TRUE(section_->Step(0x1050, &regs, &process_memory_, &finished));
+  EXPECT_FALSE(finished);
+  EXPECT_EQ(0x3200U, regs.pc());
+  EXPECT_EQ(0x8110U, regs.sp());
+  EXPECT_EQ(0x9100U, regs[X86_64_REG_RBP]);
+
+  // A return address of zero ends the unwind.
+  regs.set_sp(0x8200);
+  process_memory_.SetData64(0x8200, 0);
+  ASSERT_TRUE(section_->Step(0x1000, &regs, &process_memory_, &finished));
+  EXPECT_TRUE(finished);
+}
+
+TEST_F(SFrameSectionTest, step_x86_64_pc_mask) {
+  InitX86_64();
+
+  RegsX86_64 regs;
+  bool finished;
+  process_memory_.SetData64(0x8000, 0x3000);
+  process_memory_.SetData64(0x8008, 0x3100);
+
+  // Every 16 bytes of the plt use the same FREs.
+  regs.set_sp(0x8000);
+  ASSERT_TRUE(section_->Step(0x2014, &regs, &process_memory_, &finished));
+  EXPECT_EQ(0x3000U, regs.pc());
+  EXPECT_EQ(0x8008U, regs.sp());
+
+  regs.set_sp(0x8000);
+  ASSERT_TRUE(section_->Step(0x2017, &regs, &process_memory_, &finished));
+  EXPECT_EQ(0x3100U, regs.pc());
+  EXPECT_EQ(0x8010U, regs.sp());
+}
+
+TEST_F(SFrameSectionTest, step_errors) {
+  InitX86_64();
+
+  RegsX86_64 regs;
+  bool finished;
+  regs.set_pc(0x1000);
+  regs.set_sp(0x8000);
+
+  // No FDE for the pc.
+  EXPECT_FALSE(section_->Step(0x3000, &regs, &process_memory_, &finished));
+  EXPECT_EQ(ERROR_UNWIND_INFO, section_->LastErrorCode());
+
+  // The return address cannot be read.
+  EXPECT_FALSE(section_->Step(0x1000, &regs, &process_memory_, &finished));
+  EXPECT_EQ(ERROR_MEMORY_INVALID, section_->LastErrorCode());
+  EXPECT_EQ(0x8000U, section_->LastErrorAddress());
+  EXPECT_EQ(0x1000U, regs.pc());
+  EXPECT_EQ(0x8000U, regs.sp());
+
+  // The registers are for a different architecture.
+  RegsArm64 arm64_regs;
+  process_memory_.SetData64(0x8000, 0x3000);
+  EXPECT_FALSE(section_->Step(0x1000, &arm64_regs, &process_memory_, &finished));
+  EXPECT_EQ(ERROR_UNSUPPORTED, section_->LastErrorCode());
+}
+
+TEST_F(SFrameSectionTest, step_arm64) {
+  // The function starts are relative to the FDE.
+  AppendHeader(2, 0x5, 2, 0, 1, 19, 20);
+  AppendFde(0x1000 - (kSectionOffset + 28), 0x40, 0, 5, 0, 0);
+  // cfa = sp, the return address is in the link register.
+  AppendBytes({0x00, 0x03, 0x00});
+  // cfa = sp + 16, ra = [cfa - 8], fp = [cfa - 16]
+  AppendBytes({0x08, 0x07, 0x10, 0xf8, 0xf0});
+  // cfa = fp + 16, ra = [cfa - 8], fp = [cfa - 16]
+  AppendBytes({0x20, 0x06, 0x10, 0xf8, 0xf0});
+  // The outermost frame.
+  AppendBytes({0x30, 0x01});
+  // The return address is signed.
+  AppendBytes({0x38, 0x85, 0x10, 0xf8});
+  ASSERT_TRUE(InitSection());
+
+  RegsArm64 regs;
+  bool finished;
+
+  regs.set_sp(0x8000);
+  regs[ARM64_REG_LR] = 0x3000;
+  regs[ARM64_REG_R29] = 0x1234;
+  ASSERT_TRUE(section_->Step(0x1004, &regs, &process_memory_, &finished));
+  EXPECT_FALSE(finished);
+  EXPECT_EQ(0x3000U, regs.pc());
+  EXPECT_EQ(0x8000U, regs.sp());
+  EXPECT_EQ(0x1234U, regs[ARM64_REG_R29]);
+
+  process_memory_.SetData64(0x8000, 0x9000);
+  process_memory_.SetData64(0x8008, 0x3100);
+  ASSERT_TRUE(section_->Step(0x1010, &regs, &process_memory_, &finished));
+  EXPECT_FALSE(finished);
+  EXPECT_EQ(0x3100U, regs.pc());
+  EXPECT_EQ(0x8010U, regs.sp());
+  EXPECT_EQ(0x9000U, regs[ARM64_REG_R29]);
+
+  regs.set_sp(0x7000);
+  regs[ARM64_REG_R29] = 0x8000;
+  ASSERT_TRUE(section_->Step(0x1020, &regs, &process_memory_, &finished));
+  EXPECT_EQ(0x3100U, regs.pc());
+  EXPECT_EQ(0x8010U, regs.sp());
+
+  ASSERT_TRUE(section_->Step(0x1030, &regs, &process_memory_, &finished));
+  EXPECT_TRUE(finished);
+  EXPECT_EQ(0U, regs.pc());
+
+  EXPECT_FALSE(section_->Step(0x1038, &regs, &process_memory_, &finished));
+  EXPECT_EQ(ERROR_UNSUPPORTED, section_->LastErrorCode());
+}
+
+TEST_F(SFrameSectionTest, version1) {
+  // Version 1 FDEs do not have the repeated block size or the padding.
+  AppendHeader(1, 0x1, 3, -8, 1, 8, 17);
+  Append<int32_t>(0x1000 - kSectionOffset);
+  Append<uint32_t>(0x100);
+  Append<uint32_t>(0);
+  Append<uint32_t>(2);
+  Append<uint8_t>(1);
+  // Two byte start addresses.
+  AppendBytes({0x00, 0x00, 0x03, 0x08});
+  AppendBytes({0x80, 0x00, 0x03, 0x10});
+  ASSERT_TRUE(InitSection());
+  EXPECT_EQ(1U, section_->version());
+
+  RegsX86_64 regs;
+  bool finished;
+  process_memory_.SetData64(0x8000, 0x3000);
+  process_memory_.SetData64(0x8008, 0x3100);
+
+  regs.set_sp(0x8000);
+  ASSERT_TRUE(section_->Step(0x107f, &regs, &process_memory_, &finished));
+  EXPECT_EQ(0x3000U, regs.pc());
+
+  regs.set_sp(0x8000);
+  ASSERT_TRUE(section_->Step(0x1080, &regs, &process_memory_, &finished));
+  EXPECT_EQ(0x3100U, regs.pc());
+  EXPECT_EQ(0x8010U, regs.sp());
+}
+
+}  // namespace unwindstack
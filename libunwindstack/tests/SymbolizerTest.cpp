@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <unwindstack/Elf.h>
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Maps.h>
+#include <unwindstack/Symbolizer.h>
+#include <unwindstack/Unwinder.h>
+
+#include "ElfFake.h"
+
+namespace unwindstack {
+
+class SymbolizerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ElfInterfaceFake::FakeClear();
+    elf_ = new ElfFake(nullptr);
+    elf_->FakeSetInterface(new ElfInterfaceFake(nullptr));
+    map_info_.reset(new MapInfo(nullptr, 0x1000, 0x2000, 0, PROT_READ | PROT_EXEC, "libfake.so"));
+    map_info_->elf.reset(elf_);
+  }
+
+  void TearDown() override { ElfInterfaceFake::FakeClear(); }
+
+  ElfFake* elf_;
+  std::unique_ptr<MapInfo> map_info_;
+};
+
+TEST_F(SymbolizerTest, each_address_found_once_in_order) {
+  Symbolizer symbolizer;
+  symbolizer.Add(elf_, 0x300);
+  symbolizer.Add(elf_, 0x100);
+  symbolizer.Add(elf_, 0x300);
+  symbolizer.Add(elf_, 0x200);
+  symbolizer.Add(elf_, 0x100);
+
+  // The addresses are looked up in sorted order.
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Function1", 1));
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Function2", 2));
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Function3", 3));
+  symbolizer.Resolve();
+  EXPECT_EQ(3U, symbolizer.NumFunctions());
+
+  const FunctionInfo* function = symbolizer.Find(elf_, 0x100);
+  ASSERT_TRUE(function != nullptr);
+  EXPECT_EQ("Function1", function->name);
+  EXPECT_EQ(1U, function->offset);
+  function = symbolizer.Find(elf_, 0x200);
+  ASSERT_TRUE(function != nullptr);
+  EXPECT_EQ("Function2", function->name);
+  function = symbolizer.Find(elf_, 0x300);
+  ASSERT_TRUE(function != nullptr);
+  EXPECT_EQ("Function3", function->name);
+  EXPECT_EQ(3U, function->offset);
+
+  EXPECT_TRUE(symbolizer.Find(elf_, 0x400) == nullptr);
+}
+
+TEST_F(SymbolizerTest, results_kept_across_resolves) {
+  Symbolizer symbolizer;
+  symbolizer.Add(elf_, 0x100);
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Function1", 0));
+  symbolizer.Resolve();
+
+  // Only the new address is looked up.
+  symbolizer.Add(elf_, 0x100);
+  symbolizer.Add(elf_, 0x200);
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Function2", 0));
+  symbolizer.Resolve();
+
+  ASSERT_TRUE(symbolizer.Find(elf_, 0x100) != nullptr);
+  EXPECT_EQ("Function1", symbolizer.Find(elf_, 0x100)->name);
+  ASSERT_TRUE(symbolizer.Find(elf_, 0x200) != nullptr);
+  EXPECT_EQ("Function2", symbolizer.Find(elf_, 0x200)->name);
+
+  symbolizer.Clear();
+  EXPECT_EQ(0U, symbolizer.NumFunctions());
+  EXPECT_TRUE(symbolizer.Find(elf_, 0x100) == nullptr);
+}
+
+TEST_F(SymbolizerTest, unknown_functions_with_threads) {
+  std::vector<std::unique_ptr<ElfFake>> elfs;
+  Symbolizer symbolizer;
+  symbolizer.SetNumThreads(4);
+  for (size_t i = 0; i < 8; i++) {
+    ElfFake* elf = new ElfFake(nullptr);
+    elf->FakeSetValid(false);
+    elfs.emplace_back(elf);
+    for (uint64_t addr = 0; addr < 0x100; addr += 4) {
+      symbolizer.Add(elf, addr);
+    }
+  }
+  symbolizer.Resolve();
+  EXPECT_EQ(8U * 0x40, symbolizer.NumFunctions());
+
+  for (auto& elf : elfs) {
+    const FunctionInfo* function = symbolizer.Find(elf.get(), 0x80);
+    ASSERT_TRUE(function != nullptr);
+    EXPECT_EQ("", function->name);
+    EXPECT_EQ(0U, function->offset);
+  }
+}
+
+TEST_F(SymbolizerTest, compact_frames) {
+  ElfFake jit_elf(nullptr);
+  jit_elf.FakeSetInterface(new ElfInterfaceFake(nullptr));
+
+  // An elf frame uses the relative pc, a jit frame uses the absolute pc.
+  CompactFrameData elf_frame{0x1200, 0x200, 0x8000, map_info_.get(), elf_};
+  CompactFrameData jit_frame{0x1300, 0x300, 0x8010, map_info_.get(), &jit_elf};
+  CompactFrameData dex_frame{0x1400, 0x400, 0x8020, map_info_.get(), nullptr};
+  CompactFrameData no_map_frame{0x9000, 0x9000, 0x8030, nullptr, nullptr};
+
+  Symbolizer symbolizer;
+  symbolizer.Add(elf_frame);
+  symbolizer.Add(jit_frame);
+  symbolizer.Add(dex_frame);
+  symbolizer.Add(no_map_frame);
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Function", 0));
+  symbolizer.Resolve();
+
+  ASSERT_TRUE(symbolizer.Find(elf_, 0x200) != nullptr);
+  ASSERT_TRUE(symbolizer.Find(elf_frame) != nullptr);
+  ASSERT_TRUE(symbolizer.Find(&jit_elf, 0x1300) != nullptr);
+  ASSERT_TRUE(symbolizer.Find(jit_frame) != nullptr);
+  EXPECT_TRUE(symbolizer.Find(&jit_elf, 0x300) == nullptr);
+
+  // Without any dex files, a dex frame is resolved to an unknown method.
+  const FunctionInfo* function = symbolizer.Find(dex_frame);
+  ASSERT_TRUE(function != nullptr);
+  EXPECT_EQ("", function->name);
+
+  EXPECT_TRUE(symbolizer.Find(no_map_frame) == nullptr);
+  EXPECT_EQ(3U, symbolizer.NumFunctions());
+}
+
+}  // namespace unwindstack
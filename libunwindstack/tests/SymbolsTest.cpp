@@ -32,6 +32,7 @@
 #include <android-base/test_utils.h>
 #include <gtest/gtest.h>
 
+#include <unwindstack/ElfInterface.h>
 #include <unwindstack/Memory.h>
 
 #include "MemoryFake.h"
@@ -362,9 +363,62 @@ TYPED_TEST_P(SymbolsTest, get_global) {
   EXPECT_EQ(4U, offset);
 }
 
+TYPED_TEST_P(SymbolsTest, get_names) {
+  Symbols symbols(0x1000, sizeof(TypeParam) * 3, sizeof(TypeParam), 0x2000, 0x500);
+
+  TypeParam sym;
+  uint64_t offset = 0x1000;
+  std::string fake_name;
+
+  this->InitSym(&sym, 0x5000, 0x10, 0x40);
+  this->memory_.SetMemory(offset, &sym, sizeof(sym));
+  fake_name = "function_one";
+  this->memory_.SetMemory(0x2040, fake_name.c_str(), fake_name.size() + 1);
+  offset += sizeof(sym);
+
+  this->InitSym(&sym, 0x3004, 0x200, 0x100);
+  this->memory_.SetMemory(offset, &sym, sizeof(sym));
+  fake_name = "function_two";
+  this->memory_.SetMemory(0x2100, fake_name.c_str(), fake_name.size() + 1);
+  offset += sizeof(sym);
+
+  this->InitSym(&sym, 0xa010, 0x20, 0x230);
+  this->memory_.SetMemory(offset, &sym, sizeof(sym));
+  fake_name = "function_three";
+  this->memory_.SetMemory(0x2230, fake_name.c_str(), fake_name.size() + 1);
+
+  std::vector<uint64_t> addrs{0x1000, 0x3005, 0x3008, 0x5004, 0x6000, 0xa011};
+  std::vector<FunctionInfo> functions(addrs.size());
+  // A function that was already found is left alone.
+  functions[2].name = "function_found";
+  functions[2].offset = 0x10;
+  symbols.GetNames<TypeParam>(addrs.data(), addrs.size(), &this->memory_, functions.data());
+
+  EXPECT_EQ("", functions[0].name);
+  EXPECT_EQ(0U, functions[0].offset);
+  EXPECT_EQ("function_two", functions[1].name);
+  EXPECT_EQ(1U, functions[1].offset);
+  EXPECT_EQ("function_found", functions[2].name);
+  EXPECT_EQ(0x10U, functions[2].offset);
+  EXPECT_EQ("function_one", functions[3].name);
+  EXPECT_EQ(4U, functions[3].offset);
+  EXPECT_EQ("", functions[4].name);
+  EXPECT_EQ(0U, functions[4].offset);
+  EXPECT_EQ("function_three", functions[5].name);
+  EXPECT_EQ(1U, functions[5].offset);
+
+  // All of the symbols are cached now.
+  std::vector<uint8_t> zero(sizeof(TypeParam) * 3);
+  this->memory_.SetMemory(0x1000, zero.data(), zero.size());
+  std::string name;
+  uint64_t func_offset;
+  EXPECT_TRUE(symbols.GetName<TypeParam>(0xa01a, &this->memory_, &name, &func_offset));
+  EXPECT_EQ(0xaU, func_offset);
+}
+
 REGISTER_TYPED_TEST_CASE_P(SymbolsTest, function_bounds_check, no_symbol, multiple_entries,
                            multiple_entries_nonstandard_size, symtab_value_out_of_bounds,
-                           symtab_read_cached, get_global);
+                           symtab_read_cached, get_global, get_names);
 
 typedef ::testing::Types<Elf32_Sym, Elf64_Sym> SymbolsTestTypes;
 INSTANTIATE_TYPED_TEST_CASE_P(, SymbolsTest, SymbolsTestTypes);
@@ -24,7 +24,10 @@
 
 #include <gtest/gtest.h>
 
+#include <unwindstack/BatchUnwinder.h>
 #include <unwindstack/Elf.h>
+#include <unwindstack/MachineArm64.h>
+#include <unwindstack/MachineX86_64.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
 #include <unwindstack/Regs.h>
@@ -1426,4 +1429,656 @@ TEST_F(UnwinderTest, format_frame_by_arch) {
   }
 }
 
+
+TEST_F(UnwinderTest, compact_frames) {
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  ElfInterfaceFake::FakePushStepData(StepData(0x23102, 0x10010, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0x50000, 0x10020, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+
+  Unwinder unwinder(64, maps_.get(), &regs_, process_memory_);
+  unwinder.SetCompactFrames(true);
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_INVALID_MAP, unwinder.LastErrorCode());
+  EXPECT_EQ(0U, unwinder.NumFrames());
+
+  const std::vector<CompactFrameData>& compact_frames = unwinder.compact_frames();
+  ASSERT_EQ(3U, compact_frames.size());
+  MapInfo* libc_info = maps_->Find(0x1000);
+  MapInfo* libanother_info = maps_->Find(0x23000);
+
+  EXPECT_EQ(0x1000U, compact_frames[0].pc);
+  EXPECT_EQ(0U, compact_frames[0].rel_pc);
+  EXPECT_EQ(0x10000U, compact_frames[0].sp);
+  EXPECT_EQ(libc_info, compact_frames[0].map_info);
+  EXPECT_EQ(libc_info->elf.get(), compact_frames[0].elf);
+
+  EXPECT_EQ(0x23100U, compact_frames[1].pc);
+  EXPECT_EQ(0x100U, compact_frames[1].rel_pc);
+  EXPECT_EQ(0x10010U, compact_frames[1].sp);
+  EXPECT_EQ(libanother_info, compact_frames[1].map_info);
+  EXPECT_EQ(libanother_info->elf.get(), compact_frames[1].elf);
+
+  EXPECT_EQ(0x50000U, compact_frames[2].pc);
+  EXPECT_EQ(0x50000U, compact_frames[2].rel_pc);
+  EXPECT_EQ(0x10020U, compact_frames[2].sp);
+  EXPECT_TRUE(compact_frames[2].map_info == nullptr);
+  EXPECT_TRUE(compact_frames[2].elf == nullptr);
+
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Frame0", 0));
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Frame1", 1));
+  std::vector<FrameData> frames;
+  unwinder.Symbolize(compact_frames, &frames);
+  ASSERT_EQ(3U, frames.size());
+
+  EXPECT_EQ(0U, frames[0].num);
+  EXPECT_EQ(0x1000U, frames[0].pc);
+  EXPECT_EQ(0x10000U, frames[0].sp);
+  EXPECT_EQ("Frame0", frames[0].function_name);
+  EXPECT_EQ(0U, frames[0].function_offset);
+  EXPECT_EQ("/system/fake/libc.so", frames[0].map_name);
+  EXPECT_EQ(0x1000U, frames[0].map_start);
+  EXPECT_EQ(0x8000U, frames[0].map_end);
+
+  EXPECT_EQ(1U, frames[1].num);
+  EXPECT_EQ(0x100U, frames[1].rel_pc);
+  EXPECT_EQ(0x23100U, frames[1].pc);
+  EXPECT_EQ("Frame1", frames[1].function_name);
+  EXPECT_EQ(1U, frames[1].function_offset);
+  EXPECT_EQ("/fake/libanother.so", frames[1].map_name);
+
+  EXPECT_EQ(2U, frames[2].num);
+  EXPECT_EQ(0x50000U, frames[2].pc);
+  EXPECT_EQ("", frames[2].function_name);
+  EXPECT_EQ("", frames[2].map_name);
+  EXPECT_EQ(0U, frames[2].map_start);
+  EXPECT_EQ(0U, frames[2].map_end);
+}
+
+TEST_F(UnwinderTest, symbolize_looks_up_each_pc_once) {
+  MapInfo* libc_info = maps_->Find(0x1000);
+  Elf* elf = libc_info->elf.get();
+  std::vector<std::vector<CompactFrameData>> stacks{
+      {{0x1000, 0, 0x10000, libc_info, elf}, {0x1100, 0x100, 0x10010, libc_info, elf}},
+      {{0x1100, 0x100, 0x10000, libc_info, elf}},
+      {{0x1000, 0, 0x10000, libc_info, elf}, {0x1100, 0x100, 0x10010, libc_info, elf}},
+  };
+
+  // Only one name is available for each unique pc.
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Frame0", 0));
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Frame1", 1));
+
+  Unwinder unwinder(64, maps_.get(), &regs_, process_memory_);
+  std::vector<std::vector<FrameData>> frames;
+  unwinder.Symbolize(stacks, &frames);
+  ASSERT_EQ(3U, frames.size());
+
+  ASSERT_EQ(2U, frames[0].size());
+  EXPECT_EQ("Frame0", frames[0][0].function_name);
+  EXPECT_EQ("Frame1", frames[0][1].function_name);
+  EXPECT_EQ(1U, frames[0][1].num);
+  ASSERT_EQ(1U, frames[1].size());
+  EXPECT_EQ("Frame1", frames[1][0].function_name);
+  EXPECT_EQ(1U, frames[1][0].function_offset);
+  EXPECT_EQ(0U, frames[1][0].num);
+  ASSERT_EQ(2U, frames[2].size());
+  EXPECT_EQ("Frame0", frames[2][0].function_name);
+  EXPECT_EQ("Frame1", frames[2][1].function_name);
+  EXPECT_EQ("/system/fake/libc.so", frames[2][1].map_name);
+}
+
+TEST_F(UnwinderTest, symbolize_reuses_frames) {
+  MapInfo* libc_info = maps_->Find(0x1000);
+  Elf* elf = libc_info->elf.get();
+  std::vector<CompactFrameData> compact_frames{{0x1000, 0, 0x10000, libc_info, elf},
+                                               {0x1100, 0x100, 0x10010, libc_info, elf}};
+
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Frame0", 0));
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Frame1", 1));
+
+  Unwinder unwinder(64, maps_.get(), &regs_, process_memory_);
+  std::vector<FrameData> frames;
+  unwinder.Symbolize(compact_frames, &frames);
+  ASSERT_EQ(2U, frames.size());
+  EXPECT_EQ("Frame0", frames[0].function_name);
+  EXPECT_EQ("Frame1", frames[1].function_name);
+  EXPECT_EQ(1U, frames[1].function_offset);
+
+  // The first frame has no map, and no name is found for the second.
+  std::vector<CompactFrameData> other_frames{{0x50000, 0x50000, 0x10000, nullptr, nullptr},
+                                             {0x1200, 0x200, 0x10010, libc_info, elf}};
+  unwinder.Symbolize(other_frames, &frames);
+  ASSERT_EQ(2U, frames.size());
+  EXPECT_EQ(0x50000U, frames[0].pc);
+  EXPECT_EQ("", frames[0].function_name);
+  EXPECT_EQ(0U, frames[0].function_offset);
+  EXPECT_EQ("", frames[0].map_name);
+  EXPECT_EQ(0U, frames[0].map_start);
+  EXPECT_EQ(0U, frames[0].map_end);
+  EXPECT_EQ(0U, frames[0].map_flags);
+  EXPECT_EQ(0x1200U, frames[1].pc);
+  EXPECT_EQ("", frames[1].function_name);
+  EXPECT_EQ(0U, frames[1].function_offset);
+  EXPECT_EQ("/system/fake/libc.so", frames[1].map_name);
+
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Frame0", 0));
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Frame1", 1));
+  unwinder.Symbolize(compact_frames, &frames);
+  ASSERT_EQ(2U, frames.size());
+  EXPECT_EQ("Frame1", frames[1].function_name);
+
+  // Without names, none are left from the last call.
+  unwinder.SetResolveNames(false);
+  unwinder.Symbolize(compact_frames, &frames);
+  ASSERT_EQ(2U, frames.size());
+  EXPECT_EQ("", frames[0].function_name);
+  EXPECT_EQ("", frames[0].map_name);
+  EXPECT_EQ(0x1000U, frames[0].map_start);
+  EXPECT_EQ("", frames[1].function_name);
+  EXPECT_EQ(0U, frames[1].function_offset);
+}
+
+TEST_F(UnwinderTest, batch_unwind) {
+  RegsFake regs_libanother(5);
+  regs_libanother.FakeSetArch(ARCH_ARM);
+  regs_libanother.FakeSetReturnAddressValid(false);
+  regs_libanother.set_pc(0x23000);
+  regs_libanother.set_sp(0x10000);
+
+  RegsFake regs_libc(5);
+  regs_libc.FakeSetArch(ARCH_ARM);
+  regs_libc.FakeSetReturnAddressValid(false);
+  regs_libc.set_pc(0x1000);
+  regs_libc.set_sp(0x10000);
+
+  std::vector<uint8_t> stack(0x20);
+  std::vector<UnwindSample> samples(2);
+  samples[0].regs = &regs_libanother;
+  samples[1].regs = &regs_libc;
+  for (auto& sample : samples) {
+    sample.stack = stack.data();
+    sample.stack_start = 0x10000;
+    sample.stack_size = stack.size();
+  }
+
+  // The samples are unwound in pc order, so the libc sample is first.
+  ElfInterfaceFake::FakePushStepData(StepData(0x1102, 0x10010, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+
+  BatchUnwinder unwinder(64, maps_.get(), process_memory_);
+  unwinder.SetResolveNames(false);
+  unwinder.UnwindBatch(samples.data(), samples.size());
+
+  EXPECT_EQ(ERROR_NONE, samples[0].error_code);
+  ASSERT_EQ(1U, samples[0].frames.size());
+  EXPECT_EQ(0x23000U, samples[0].frames[0].pc);
+  EXPECT_EQ(0x23000U, samples[0].frames[0].map_start);
+  EXPECT_EQ("", samples[0].frames[0].function_name);
+
+  EXPECT_EQ(ERROR_NONE, samples[1].error_code);
+  ASSERT_EQ(2U, samples[1].frames.size());
+  EXPECT_EQ(0x1000U, samples[1].frames[0].pc);
+  EXPECT_EQ(0x1100U, samples[1].frames[1].pc);
+  EXPECT_EQ(0x10010U, samples[1].frames[1].sp);
+  EXPECT_EQ(0x1000U, samples[1].frames[1].map_start);
+
+  // Unwinding the same samples again replaces their frames.
+  regs_libanother.set_pc(0x1000);
+  regs_libanother.set_sp(0x10000);
+  regs_libc.set_pc(0x20000);
+  regs_libc.set_sp(0x10000);
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+  unwinder.UnwindBatch(samples.data(), samples.size());
+
+  ASSERT_EQ(1U, samples[0].frames.size());
+  EXPECT_EQ(0x1000U, samples[0].frames[0].pc);
+  EXPECT_EQ(0x1000U, samples[0].frames[0].map_start);
+  ASSERT_EQ(1U, samples[1].frames.size());
+  EXPECT_EQ(0x20000U, samples[1].frames[0].pc);
+  EXPECT_EQ(0x20000U, samples[1].frames[0].map_start);
+}
+
+TEST_F(UnwinderTest, stack_hash) {
+  Unwinder unwinder(64, maps_.get(), &regs_, process_memory_);
+  unwinder.SetStackHashOnly(true);
+
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  ElfInterfaceFake::FakePushStepData(StepData(0x23102, 0x10010, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_NONE, unwinder.LastErrorCode());
+  EXPECT_EQ(0U, unwinder.NumFrames());
+  EXPECT_EQ(2U, unwinder.StackDepth());
+  uint64_t hash = unwinder.StackHash();
+  EXPECT_EQ(Unwinder::GetStackHash(unwinder.compact_frames()), hash);
+
+  // The same stack with a different sp gives the same hash.
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x20000);
+  ElfInterfaceFake::FakePushStepData(StepData(0x23102, 0x20010, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+  unwinder.Unwind();
+  EXPECT_EQ(2U, unwinder.StackDepth());
+  EXPECT_EQ(hash, unwinder.StackHash());
+
+  // A different caller gives a different hash.
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  ElfInterfaceFake::FakePushStepData(StepData(0x23202, 0x10010, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+  unwinder.Unwind();
+  EXPECT_EQ(2U, unwinder.StackDepth());
+  EXPECT_NE(hash, unwinder.StackHash());
+
+  // Only the top frame gives a different hash.
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+  unwinder.Unwind();
+  EXPECT_EQ(1U, unwinder.StackDepth());
+  EXPECT_NE(hash, unwinder.StackHash());
+}
+
+TEST_F(UnwinderTest, batch_unwind_stack_hash) {
+  RegsFake regs(5);
+  regs.FakeSetArch(ARCH_ARM);
+  regs.FakeSetReturnAddressValid(false);
+  regs.set_pc(0x1000);
+  regs.set_sp(0x10000);
+
+  std::vector<uint8_t> stack(0x20);
+  UnwindSample sample;
+  sample.regs = &regs;
+  sample.stack = stack.data();
+  sample.stack_start = 0x10000;
+  sample.stack_size = stack.size();
+
+  ElfInterfaceFake::FakePushStepData(StepData(0x1102, 0x10010, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+
+  BatchUnwinder unwinder(64, maps_.get(), process_memory_);
+  unwinder.SetStackHashOnly(true);
+  unwinder.UnwindBatch(&sample, 1);
+  EXPECT_EQ(ERROR_NONE, sample.error_code);
+  EXPECT_EQ(2U, sample.num_frames);
+  EXPECT_NE(0U, sample.stack_hash);
+  EXPECT_TRUE(sample.frames.empty());
+  EXPECT_TRUE(sample.compact_frames.empty());
+
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Frame0", 0));
+  ElfInterfaceFake::FakePushFunctionData(FunctionData("Frame1", 0x100));
+  ElfInterfaceFake::FakePushStepData(StepData(0x1102, 0x10010, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+  // Unwinding modified the registers, so restore them first.
+  regs.set_pc(0x1000);
+  regs.set_sp(0x10000);
+  unwinder.UnwindFrames(&sample);
+  EXPECT_EQ(ERROR_NONE, sample.error_code);
+  ASSERT_EQ(2U, sample.frames.size());
+  EXPECT_EQ(0x1000U, sample.frames[0].pc);
+  EXPECT_EQ("Frame0", sample.frames[0].function_name);
+  EXPECT_EQ(0x1100U, sample.frames[1].pc);
+  EXPECT_EQ("Frame1", sample.frames[1].function_name);
+}
+
+TEST_F(UnwinderTest, frame_cache) {
+  std::shared_ptr<Memory> memory(new MemoryFake);
+  MemoryFake* stack = reinterpret_cast<MemoryFake*>(memory.get());
+  stack->SetData64(0x10018, 0x1202);
+
+  Unwinder unwinder(64, maps_.get(), &regs_, memory);
+  unwinder.SetFrameCache(16);
+
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  ElfInterfaceFake::FakePushStepData(StepData(0x23102, 0x10010, false));
+  // The pc of this step is read from the stack.
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0x10020, false, 0x10018));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_NONE, unwinder.LastErrorCode());
+  ASSERT_EQ(3U, unwinder.NumFrames());
+  EXPECT_EQ(0x1000U, unwinder.frames()[0].pc);
+  EXPECT_EQ(0x23100U, unwinder.frames()[1].pc);
+  EXPECT_EQ(0x1200U, unwinder.frames()[2].pc);
+  std::vector<FrameData> frames = unwinder.frames();
+
+  // After the first step the unwind is in a known state, and the rest of
+  // the frames come from the cache.
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  ElfInterfaceFake::FakePushStepData(StepData(0x23102, 0x10010, false));
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_NONE, unwinder.LastErrorCode());
+  ASSERT_EQ(3U, unwinder.NumFrames());
+  for (size_t i = 0; i < frames.size(); i++) {
+    EXPECT_EQ(frames[i].pc, unwinder.frames()[i].pc) << "Frame " << i;
+    EXPECT_EQ(frames[i].rel_pc, unwinder.frames()[i].rel_pc) << "Frame " << i;
+    EXPECT_EQ(frames[i].sp, unwinder.frames()[i].sp) << "Frame " << i;
+    EXPECT_EQ(frames[i].map_name, unwinder.frames()[i].map_name) << "Frame " << i;
+  }
+
+  // The cached frames are not used once the stack they read changes.
+  stack->SetData64(0x10018, 0x1302);
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  ElfInterfaceFake::FakePushStepData(StepData(0x23102, 0x10010, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0x10020, false, 0x10018));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_NONE, unwinder.LastErrorCode());
+  ASSERT_EQ(3U, unwinder.NumFrames());
+  EXPECT_EQ(0x1300U, unwinder.frames()[2].pc);
+
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  ElfInterfaceFake::FakePushStepData(StepData(0x23102, 0x10010, false));
+  unwinder.Unwind();
+  ASSERT_EQ(3U, unwinder.NumFrames());
+  EXPECT_EQ(0x1300U, unwinder.frames()[2].pc);
+
+  // A different state does not use the cache.
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  ElfInterfaceFake::FakePushStepData(StepData(0x23102, 0x10030, false));
+  unwinder.Unwind();
+  EXPECT_EQ(2U, unwinder.NumFrames());
+
+  // Nothing is used after clearing the cache.
+  unwinder.ClearFrameCache();
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  ElfInterfaceFake::FakePushStepData(StepData(0x23102, 0x10010, false));
+  unwinder.Unwind();
+  EXPECT_EQ(2U, unwinder.NumFrames());
+}
+
+TEST_F(UnwinderTest, frame_cache_max_frames) {
+  std::shared_ptr<Memory> memory(new MemoryFake);
+  Unwinder unwinder(3, maps_.get(), &regs_, memory);
+  unwinder.SetFrameCache(16);
+
+  // An unwind that stops at the maximum number of frames is not cached.
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  ElfInterfaceFake::FakePushStepData(StepData(0x23102, 0x10010, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0x1202, 0x10020, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0x1302, 0x10030, false));
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_MAX_FRAMES_EXCEEDED, unwinder.LastErrorCode());
+  EXPECT_EQ(3U, unwinder.NumFrames());
+
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  ElfInterfaceFake::FakePushStepData(StepData(0x23102, 0x10010, false));
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_NONE, unwinder.LastErrorCode());
+  EXPECT_EQ(2U, unwinder.NumFrames());
+}
+
+TEST_F(UnwinderTest, budget_max_memory_reads) {
+  std::shared_ptr<Memory> memory(new MemoryFake);
+  MemoryFake* stack = reinterpret_cast<MemoryFake*>(memory.get());
+  stack->SetData64(0x10008, 0x1102);
+  stack->SetData64(0x10018, 0x1202);
+  stack->SetData64(0x10028, 0x1302);
+
+  Unwinder unwinder(64, maps_.get(), &regs_, memory);
+  unwinder.SetBudget(0, 2);
+
+  // Every step reads its pc from the stack, the third read is not made.
+  for (size_t i = 0; i < 3; i++) {
+    ElfInterfaceFake::FakePushFunctionData(FunctionData("Frame" + std::to_string(i), i));
+    ElfInterfaceFake::FakePushStepData(StepData(0, 0x10010 + i * 0x10, false, 0x10008 + i * 0x10));
+  }
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_BUDGET_EXCEEDED, unwinder.LastErrorCode());
+  ASSERT_EQ(3U, unwinder.NumFrames());
+  EXPECT_EQ(0x1000U, unwinder.frames()[0].pc);
+  EXPECT_EQ(0x1100U, unwinder.frames()[1].pc);
+  EXPECT_EQ(0x1200U, unwinder.frames()[2].pc);
+  // Only the stack reads count, the names are still found.
+  EXPECT_EQ("Frame0", unwinder.frames()[0].function_name);
+  EXPECT_EQ("Frame2", unwinder.frames()[2].function_name);
+
+  // Every unwind gets a new budget.
+  ElfInterfaceFake::FakeClear();
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0x10010, false, 0x10008));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_NONE, unwinder.LastErrorCode());
+  EXPECT_EQ(2U, unwinder.NumFrames());
+
+  // No limits removes the budget.
+  unwinder.SetBudget(0, 0);
+  for (size_t i = 0; i < 3; i++) {
+    ElfInterfaceFake::FakePushStepData(StepData(0, 0x10010 + i * 0x10, false, 0x10008 + i * 0x10));
+  }
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_NONE, unwinder.LastErrorCode());
+  EXPECT_EQ(4U, unwinder.NumFrames());
+}
+
+TEST_F(UnwinderTest, budget_timeout) {
+  for (size_t i = 0; i < 64; i++) {
+    ElfInterfaceFake::FakePushFunctionData(FunctionData("Frame" + std::to_string(i), i));
+    ElfInterfaceFake::FakePushStepData(StepData(0x1102 + i * 0x100, 0x10010 + i * 0x10, false));
+  }
+
+  regs_.set_pc(0x1000);
+  regs_.set_sp(0x10000);
+
+  Unwinder unwinder(64, maps_.get(), &regs_, process_memory_);
+  unwinder.SetBudget(1, 0);
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_BUDGET_EXCEEDED, unwinder.LastErrorCode());
+
+  // The frames found before the time ran out are kept, without names.
+  ASSERT_NE(0U, unwinder.NumFrames());
+  ASSERT_GT(64U, unwinder.NumFrames());
+  for (size_t i = 0; i < unwinder.NumFrames(); i++) {
+    auto* frame = &unwinder.frames()[i];
+    EXPECT_EQ(0x1000 + i * 0x100, frame->pc) << "Failed at frame " << i;
+    EXPECT_EQ("", frame->function_name) << "Failed at frame " << i;
+    EXPECT_EQ("/system/fake/libc.so", frame->map_name) << "Failed at frame " << i;
+  }
+}
+
+TEST_F(UnwinderTest, frame_pointer) {
+  for (bool use_frame_pointer : {true, false}) {
+    SCOPED_TRACE(use_frame_pointer ? "frame pointer" : "unwind information");
+    ElfInterfaceFake::FakeClear();
+
+    Maps maps;
+    maps.Add(0x1000, 0x8000, 0,
+             PROT_READ | PROT_EXEC | (use_frame_pointer ? MAPS_FLAGS_FRAME_POINTER : 0),
+             "/system/fake/libfp.so", static_cast<uint64_t>(-1));
+    ElfFake* elf = new ElfFake(new MemoryFake);
+    elf->FakeSetInterface(new ElfInterfaceFake(nullptr));
+    (*maps.begin())->elf.reset(elf);
+
+    std::shared_ptr<Memory> memory(new MemoryFake);
+    MemoryFake* stack = reinterpret_cast<MemoryFake*>(memory.get());
+    stack->SetData64(0x10100, 0x10200);
+    stack->SetData64(0x10108, 0x1202);
+    stack->SetData64(0x10200, 0);
+    stack->SetData64(0x10208, 0x1302);
+
+    RegsX86_64 regs;
+    regs.set_pc(0x1000);
+    regs.set_sp(0x10000);
+    regs[X86_64_REG_RBP] = 0x10100;
+
+    // The first frame always uses the unwind information, since the
+    // function might not have set up its frame yet.
+    ElfInterfaceFake::FakePushStepData(StepData(0x1102, 0x10010, false));
+    if (!use_frame_pointer) {
+      ElfInterfaceFake::FakePushStepData(StepData(0x1202, 0x10110, false));
+      ElfInterfaceFake::FakePushStepData(StepData(0x1302, 0x10210, false));
+    }
+    // The end of the frame pointer chain uses the unwind information.
+    ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+
+    Unwinder unwinder(64, &maps, &regs, memory);
+    unwinder.SetResolveNames(false);
+    unwinder.Unwind();
+    EXPECT_EQ(ERROR_NONE, unwinder.LastErrorCode());
+
+    ASSERT_EQ(4U, unwinder.NumFrames());
+    EXPECT_EQ(0x1000U, unwinder.frames()[0].pc);
+    EXPECT_EQ(0x10000U, unwinder.frames()[0].sp);
+    EXPECT_EQ(0x1101U, unwinder.frames()[1].pc);
+    EXPECT_EQ(0x10010U, unwinder.frames()[1].sp);
+    EXPECT_EQ(0x1201U, unwinder.frames()[2].pc);
+    EXPECT_EQ(0x10110U, unwinder.frames()[2].sp);
+    EXPECT_EQ(0x1301U, unwinder.frames()[3].pc);
+    EXPECT_EQ(0x10210U, unwinder.frames()[3].sp);
+  }
+}
+
+TEST_F(UnwinderTest, frame_pointer_arm64_falls_back_at_map_without_frame_pointer) {
+  ElfInterfaceFake::FakeClear();
+
+  Maps maps;
+  maps.Add(0x1000, 0x8000, 0, PROT_READ | PROT_EXEC | MAPS_FLAGS_FRAME_POINTER,
+           "/system/fake/libfp.so", static_cast<uint64_t>(-1));
+  maps.Add(0x20000, 0x28000, 0, PROT_READ | PROT_EXEC, "/system/fake/libnofp.so",
+           static_cast<uint64_t>(-1));
+  for (auto& map_info : maps) {
+    ElfFake* elf = new ElfFake(new MemoryFake);
+    elf->FakeSetInterface(new ElfInterfaceFake(nullptr));
+    map_info->elf.reset(elf);
+  }
+
+  std::shared_ptr<Memory> memory(new MemoryFake);
+  MemoryFake* stack = reinterpret_cast<MemoryFake*>(memory.get());
+  stack->SetData64(0x10100, 0x10200);
+  stack->SetData64(0x10108, 0x1204);
+  stack->SetData64(0x10200, 0x10300);
+  stack->SetData64(0x10208, 0x20104);
+
+  RegsArm64 regs;
+  regs.set_pc(0x1000);
+  regs.set_sp(0x10000);
+  regs[ARM64_REG_R29] = 0x10100;
+
+  ElfInterfaceFake::FakePushStepData(StepData(0x1104, 0x10010, false));
+  // The sp after a frame pointer step is not exact, so once the chain
+  // reaches libnofp.so the frames after the first one are unwound again
+  // using the unwind information.
+  ElfInterfaceFake::FakePushStepData(StepData(0x1204, 0x10020, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0x20104, 0x10030, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+
+  Unwinder unwinder(64, &maps, &regs, memory);
+  unwinder.SetResolveNames(false);
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_NONE, unwinder.LastErrorCode());
+
+  ASSERT_EQ(4U, unwinder.NumFrames());
+  EXPECT_EQ(0x1000U, unwinder.frames()[0].pc);
+  EXPECT_EQ(0x10000U, unwinder.frames()[0].sp);
+  EXPECT_EQ(0x1100U, unwinder.frames()[1].pc);
+  EXPECT_EQ(0x10010U, unwinder.frames()[1].sp);
+  EXPECT_EQ(0x1200U, unwinder.frames()[2].pc);
+  EXPECT_EQ(0x10020U, unwinder.frames()[2].sp);
+  EXPECT_EQ(0x20100U, unwinder.frames()[3].pc);
+  EXPECT_EQ(0x10030U, unwinder.frames()[3].sp);
+}
+
+TEST_F(UnwinderTest, frame_pointer_arm64_falls_back_when_chain_breaks) {
+  ElfInterfaceFake::FakeClear();
+
+  Maps maps;
+  maps.Add(0x1000, 0x8000, 0, PROT_READ | PROT_EXEC | MAPS_FLAGS_FRAME_POINTER,
+           "/system/fake/libfp.so", static_cast<uint64_t>(-1));
+  ElfFake* elf = new ElfFake(new MemoryFake);
+  elf->FakeSetInterface(new ElfInterfaceFake(nullptr));
+  (*maps.begin())->elf.reset(elf);
+
+  std::shared_ptr<Memory> memory(new MemoryFake);
+  MemoryFake* stack = reinterpret_cast<MemoryFake*>(memory.get());
+  stack->SetData64(0x10100, 0x10200);
+  stack->SetData64(0x10108, 0x1204);
+  // The caller's frame pointer goes down the stack.
+  stack->SetData64(0x10200, 0x10000);
+  stack->SetData64(0x10208, 0x1304);
+
+  RegsArm64 regs;
+  regs.set_pc(0x1000);
+  regs.set_sp(0x10000);
+  regs[ARM64_REG_R29] = 0x10100;
+
+  ElfInterfaceFake::FakePushStepData(StepData(0x1104, 0x10010, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0x1204, 0x10020, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0x1304, 0x10030, false));
+  ElfInterfaceFake::FakePushStepData(StepData(0, 0, true));
+
+  Unwinder unwinder(64, &maps, &regs, memory);
+  unwinder.SetResolveNames(false);
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_NONE, unwinder.LastErrorCode());
+
+  ASSERT_EQ(4U, unwinder.NumFrames());
+  EXPECT_EQ(0x1000U, unwinder.frames()[0].pc);
+  EXPECT_EQ(0x10000U, unwinder.frames()[0].sp);
+  EXPECT_EQ(0x1100U, unwinder.frames()[1].pc);
+  EXPECT_EQ(0x10010U, unwinder.frames()[1].sp);
+  EXPECT_EQ(0x1200U, unwinder.frames()[2].pc);
+  EXPECT_EQ(0x10020U, unwinder.frames()[2].sp);
+  EXPECT_EQ(0x1300U, unwinder.frames()[3].pc);
+  EXPECT_EQ(0x10030U, unwinder.frames()[3].sp);
+}
+
+TEST_F(UnwinderTest, frame_pointer_arm64_end_of_chain) {
+  ElfInterfaceFake::FakeClear();
+
+  Maps maps;
+  maps.Add(0x1000, 0x8000, 0, PROT_READ | PROT_EXEC | MAPS_FLAGS_FRAME_POINTER,
+           "/system/fake/libfp.so", static_cast<uint64_t>(-1));
+  ElfFake* elf = new ElfFake(new MemoryFake);
+  elf->FakeSetInterface(new ElfInterfaceFake(nullptr));
+  (*maps.begin())->elf.reset(elf);
+
+  std::shared_ptr<Memory> memory(new MemoryFake);
+  MemoryFake* stack = reinterpret_cast<MemoryFake*>(memory.get());
+  stack->SetData64(0x10100, 0x10200);
+  stack->SetData64(0x10108, 0x1204);
+  stack->SetData64(0x10200, 0);
+  stack->SetData64(0x10208, 0x1304);
+
+  RegsArm64 regs;
+  regs.set_pc(0x1000);
+  regs.set_sp(0x10000);
+  regs[ARM64_REG_R29] = 0x10100;
+
+  // Only the first frame uses the unwind information.
+  ElfInterfaceFake::FakePushStepData(StepData(0x1104, 0x10010, false));
+
+  Unwinder unwinder(64, &maps, &regs, memory);
+  unwinder.SetResolveNames(false);
+  unwinder.Unwind();
+  EXPECT_EQ(ERROR_NONE, unwinder.LastErrorCode());
+
+  ASSERT_EQ(4U, unwinder.NumFrames());
+  EXPECT_EQ(0x1000U, unwinder.frames()[0].pc);
+  EXPECT_EQ(0x1100U, unwinder.frames()[1].pc);
+  EXPECT_EQ(0x1200U, unwinder.frames()[2].pc);
+  EXPECT_EQ(0x10110U, unwinder.frames()[2].sp);
+  EXPECT_EQ(0x1300U, unwinder.frames()[3].pc);
+  EXPECT_EQ(0x10210U, unwinder.frames()[3].sp);
+}
+
 }  // namespace unwindstack
@@ -23,16 +23,59 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <vector>
+
 #include <unwindstack/Elf.h>
 #include <unwindstack/Log.h>
 #include <unwindstack/Memory.h>
+#include <unwindstack/Symbolizer.h>
+
+static void PrintFunction(uint64_t func_addr, const unwindstack::FunctionInfo& function) {
+  printf("<0x%" PRIx64 ">", func_addr - function.offset);
+  if (function.offset != 0) {
+    printf("+%" PRId64, function.offset);
+  }
+  printf(": %s\n", function.name.c_str());
+}
+
+// Looks up every hex address read from stdin, all at once, and prints
+// the function of each in the order read.
+static int SymbolizeStdin(unwindstack::Elf* elf) {
+  std::vector<uint64_t> addrs;
+  uint64_t value;
+  while (scanf("%" SCNx64, &value) == 1) {
+    addrs.push_back(value);
+  }
+  if (!feof(stdin)) {
+    printf("Addresses must be hex numbers.\n");
+    return 1;
+  }
+
+  unwindstack::Symbolizer symbolizer;
+  for (uint64_t addr : addrs) {
+    symbolizer.Add(elf, addr);
+  }
+  symbolizer.Resolve();
+
+  for (uint64_t addr : addrs) {
+    printf("0x%" PRIx64 " ", addr);
+    const unwindstack::FunctionInfo* function = symbolizer.Find(elf, addr);
+    if (function == nullptr || function->name.empty()) {
+      printf("No known function\n");
+    } else {
+      PrintFunction(addr, *function);
+    }
+  }
+  return 0;
+}
 
 int main(int argc, char** argv) {
   if (argc != 2 && argc != 3) {
-    printf("Usage: unwind_symbols <ELF_FILE> [<FUNC_ADDRESS>]\n");
+    printf("Usage: unwind_symbols <ELF_FILE> [<FUNC_ADDRESS> | -]\n");
     printf("  Dump all function symbols in ELF_FILE. If FUNC_ADDRESS is\n");
     printf("  specified, then get the function at that address.\n");
-    printf("  FUNC_ADDRESS must be a hex number.\n");
+    printf("  FUNC_ADDRESS must be a hex number. If - is specified, then\n");
+    printf("  get the function of every hex address read from stdin.\n");
     return 1;
   }
 
@@ -47,7 +90,8 @@ int main(int argc, char** argv) {
   }
 
   uint64_t func_addr;
-  if (argc == 3) {
+  bool read_stdin = argc == 3 && strcmp(argv[2], "-") == 0;
+  if (argc == 3 && !read_stdin) {
     char* name;
     func_addr = strtoull(argv[2], &name, 16);
     if (*name != '\0') {
@@ -94,19 +138,20 @@ int main(int argc, char** argv) {
       return 1;
   }
 
+  if (read_stdin) {
+    return SymbolizeStdin(&elf);
+  }
+
   std::string name;
   if (argc == 3) {
     std::string cur_name;
-    uint64_t func_offset;
-    if (!elf.GetFunctionName(func_addr, &cur_name, &func_offset)) {
+    unwindstack::FunctionInfo function;
+    if (!elf.GetFunctionName(func_addr, &cur_name, &function.offset)) {
       printf("No known function at 0x%" PRIx64 "\n", func_addr);
       return 1;
     }
-    printf("<0x%" PRIx64 ">", func_addr - func_offset);
-    if (func_offset != 0) {
-      printf("+%" PRId64, func_offset);
-    }
-    printf(": %s\n", cur_name.c_str());
+    function.name = std::move(cur_name);
+    PrintFunction(func_addr, function);
     return 0;
   }
 